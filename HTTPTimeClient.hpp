@@ -8,6 +8,14 @@
 #include <ESP8266HTTPClient.h>
 #include <ESP8266WiFi.h>
 
+#include "clock.hpp"
+#include "stats.hpp"
+
+// Maximum number of samples in an update (see setRepeats).
+#ifndef HTTP_TIME_MAX_SAMPLES
+#define HTTP_TIME_MAX_SAMPLES 16
+#endif
+
 namespace sensino {
 
 /**
@@ -15,6 +23,22 @@ namespace sensino {
  *
  * Use it ONLY if NTP is unavailable.
  *
+ * The server must answer the epoch in seconds, optionally with a fraction
+ * (e.g. 1700000000.123).
+ *
+ * Each update takes several samples (one request per call to update).
+ * Requests slower than the maximum round trip time out and are rejected.
+ * Each sample places the server clock within a window as wide as its
+ * round trip (plus a second if the server sends no fraction), and samples
+ * whose window does not overlap those of most others are outliers. Of the
+ * largest group of overlapping samples, the one with the lowest round trip
+ * is kept, which bounds the error to half of it (see getUncertainty). An
+ * update needs a minimum number of samples in that group.
+ *
+ * The drift of millis() is corrected from the history of updates, and the
+ * update interval grows while the error stays within a bound (see
+ * setMaxError).
+ *
  */
 class HTTPTimeClient {
 private:
@@ -23,11 +47,167 @@ private:
 
   unsigned long _updateInterval = 3600000; // In ms
 
+  // Corrects the drift of millis() and stretches the update interval.
+  ClockModel _clock = ClockModel(3600000);
+
   unsigned long _currentEpoc = 0; // In s
   unsigned long _lastUpdate = 0;  // In ms
 
+  // Round trip (in ms) of the sample used in the last update.
+  unsigned long _roundTrip = 0;
+
+  // Duration (in ms) of the successful updates, and failed ones.
+  Histogram _syncStats;
+  unsigned long _failures = 0;
+
+  // Samples taken in each update.
   unsigned int _repeats = 9;
 
+  // Valid samples needed for an update.
+  unsigned int _minSamples = 3;
+
+  // Samples with a longer round trip (in ms) are rejected.
+  unsigned long _maxRoundTrip = 1000;
+
+  // Time (in ms) to wait before retrying a failed update.
+  unsigned long _retryInterval = 10000;
+
+  // State of the update in progress.
+  bool _sampling = false;
+  unsigned int _samples = 0;
+  unsigned long _nextSampleAt = 0; // In ms
+  unsigned long _lastAttempt = 0;  // In ms
+
+  // Valid samples of the update in progress.
+  struct Sample {
+    unsigned long roundTrip; // In ms
+    unsigned long epoc;      // In s
+    unsigned long at;        // In ms, when epoc was exact.
+    bool exact;              // false if the server sent no fraction.
+  };
+  Sample _valid[HTTP_TIME_MAX_SAMPLES];
+  unsigned int _validSamples = 0;
+
+  // Samples rejected as outliers.
+  unsigned long _outliers = 0;
+
+  // Connection to the time server, kept alive between samples.
+  WiFiClient _client;
+  HTTPClient _http;
+
+  void _startRound() {
+    this->_sampling = true;
+    this->_samples = 0;
+    this->_validSamples = 0;
+    this->_nextSampleAt = millis();
+    this->_lastAttempt = millis();
+  }
+
+  // Take a sample, keeping it if the server answered in time.
+  // It blocks for up to the maximum round trip.
+  // return false if the sample was rejected.
+  bool _sample() {
+    this->_samples++;
+
+    this->_http.setReuse(true);
+    this->_http.begin(this->_client, this->_endpoint);
+    this->_http.setTimeout(this->_maxRoundTrip < 65535 ? this->_maxRoundTrip
+                                                       : 65535);
+
+    unsigned long t1 = millis();
+    int httpCode = this->_http.GET();
+    if (httpCode != 200) {
+      this->_http.end();
+      return false;
+    }
+    String payload = this->_http.getString();
+    unsigned long t2 = millis();
+    this->_http.end();
+
+    unsigned long roundTrip = t2 - t1;
+    if (roundTrip > this->_maxRoundTrip ||
+        this->_validSamples >= HTTP_TIME_MAX_SAMPLES) {
+      return false;
+    }
+
+    char *fraction;
+    Sample &sample = this->_valid[this->_validSamples++];
+    sample.roundTrip = roundTrip;
+    sample.epoc = strtoul(payload.c_str(), &fraction, 10);
+    sample.exact = *fraction == '.';
+    // The server time corresponds (at best) to the middle of the request.
+    // Move back to when the integer epoch was exact.
+    sample.at = t1 + roundTrip / 2 - _parseMs(fraction);
+    return true;
+  }
+
+  // true if the server clock windows of two samples overlap.
+  static bool _agree(const Sample &a, const Sample &b) {
+    // Offset of the server clock with millis(), relative to each other.
+    long difference = (long)((a.epoc - b.epoc) * 1000 - (a.at - b.at));
+    unsigned long tolerance = (a.roundTrip + b.roundTrip) / 2 + 1;
+    if (!a.exact || !b.exact) {
+      tolerance += 1000;
+    }
+    return (unsigned long)labs(difference) <= tolerance;
+  }
+
+  // Time (in ms) left until period elapses from since, 0 if since is 0.
+  static unsigned long _remaining(unsigned long since, unsigned long period) {
+    unsigned long elapsed = millis() - since;
+    return since == 0 || elapsed >= period ? 0 : period - elapsed;
+  }
+
+  // Milliseconds in a decimal fraction (e.g. ".123").
+  static unsigned long _parseMs(const char *fraction) {
+    unsigned long value = 0;
+    if (*fraction != '.') {
+      return value;
+    }
+    fraction++;
+    for (int n = 0; n < 3; n++) {
+      value *= 10;
+      if (*fraction >= '0' && *fraction <= '9') {
+        value += *fraction - '0';
+        fraction++;
+      }
+    }
+    return value;
+  }
+
+  // Use the best sample that agrees with most of the others, if there are
+  // enough of them.
+  bool _finishRound() {
+    this->_sampling = false;
+    int best = -1;
+    unsigned int bestAgree = 0;
+    for (unsigned int i = 0; i < this->_validSamples; i++) {
+      unsigned int agree = 0;
+      for (unsigned int j = 0; j < this->_validSamples; j++) {
+        agree += _agree(this->_valid[i], this->_valid[j]);
+      }
+      if (agree > bestAgree ||
+          (agree == bestAgree &&
+           this->_valid[i].roundTrip < this->_valid[best].roundTrip)) {
+        best = i;
+        bestAgree = agree;
+      }
+    }
+    this->_outliers += this->_validSamples - bestAgree;
+    if (best < 0 || bestAgree < this->_minSamples) {
+      this->_failures++;
+      return false;
+    }
+
+    const Sample &sample = this->_valid[best];
+    this->_syncStats.add(millis() - this->_lastAttempt);
+    this->_lastUpdate = sample.at;
+    this->_currentEpoc = sample.epoc;
+    this->_roundTrip = sample.roundTrip;
+    this->_clock.addSample(sample.at, (unsigned long long)sample.epoc * 1000);
+    return true;
+  }
+
 public:
   HTTPTimeClient() {}
 
@@ -42,70 +222,104 @@ public:
                  unsigned long updateInterval) {
     this->_endpoint = endpoint;
     this->_timeOffset = timeOffset;
-    this->_updateInterval = updateInterval;
+    this->setUpdateInterval(updateInterval);
   }
 
   void begin() {}
 
   void begin(const char *endpoint) { this->_endpoint = endpoint; }
 
+  // Take all the samples and update.
+  // It blocks until done, use update to avoid it.
   bool forceUpdate() {
 
 #ifdef DEBUG_HTTPTimeClient
     Serial.println("Update from NTP Server");
 #endif
 
-    unsigned long minRoundTrip = 4294967295;
-
-    unsigned long tmpCurrentEpoc = 0; // In s
-    unsigned long tmpLastUpdate = 0;  // In ms
-
-    for (size_t n = 0; n < this->_repeats; n++) {
+    this->_startRound();
+    while (this->_samples < this->_repeats) {
       delay(random(40, 230));
-      unsigned long t1;
-      unsigned long t2;
-      unsigned long s1;
-      {
-        HTTPClient http;
-        http.begin(this->_endpoint);
-
-        t1 = millis();
-        int httpCode = http.GET();
-        if (httpCode != 200) {
-          http.end();
-          return false;
-        }
-        String payload = http.getString();
-        s1 = atol(payload.c_str());
-        t2 = millis();
-      }
-      if ((t2 - t1) < minRoundTrip) {
-        tmpCurrentEpoc = s1;
-        tmpLastUpdate = (t1 + t2) / 2;
+      this->_sample();
+    }
+    return this->_finishRound();
+  }
+
+  // Call this method in your loop.
+  // Each call takes at most one sample.
+  // return false if an update finished without enough valid samples.
+  bool update() {
+    if (!this->_sampling) {
+      bool due = (millis() - this->_lastUpdate >=
+                  this->_clock.getInterval()) // Update after the interval
+                 || this->_lastUpdate == 0;   // Update if there was no update
+      bool retry = this->_lastAttempt == 0 || // Wait after a failed update.
+                   millis() - this->_lastAttempt >= this->_retryInterval;
+      if (!due || !retry) {
+        return true;
       }
+      this->_startRound();
     }
 
-    this->_lastUpdate = tmpLastUpdate;
-    this->_currentEpoc = tmpCurrentEpoc;
+    if ((long)(millis() - this->_nextSampleAt) < 0) {
+      return true;
+    }
 
+    this->_sample();
+    if (this->_samples >= this->_repeats) {
+      return this->_finishRound();
+    }
+    // Spread the samples to avoid systematic errors.
+    this->_nextSampleAt = millis() + random(40, 230);
     return true;
   }
 
-  bool update() {
-    if ((millis() - this->_lastUpdate >=
-         this->_updateInterval)      // Update after _updateInterval
-        || this->_lastUpdate == 0) { // Update if there was no update yet.
-      return this->forceUpdate();
+  // true if an update is in progress.
+  bool isUpdating() const { return this->_sampling; }
+
+  // Time (in ms) until update has something to do: the next sample of the
+  // update in progress, or the next update.
+  unsigned long getIdleTime() const {
+    if (this->_sampling) {
+      long left = (long)(this->_nextSampleAt - millis());
+      return left > 0 ? left : 0;
     }
-    return true;
+    unsigned long due =
+        _remaining(this->_lastUpdate, this->_clock.getInterval());
+    unsigned long retry = _remaining(this->_lastAttempt, this->_retryInterval);
+    return due > retry ? due : retry;
   }
 
-  unsigned long getEpochTime() const {
-    return this->_timeOffset +  // User offset
-           this->_currentEpoc + // Epoc returned by the NTP server
-           ((millis() - this->_lastUpdate) / 1000); // Time since last update
+  // Uncertainty (in ms) of the last update: half of the best round trip.
+  unsigned long getUncertainty() const { return this->_roundTrip / 2; }
+
+  // Round trip (in ms) of the sample used in the last update.
+  unsigned long getRoundTrip() const { return this->_roundTrip; }
+
+  // Duration (in ms) of the successful updates.
+  const Histogram &getSyncStats() const { return this->_syncStats; }
+
+  // Number of updates without enough valid samples.
+  unsigned long getFailures() const { return this->_failures; }
+
+  // Number of samples rejected as outliers.
+  unsigned long getOutliers() const { return this->_outliers; }
+
+  // Samples taken in each update, up to HTTP_TIME_MAX_SAMPLES.
+  void setRepeats(unsigned int value) {
+    this->_repeats =
+        value < HTTP_TIME_MAX_SAMPLES ? value : HTTP_TIME_MAX_SAMPLES;
   }
 
+  // Valid samples needed for an update.
+  void setMinSamples(unsigned int value) { this->_minSamples = value; }
+
+  // Samples with a longer round trip (in ms) are rejected, and requests
+  // time out after it.
+  void setMaxRoundTrip(unsigned long value) { this->_maxRoundTrip = value; }
+
+  unsigned long getEpochTime() const { return this->millisToEpoch(millis()); }
+
   int getDay() const {
     return (((this->getEpochTime() / 86400L) + 4) % 7); // 0 is Sunday
   }
@@ -136,14 +350,38 @@ public:
 
   void setUpdateInterval(unsigned long updateInterval) {
     this->_updateInterval = updateInterval;
+    this->_clock.setIntervals(updateInterval, updateInterval * 16);
+  }
+
+  // The interval grows up to it while the clock stays within the maximum
+  // error (16 times the update interval by default).
+  void setMaxUpdateInterval(unsigned long maxUpdateInterval) {
+    this->_clock.setIntervals(this->_updateInterval, maxUpdateInterval);
   }
 
+  // Maximum error (in ms) of the clock between updates.
+  void setMaxError(unsigned long maxError) { this->_clock.setBound(maxError); }
+
+  // Interval (in ms) until the next update.
+  unsigned long getUpdateInterval() const { return this->_clock.getInterval(); }
+
+  // Estimated frequency error of millis() (e.g. 1e-5 is 10 ppm fast).
+  double getDrift() const { return this->_clock.getDrift(); }
+
   void setendpoint(const char *endpoint) { this->_endpoint = endpoint; }
 
   unsigned long millisToEpoch(unsigned long value) const {
-    return this->_timeOffset +  // User offset
-           this->_currentEpoc + // Epoc returned by the NTP server
-           ((value - this->_lastUpdate) / 1000); // Time since last update
+    return this->millisToEpochMs(value) / 1000;
+  }
+
+  unsigned long long getEpochTimeMs() const {
+    return this->millisToEpochMs(millis());
+  }
+
+  unsigned long long millisToEpochMs(unsigned long value) const {
+    // Time since the last update, corrected for the drift of millis().
+    return (unsigned long long)this->_timeOffset * 1000 + // User offset
+           this->_clock.toEpochMs(value);
   }
 
   unsigned long getCurrentEpoch() const { return this->_currentEpoc; }
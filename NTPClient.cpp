@@ -20,6 +20,9 @@
 
 #include "NTPClient.h"
 
+// change next line to use with another board/shield
+#include <ESP8266WiFi.h>
+
 namespace sensino {
 
 NTPClient::NTPClient(UDP &udp) { this->_udp = &udp; }
@@ -31,21 +34,21 @@ NTPClient::NTPClient(UDP &udp, long timeOffset) {
 
 NTPClient::NTPClient(UDP &udp, const char *poolServerName) {
   this->_udp = &udp;
-  this->_poolServerName = poolServerName;
+  this->_servers[0] = poolServerName;
 }
 
 NTPClient::NTPClient(UDP &udp, const char *poolServerName, long timeOffset) {
   this->_udp = &udp;
   this->_timeOffset = timeOffset;
-  this->_poolServerName = poolServerName;
+  this->_servers[0] = poolServerName;
 }
 
 NTPClient::NTPClient(UDP &udp, const char *poolServerName, long timeOffset,
                      unsigned long updateInterval) {
   this->_udp = &udp;
   this->_timeOffset = timeOffset;
-  this->_poolServerName = poolServerName;
-  this->_updateInterval = updateInterval;
+  this->_servers[0] = poolServerName;
+  this->setUpdateInterval(updateInterval);
 }
 
 void NTPClient::begin() { this->begin(NTP_DEFAULT_LOCAL_PORT); }
@@ -63,52 +66,174 @@ bool NTPClient::forceUpdate() {
   Serial.println("Update from NTP Server");
 #endif
 
-  this->sendNTPPacket();
+  if (!this->_udpSetup)
+    this->begin(); // setup the UDP client if needed
 
-  // Wait till data is there or timeout...
-  byte timeout = 0;
-  int cb = 0;
-  do {
-    delay(10);
-    cb = this->_udp->parsePacket();
-    if (timeout > 100)
-      return false; // timeout after 1000 ms
-    timeout++;
-  } while (cb == 0);
+  this->startUpdate();
+  bool success = true;
+  while (this->_pending) {
+    success = this->pollUpdate();
+    if (this->_pending)
+      delay(1);
+  }
+  return success;
+}
+
+bool NTPClient::update() {
+  if (!this->_pending) {
+    if ((millis() - this->_lastUpdate >=
+         this->_clock.getInterval())   // Update after the interval
+        || this->_lastUpdate == 0) {   // Update if there was no update yet.
+      if (!this->_udpSetup)
+        this->begin(); // setup the UDP client if needed
+      this->startUpdate();
+    } else {
+      return true;
+    }
+  }
+  return this->pollUpdate();
+}
 
-  this->_lastUpdate =
-      millis() - (10 * (timeout + 1)); // Account for delay in reading the time
+void NTPClient::startUpdate() {
+  // Discard late answers to a previous update.
+  while (this->_udp->parsePacket() > 0)
+    ;
+
+  this->_round++;
+  this->_bestServer = -1;
+  this->_roundStart = millis();
+  this->_sent = 0;
+  for (byte server = 0; server < this->_serverCount; server++)
+    this->_answered[server] = false;
+  this->_pending = true;
+}
 
-  this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
+bool NTPClient::pollUpdate() {
+  unsigned long start = micros();
 
-  unsigned long highWord =
-      word(this->_packetBuffer[40], this->_packetBuffer[41]);
-  unsigned long lowWord =
-      word(this->_packetBuffer[42], this->_packetBuffer[43]);
-  // combine the four bytes (two words) into a long integer
-  // this is NTP time (seconds since Jan 1 1900):
-  unsigned long secsSince1900 = highWord << 16 | lowWord;
+  // One request per call, so that a slow name lookup only delays one.
+  if (this->_sent < this->_serverCount) {
+    byte server = this->_sent++;
+    this->_sentAt[server] = millis();
+    if (!this->sendNTPPacket(server))
+      this->_sentAt[server] -= this->_timeout + 1; // Do not wait for it.
+  }
 
-  this->_currentEpoc = secsSince1900 - SEVENZYYEARS;
+  do {
+    int cb = this->_udp->parsePacket();
+    if (cb == 0)
+      break;
+    unsigned long receivedAt = millis();
+    if (cb >= NTP_PACKET_SIZE) {
+      this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
+      this->processPacket(receivedAt);
+    }
+  } while (micros() - start < this->_budget);
+
+  // Done once every server answered or timed out.
+  bool done = this->_sent == this->_serverCount;
+  for (byte server = 0; server < this->_sent; server++)
+    done = done && (this->_answered[server] ||
+                    millis() - this->_sentAt[server] > this->_timeout);
+
+  if (done)
+    return this->finishUpdate();
 
   return true;
 }
 
-bool NTPClient::update() {
-  if ((millis() - this->_lastUpdate >=
-       this->_updateInterval)      // Update after _updateInterval
-      || this->_lastUpdate == 0) { // Update if there was no update yet.
-    if (!this->_udpSetup)
-      this->begin(); // setup the UDP client if needed
-    return this->forceUpdate();
+// Read a 64 bit NTP timestamp as ms since Jan 1 1900.
+static unsigned long long ntpToMs(const byte *buffer) {
+  unsigned long seconds = (unsigned long)word(buffer[0], buffer[1]) << 16 |
+                          word(buffer[2], buffer[3]);
+  unsigned long fraction = (unsigned long)word(buffer[4], buffer[5]) << 16 |
+                           word(buffer[6], buffer[7]);
+  return (unsigned long long)seconds * 1000 +
+         (((unsigned long long)fraction * 1000) >> 32);
+}
+
+void NTPClient::processPacket(unsigned long receivedAt) {
+  // The originate timestamp echoes the transmit timestamp of our request,
+  // which carries the update round and the server index.
+  unsigned long round =
+      (unsigned long)word(this->_packetBuffer[24], this->_packetBuffer[25])
+          << 16 |
+      word(this->_packetBuffer[26], this->_packetBuffer[27]);
+  byte server = this->_packetBuffer[31];
+  if (round != this->_round || server >= this->_serverCount ||
+      this->_answered[server])
+    return;
+
+  // Only valid server answers (mode 4), synchronized (leap indicator != 3)
+  // and not a Kiss-o'-Death (stratum 0).
+  if ((this->_packetBuffer[0] & 0x07) != 4 ||
+      (this->_packetBuffer[0] >> 6) == 3 || this->_packetBuffer[1] == 0)
+    return;
+
+  this->_answered[server] = true;
+
+  // Receive (T2) and transmit (T3) timestamps of the server.
+  unsigned long long t2 = ntpToMs(&this->_packetBuffer[32]);
+  unsigned long long t3 = ntpToMs(&this->_packetBuffer[40]);
+
+  // Round trip delay, without the time spent in the server. receivedAt is
+  // when the answer was found, which can be later than its arrival.
+  long delay = (long)(receivedAt - this->_sentAt[server]) - (long)(t3 - t2);
+  if (delay < 0)
+    delay = 0;
+  if (delay > (long)this->_timeout)
+    return;
+
+  // Time at receivedAt.
+  unsigned long long epochMs =
+      t3 + delay / 2 - (unsigned long long)SEVENZYYEARS * 1000;
+
+  // Offset with the current clock (0 if never synced).
+  long offset = 0;
+  if (this->_clock.isSynced())
+    offset = (long)(epochMs - this->_clock.toEpochMs(receivedAt));
+
+  // Keep the sample with the lowest delay, then the lowest offset.
+  if (this->_bestServer < 0 || delay < this->_bestDelay ||
+      (delay == this->_bestDelay && labs(offset) < labs(this->_bestOffset))) {
+    this->_bestServer = server;
+    this->_bestDelay = delay;
+    this->_bestOffset = offset;
+    this->_bestEpochMs = epochMs;
+    this->_bestAt = receivedAt;
+  }
+}
+
+bool NTPClient::finishUpdate() {
+  this->_pending = false;
+
+  // Resolve again the names of the servers that stopped answering.
+  for (byte server = 0; server < this->_serverCount; server++) {
+    if (this->_answered[server])
+      this->_misses[server] = 0;
+    else if (++this->_misses[server] >= NTP_RESOLVE_AFTER) {
+      this->_misses[server] = 0;
+      this->_addresses[server] = IPAddress();
+    }
   }
+
+  if (this->_bestServer < 0) {
+    this->_failures++;
+    return false;
+  }
+  this->_syncStats.add(millis() - this->_roundStart);
+
+  // _currentEpoc is an integer number of seconds at _lastUpdate.
+  this->_currentEpoc = this->_bestEpochMs / 1000;
+  this->_lastUpdate = this->_bestAt - (unsigned long)(this->_bestEpochMs % 1000);
+  this->_lastServer = this->_bestServer;
+  this->_lastDelay = this->_bestDelay;
+  this->_clock.addSample(this->_bestAt, this->_bestEpochMs);
   return true;
 }
 
 unsigned long NTPClient::getEpochTime() const {
-  return this->_timeOffset +  // User offset
-         this->_currentEpoc + // Epoc returned by the NTP server
-         ((millis() - this->_lastUpdate) / 1000); // Time since last update
+  return this->millisToEpoch(millis());
 }
 
 int NTPClient::getDay() const {
@@ -151,13 +276,72 @@ void NTPClient::setTimeOffset(int timeOffset) {
 
 void NTPClient::setUpdateInterval(unsigned long updateInterval) {
   this->_updateInterval = updateInterval;
+  this->_clock.setIntervals(updateInterval, updateInterval * 16);
+}
+
+void NTPClient::setMaxUpdateInterval(unsigned long maxUpdateInterval) {
+  this->_clock.setIntervals(this->_updateInterval, maxUpdateInterval);
+}
+
+void NTPClient::setMaxError(unsigned long maxError) {
+  this->_clock.setBound(maxError);
 }
 
+unsigned long NTPClient::getUpdateInterval() const {
+  return this->_clock.getInterval();
+}
+
+double NTPClient::getDrift() const { return this->_clock.getDrift(); }
+
 void NTPClient::setPoolServerName(const char *poolServerName) {
-  this->_poolServerName = poolServerName;
+  this->_servers[0] = poolServerName;
+  this->_addresses[0] = IPAddress();
+}
+
+bool NTPClient::addServer(const char *serverName) {
+  if (this->_serverCount >= NTP_MAX_SERVERS)
+    return false;
+  this->_addresses[this->_serverCount] = IPAddress();
+  this->_servers[this->_serverCount++] = serverName;
+  return true;
+}
+
+void NTPClient::setBudget(unsigned long budget) { this->_budget = budget; }
+
+void NTPClient::setTimeout(unsigned long timeout) {
+  this->_timeout = timeout;
+}
+
+bool NTPClient::isUpdating() const { return this->_pending; }
+
+unsigned long NTPClient::getIdleTime() const {
+  if (this->_pending || this->_lastUpdate == 0)
+    return 0;
+  unsigned long elapsed = millis() - this->_lastUpdate;
+  unsigned long interval = this->_clock.getInterval();
+  return elapsed >= interval ? 0 : interval - elapsed;
 }
 
-void NTPClient::sendNTPPacket() {
+const char *NTPClient::getServer() const {
+  if (this->_lastServer < 0)
+    return nullptr;
+  return this->_servers[this->_lastServer];
+}
+
+long NTPClient::getDelay() const { return this->_lastDelay; }
+
+const Histogram &NTPClient::getSyncStats() const { return this->_syncStats; }
+
+unsigned long NTPClient::getFailures() const { return this->_failures; }
+
+bool NTPClient::sendNTPPacket(byte server) {
+  // The name is resolved once, a lookup blocks.
+  if (!this->_addresses[server].isSet() &&
+      !WiFi.hostByName(this->_servers[server], this->_addresses[server])) {
+    this->_addresses[server] = IPAddress();
+    return false;
+  }
+
   // set all bytes in the buffer to 0
   memset(this->_packetBuffer, 0, NTP_PACKET_SIZE);
   // Initialize values needed to form NTP request
@@ -172,18 +356,34 @@ void NTPClient::sendNTPPacket() {
   this->_packetBuffer[14] = 49;
   this->_packetBuffer[15] = 52;
 
+  // The transmit timestamp is echoed by the server, use it
+  // to match the answer with the round and the server.
+  this->_packetBuffer[40] = (this->_round >> 24) & 0xFF;
+  this->_packetBuffer[41] = (this->_round >> 16) & 0xFF;
+  this->_packetBuffer[42] = (this->_round >> 8) & 0xFF;
+  this->_packetBuffer[43] = this->_round & 0xFF;
+  this->_packetBuffer[47] = server;
+
   // all NTP fields have been given values, now
   // you can send a packet requesting a timestamp:
-  this->_udp->beginPacket(this->_poolServerName,
+  this->_udp->beginPacket(this->_addresses[server],
                           123); // NTP requests are to port 123
   this->_udp->write(this->_packetBuffer, NTP_PACKET_SIZE);
-  this->_udp->endPacket();
+  return this->_udp->endPacket() == 1;
 }
 
 unsigned long NTPClient::millisToEpoch(unsigned long value) const {
-  return this->_timeOffset +  // User offset
-         this->_currentEpoc + // Epoc returned by the NTP server
-         ((value - this->_lastUpdate) / 1000); // Time since last update
+  return this->millisToEpochMs(value) / 1000;
+}
+
+unsigned long long NTPClient::getEpochTimeMs() const {
+  return this->millisToEpochMs(millis());
+}
+
+unsigned long long NTPClient::millisToEpochMs(unsigned long value) const {
+  // Time since the last update, corrected for the drift of millis().
+  return (unsigned long long)this->_timeOffset * 1000 + // User offset
+         this->_clock.toEpochMs(value);
 }
 
 unsigned long NTPClient::getCurrentEpoch() const { return this->_currentEpoc; }
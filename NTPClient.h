@@ -4,9 +4,19 @@
 
 #include <Udp.h>
 
+#include "clock.hpp"
+#include "stats.hpp"
+
 #define SEVENZYYEARS 2208988800UL
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_MAX_SERVERS 4
+
+// Consecutive updates without an answer from a server after which its
+// name is resolved again.
+#ifndef NTP_RESOLVE_AFTER
+#define NTP_RESOLVE_AFTER 4
+#endif
 
 namespace sensino {
 
@@ -15,18 +25,67 @@ private:
   UDP *_udp;
   bool _udpSetup = false;
 
-  const char *_poolServerName = "pool.ntp.org"; // Default time server
+  // Time servers queried on each update.
+  const char *_servers[NTP_MAX_SERVERS] = {"pool.ntp.org"}; // Default
+  byte _serverCount = 1;
+
+  // Addresses of the servers, resolved on their first request.
+  IPAddress _addresses[NTP_MAX_SERVERS];
+
+  // Consecutive updates without an answer, for each server.
+  byte _misses[NTP_MAX_SERVERS] = {0};
+
   int _port = NTP_DEFAULT_LOCAL_PORT;
   long _timeOffset = 0;
 
   unsigned long _updateInterval = 60000; // In ms
 
+  // Corrects the drift of millis() and stretches the update interval.
+  ClockModel _clock = ClockModel(60000);
+
   unsigned long _currentEpoc = 0; // In s
   unsigned long _lastUpdate = 0;  // In ms
 
+  // Maximum time (in us) spent in each call to update.
+  unsigned long _budget = 1000;
+
+  // Maximum time (in ms) to wait for the answers.
+  unsigned long _timeout = 1000;
+
+  // State of the update in progress.
+  bool _pending = false;
+  uint32_t _round = 0;
+  unsigned long _roundStart = 0;        // In ms
+  byte _sent = 0;                       // Requests sent in this round.
+  unsigned long _sentAt[NTP_MAX_SERVERS]; // In ms
+  bool _answered[NTP_MAX_SERVERS];
+
+  // Best sample (lowest delay) of the update in progress.
+  int _bestServer = -1;
+  long _bestDelay = 0;                // In ms
+  long _bestOffset = 0;               // In ms
+  unsigned long long _bestEpochMs = 0; // In ms, at _bestAt
+  unsigned long _bestAt = 0;          // In ms
+
+  // Server and delay of the last successful update.
+  int _lastServer = -1;
+  long _lastDelay = 0;
+
+  // Duration (in ms) of the successful updates, and failed ones.
+  Histogram _syncStats;
+  unsigned long _failures = 0;
+
   byte _packetBuffer[NTP_PACKET_SIZE];
 
-  void sendNTPPacket();
+  bool sendNTPPacket(byte server);
+
+  void startUpdate();
+
+  bool pollUpdate();
+
+  void processPacket(unsigned long receivedAt);
+
+  bool finishUpdate();
 
 public:
   NTPClient(UDP &udp);
@@ -41,12 +100,20 @@ public:
             unsigned long updateInterval);
 
   /**
-   * Set time server name
+   * Set time server name (the first of the list)
    *
    * @param poolServerName
    */
   void setPoolServerName(const char *poolServerName);
 
+  /**
+   * Add a time server to be queried on each update.
+   * The answer with the lowest round trip delay is used.
+   *
+   * @return false if there is no room for more servers.
+   */
+  bool addServer(const char *serverName);
+
   /**
    * Starts the underlying UDP client with the default local port
    */
@@ -59,20 +126,72 @@ public:
 
   /**
    * This should be called in the main loop of your application. By default an
-   * update from the NTP Server is only made every 60 seconds. This can be
-   * configured in the NTPClient constructor.
+   * update from the NTP Server is made every 60 seconds at first. This can be
+   * configured in the NTPClient constructor. The interval grows while the
+   * drift of millis() is corrected within the maximum error (see setMaxError).
    *
-   * @return true on success, false on failure
+   * It never blocks: each call sends at most one request (a server name
+   * is only resolved before its first request) and collects the answers,
+   * spending at most the budget (see setBudget).
+   *
+   * An answer is timed when a call finds it, not when it arrived, so call
+   * it often while isUpdating: the lateness adds to the delay, the sample
+   * with the lowest delay is kept, and the error is within half of it.
+   *
+   * @return false if an update finished without any valid answer.
    */
   bool update();
 
   /**
    * This will force the update from the NTP Server.
+   * It blocks until all servers answered or the timeout expired.
    *
    * @return true on success, false on failure
    */
   bool forceUpdate();
 
+  /**
+   * Maximum time spent (in us) in each call to update.
+   */
+  void setBudget(unsigned long budget);
+
+  /**
+   * Maximum time (in ms) to wait for the answers of the servers.
+   * Samples with a longer round trip delay are discarded.
+   */
+  void setTimeout(unsigned long timeout);
+
+  /**
+   * @return true if an update is in progress.
+   */
+  bool isUpdating() const;
+
+  /**
+   * @return time (in ms) until update has something to do: 0 while an
+   * update is in progress, as the answers are timed when found.
+   */
+  unsigned long getIdleTime() const;
+
+  /**
+   * @return name of the server used in the last update, or nullptr.
+   */
+  const char *getServer() const;
+
+  /**
+   * @return round trip delay (in ms) of the sample used in the last update.
+   */
+  long getDelay() const;
+
+  /**
+   * @return duration (in ms) of the successful updates.
+   */
+  const Histogram &getSyncStats() const;
+
+  /**
+   * @return number of updates without any valid answer.
+   */
+  unsigned long getFailures() const;
+
   int getDay() const;
 
   int getHours() const;
@@ -92,6 +211,27 @@ public:
    */
   void setUpdateInterval(unsigned long updateInterval);
 
+  /**
+   * Maximum update interval. The interval grows up to it while the clock
+   * stays within the maximum error (16 times the update interval by default).
+   */
+  void setMaxUpdateInterval(unsigned long maxUpdateInterval);
+
+  /**
+   * Maximum error (in ms) of the clock between updates.
+   */
+  void setMaxError(unsigned long maxError);
+
+  /**
+   * @return interval (in ms) until the next update.
+   */
+  unsigned long getUpdateInterval() const;
+
+  /**
+   * @return estimated frequency error of millis() (e.g. 1e-5 is 10 ppm fast).
+   */
+  double getDrift() const;
+
   /**
    * @return time formatted like `hh:mm:ss`
    */
@@ -107,8 +247,18 @@ public:
    */
   void end();
 
+  /**
+   * @return time in milliseconds since Jan. 1, 1970
+   */
+  unsigned long long getEpochTimeMs() const;
+
   unsigned long millisToEpoch(unsigned long) const;
 
+  /**
+   * @return time in milliseconds since Jan. 1, 1970 at a given millis()
+   */
+  unsigned long long millisToEpochMs(unsigned long) const;
+
   /**
    *
    * @return Epoc returned by the NTP server
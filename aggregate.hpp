@@ -0,0 +1,271 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Aggregation of records over a time window.
+ *
+ */
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include <ArduinoJson.h>
+
+#include "common.h"
+
+// Maximum number of fields of a summarized record.
+#ifndef AGGREGATE_MAX_FIELDS
+#define AGGREGATE_MAX_FIELDS 6
+#endif
+
+namespace sensino {
+
+/**
+ * Extra statistics of a Summary, only present when enabled.
+ */
+template <typename UR, bool V> struct SummaryVariance {
+  void fill(JsonObject &doc) {}
+
+  template <typename C> void codec(C &c) {}
+};
+
+template <typename UR> struct SummaryVariance<UR, true> {
+  UR variance;
+
+  void fill(JsonObject &doc) {
+    JsonObject item = doc.createNestedObject("variance");
+    this->variance.fill(item);
+  }
+
+  template <typename C> void codec(C &c) { this->variance.codec(c); }
+};
+
+/**
+ * Statistics of the records of a window, sent instead of the records.
+ *
+ * It provides fill and codec, so it can be used as userRecord.
+ *
+ * It is generic over:
+ * - UR userRecord: record being summarized, must provide a codec method
+ *                  (see DeltaState) listing its numeric fields, at most
+ *                  AGGREGATE_MAX_FIELDS.
+ * - V variance: true to also compute the variance of each field.
+ */
+template <typename UR, bool V = false>
+struct Summary : public SummaryVariance<UR, V> {
+  uint16_t count;
+  UR last;
+  UR min;
+  UR max;
+  UR mean;
+
+  void fill(JsonObject &doc) {
+    doc["count"] = this->count;
+    JsonObject item = doc.createNestedObject("last");
+    this->last.fill(item);
+    item = doc.createNestedObject("min");
+    this->min.fill(item);
+    item = doc.createNestedObject("max");
+    this->max.fill(item);
+    item = doc.createNestedObject("mean");
+    this->mean.fill(item);
+    SummaryVariance<UR, V>::fill(doc);
+  }
+
+  template <typename C> void codec(C &c) {
+    c.field("count", this->count);
+    this->last.codec(c);
+    this->min.codec(c);
+    this->max.codec(c);
+    this->mean.codec(c);
+    SummaryVariance<UR, V>::codec(c);
+  }
+};
+
+// true for a Summary.
+template <typename R> struct IsSummary : std::false_type {};
+
+template <typename UR, bool V>
+struct IsSummary<Summary<UR, V>> : std::true_type {};
+
+/**
+ * Stage between the measurements and the buffer.
+ *
+ * By default records are stored as measured.
+ *
+ * It is generic over:
+ * - UR userRecord: measured record.
+ * - SR storedRecord: record stored in the buffer and sent.
+ */
+template <typename UR, typename SR> class Aggregator {
+
+public:
+  // Add a measured record.
+  // return true if stored holds a record to be buffered.
+  bool add(const Record<UR> &record, Record<SR> &stored) {
+    stored = record;
+    return true;
+  }
+
+  void setWindow(unsigned long window) {}
+};
+
+/**
+ * Summarizes the records measured over a window.
+ *
+ * A window starts with its first record. The summary is produced
+ * when a record arrives after the end of the window, and that record
+ * starts the next one. The summary carries the time of the first record.
+ */
+template <typename UR, bool V> class Aggregator<UR, Summary<UR, V>> {
+
+private:
+  // Reads the fields of a record.
+  class Reader {
+  public:
+    double *values;
+    size_t index = 0;
+
+    Reader(double *values) : values(values) {}
+
+    template <typename T> void field(const char *name, T &value) {
+      if (this->index < AGGREGATE_MAX_FIELDS) {
+        this->values[this->index] = (double)value;
+      }
+      this->index++;
+    }
+
+    template <typename T, typename S>
+    void field(const char *name, T &value, S scale) {
+      this->field(name, value);
+    }
+  };
+
+  // Writes the fields of a record.
+  class Writer {
+  public:
+    const double *values;
+    size_t index = 0;
+
+    Writer(const double *values) : values(values) {}
+
+    template <typename T> void field(const char *name, T &value) {
+      double v = 0;
+      if (this->index < AGGREGATE_MAX_FIELDS) {
+        v = this->values[this->index];
+      }
+      if (std::is_integral<T>::value) {
+        value = (T)llround(v);
+      } else {
+        value = (T)v;
+      }
+      this->index++;
+    }
+
+    template <typename T, typename S>
+    void field(const char *name, T &value, S scale) {
+      this->field(name, value);
+    }
+  };
+
+  // Length (in ms) of the window.
+  unsigned long _window = 60000;
+
+  // State of the current window.
+  uint16_t _count = 0;
+  Record<UR> _first;
+  size_t _fields = 0;
+  double _last[AGGREGATE_MAX_FIELDS];
+  double _min[AGGREGATE_MAX_FIELDS];
+  double _max[AGGREGATE_MAX_FIELDS];
+  double _sum[AGGREGATE_MAX_FIELDS];
+  double _sumSquares[AGGREGATE_MAX_FIELDS];
+
+  void _write(UR &record, const double *values) const {
+    Writer writer(values);
+    record.codec(writer);
+  }
+
+  void _summarize(Record<Summary<UR, V>> &stored) {
+    stored.uptime = this->_first.uptime;
+    stored.timestamp = this->_first.timestamp;
+    stored.timestampMs = this->_first.timestampMs;
+    stored.channel = this->_first.channel;
+
+    Summary<UR, V> &summary = stored.userRecord;
+    summary.count = this->_count;
+    double values[AGGREGATE_MAX_FIELDS];
+    for (size_t n = 0; n < this->_fields; n++) {
+      values[n] = this->_sum[n] / this->_count;
+    }
+    this->_write(summary.mean, values);
+    this->_write(summary.last, this->_last);
+    this->_write(summary.min, this->_min);
+    this->_write(summary.max, this->_max);
+    this->_variance(summary, values, std::integral_constant<bool, V>());
+  }
+
+  void _variance(Summary<UR, V> &summary, const double *mean,
+                 std::true_type) {
+    double values[AGGREGATE_MAX_FIELDS];
+    for (size_t n = 0; n < this->_fields; n++) {
+      values[n] = this->_sumSquares[n] / this->_count - mean[n] * mean[n];
+      if (values[n] < 0) {
+        values[n] = 0;
+      }
+    }
+    this->_write(summary.variance, values);
+  }
+
+  void _variance(Summary<UR, V> &summary, const double *mean,
+                 std::false_type) {}
+
+public:
+  bool add(const Record<UR> &record, Record<Summary<UR, V>> &stored) {
+    bool done = this->_count > 0 &&
+                record.uptime - this->_first.uptime >= this->_window;
+    if (done) {
+      this->_summarize(stored);
+      this->_count = 0;
+    }
+
+    double values[AGGREGATE_MAX_FIELDS];
+    Reader reader(values);
+    UR sample = record.userRecord;
+    sample.codec(reader);
+    this->_fields = reader.index < AGGREGATE_MAX_FIELDS ? reader.index
+                                                        : AGGREGATE_MAX_FIELDS;
+
+    if (this->_count == 0) {
+      this->_first = record;
+      for (size_t n = 0; n < this->_fields; n++) {
+        this->_min[n] = values[n];
+        this->_max[n] = values[n];
+        this->_sum[n] = 0;
+        this->_sumSquares[n] = 0;
+      }
+    }
+    for (size_t n = 0; n < this->_fields; n++) {
+      this->_last[n] = values[n];
+      if (values[n] < this->_min[n]) {
+        this->_min[n] = values[n];
+      }
+      if (values[n] > this->_max[n]) {
+        this->_max[n] = values[n];
+      }
+      this->_sum[n] += values[n];
+      this->_sumSquares[n] += values[n] * values[n];
+    }
+    if (this->_count < 65535) {
+      this->_count++;
+    }
+    return done;
+  }
+
+  // Length (in ms) of the window.
+  void setWindow(unsigned long window) { this->_window = window; }
+};
+
+} // namespace sensino
@@ -0,0 +1,124 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Heap allocation accounting and static storage mode.
+ *
+ * Define SENSINO_STATIC before including the library to build the Client
+ * with fixed size storage only: JSON documents, body and headers are sized
+ * at compile time from the template parameters and the macros below, and
+ * no heap allocation happens while measuring and sending.
+ *
+ */
+#pragma once
+
+#include <stdlib.h>
+
+#include <ArduinoJson.h>
+
+// Capacity (in bytes) of the JSON document of a record or an answer.
+#ifndef SENSINO_DOC_SIZE
+#define SENSINO_DOC_SIZE 300
+#endif
+
+// Capacity (in bytes) of the JSON document of a batch whose body takes up
+// to size bytes: each value takes up to about twice its serialized size.
+#define SENSINO_BATCH_DOC_SIZE(size) (SENSINO_DOC_SIZE + 2 * (size))
+
+// Size (in bytes) of the static body buffer. It bounds the batch body
+// (see setBatchBytes) and must hold the device info.
+#ifndef SENSINO_BATCH_BYTES
+#define SENSINO_BATCH_BYTES 1024
+#endif
+
+// Room (in bytes) for a delta encoded record sent on its own (without a
+// batch budget). It must fit in the static body buffer.
+#ifndef SENSINO_DELTA_BYTES
+#define SENSINO_DELTA_BYTES                                                    \
+  (SENSINO_BATCH_BYTES < 300 ? SENSINO_BATCH_BYTES : 300)
+#endif
+
+// Room (in bytes) for the SNO-USER-* headers.
+#ifndef SENSINO_CONFIG_HEADERS_SIZE
+#define SENSINO_CONFIG_HEADERS_SIZE 256
+#endif
+
+// Room (in bytes) for all the headers of a request.
+#ifndef SENSINO_HEADERS_SIZE
+#define SENSINO_HEADERS_SIZE (192 + SENSINO_CONFIG_HEADERS_SIZE)
+#endif
+
+namespace sensino {
+
+typedef void (*AllocationHook)(size_t size);
+
+/**
+ * Counts the heap allocations done by the library.
+ *
+ * Useful to check that none happens in steady state:
+ *
+ *   unsigned long before = Allocations::count();
+ *   client.loop();
+ *   assert(Allocations::count() == before);
+ *
+ * A hook can be set to be called on each allocation, e.g. to log them.
+ */
+class Allocations {
+
+private:
+  static unsigned long &_count() {
+    static unsigned long count = 0;
+    return count;
+  }
+
+  static AllocationHook &_hook() {
+    static AllocationHook hook = nullptr;
+    return hook;
+  }
+
+public:
+  // Register an allocation of size bytes.
+  static void add(size_t size) {
+    _count()++;
+    if (_hook() != nullptr) {
+      _hook()(size);
+    }
+  }
+
+  // Number of allocations so far.
+  static unsigned long count() { return _count(); }
+
+  // Function called on each allocation.
+  static void setHook(AllocationHook hook) { _hook() = hook; }
+};
+
+/**
+ * ArduinoJson allocator that registers its allocations.
+ */
+struct CountingAllocator {
+  void *allocate(size_t size) {
+    Allocations::add(size);
+    return malloc(size);
+  }
+
+  void deallocate(void *pointer) { free(pointer); }
+
+  void *reallocate(void *pointer, size_t size) {
+    Allocations::add(size);
+    return realloc(pointer, size);
+  }
+};
+
+// JSON document with a capacity given at runtime, on the heap.
+typedef BasicJsonDocument<CountingAllocator> HeapDocument;
+
+#if defined(SENSINO_STATIC)
+// JSON document with a fixed capacity, on the stack or in the object.
+template <size_t N> using Document = StaticJsonDocument<N>;
+#else
+template <size_t N> class Document : public HeapDocument {
+public:
+  Document() : HeapDocument(N) {}
+};
+#endif
+
+} // namespace sensino
@@ -0,0 +1,122 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Retry policy for requests to a failing server.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+namespace sensino {
+
+enum class BREAKER_STATE {
+  CLOSED,    // Requests flow normally.
+  OPEN,      // Too many failures, requests are held back.
+  HALF_OPEN, // A single probe request is allowed.
+};
+
+/**
+ * Exponential backoff with jitter and a circuit breaker.
+ *
+ * After each consecutive failure, the next request waits
+ * base * 2^(failures - 1) ms (capped to the maximum), half of it fixed and
+ * half random, so that a fleet of devices does not retry in sync. A delay
+ * given by the server (Retry-After) is honored when longer.
+ *
+ * After threshold consecutive failures the breaker opens: once the delay
+ * expires a single (small) probe request is allowed, and only its success
+ * closes the breaker to resume the normal flow.
+ */
+class Backoff {
+
+private:
+  unsigned long _base = 1000;  // In ms
+  unsigned long _max = 300000; // In ms
+  unsigned int _threshold = 3;
+
+  unsigned int _failures = 0;
+  unsigned long _failedAt = 0; // In ms
+  unsigned long _delay = 0;    // In ms
+
+  BREAKER_STATE _state = BREAKER_STATE::CLOSED;
+
+  // Times the breaker opened (from CLOSED).
+  unsigned long _opens = 0;
+
+public:
+  // true if a request can be sent now.
+  bool canSend() {
+    if (this->_failures == 0) {
+      return true;
+    }
+    if (millis() - this->_failedAt < this->_delay) {
+      return false;
+    }
+    if (this->_state == BREAKER_STATE::OPEN) {
+      this->_state = BREAKER_STATE::HALF_OPEN;
+    }
+    return true;
+  }
+
+  // true if the next request is a probe, and should be small.
+  bool isProbing() const { return this->_state == BREAKER_STATE::HALF_OPEN; }
+
+  void success() {
+    this->_failures = 0;
+    this->_delay = 0;
+    this->_state = BREAKER_STATE::CLOSED;
+  }
+
+  // A request failed, retryAfter (in ms) is the delay asked by the server.
+  void failure(unsigned long retryAfter = 0) {
+    if (this->_failures < 32) {
+      this->_failures++;
+    }
+    // Doubled once per failure, saturating at the maximum.
+    unsigned long delay = this->_base < this->_max ? this->_base : this->_max;
+    for (unsigned int n = 1; n < this->_failures && delay < this->_max; n++) {
+      delay = delay > this->_max / 2 ? this->_max : delay * 2;
+    }
+    delay = delay / 2 + random(delay / 2 + 1);
+    if (retryAfter > delay) {
+      delay = retryAfter;
+    }
+    this->_delay = delay;
+    this->_failedAt = millis();
+
+    // A failed probe opens it again, without counting a new opening.
+    if (this->_state == BREAKER_STATE::HALF_OPEN) {
+      this->_state = BREAKER_STATE::OPEN;
+    } else if (this->_failures >= this->_threshold &&
+               this->_state == BREAKER_STATE::CLOSED) {
+      this->_state = BREAKER_STATE::OPEN;
+      this->_opens++;
+    }
+  }
+
+  // Delay (in ms) after the first failure, and maximum delay.
+  void setDelays(unsigned long base, unsigned long max) {
+    this->_base = base > 0 ? base : 1;
+    this->_max = max;
+  }
+
+  // Consecutive failures that open the breaker.
+  void setThreshold(unsigned int value) { this->_threshold = value; }
+
+  BREAKER_STATE getState() const { return this->_state; }
+
+  unsigned int getFailures() const { return this->_failures; }
+
+  // Time (in ms) until a request can be sent.
+  unsigned long getWait() const {
+    unsigned long elapsed = millis() - this->_failedAt;
+    return this->_failures == 0 || elapsed >= this->_delay
+               ? 0
+               : this->_delay - elapsed;
+  }
+
+  unsigned long getOpens() const { return this->_opens; }
+};
+
+} // namespace sensino
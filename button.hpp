@@ -4,8 +4,59 @@
  */
 #pragma once
 
+#include <Arduino.h>
+
+#include <type_traits>
+
+// Number of states with callbacks added by addState.
+#ifndef BUTTON_MAX_STATES
+#define BUTTON_MAX_STATES 10
+#endif
+
+// Transitions recorded by the interrupt and not yet handled.
+#ifndef BUTTON_EVENTS
+#define BUTTON_EVENTS 16
+#endif
+
+// Time (in ms) between reads of the pin when idle, when polled
+// and with interrupts.
+#ifndef BUTTON_POLL_PERIOD
+#define BUTTON_POLL_PERIOD 10
+#endif
+#ifndef BUTTON_IDLE_PERIOD
+#define BUTTON_IDLE_PERIOD 50
+#endif
+
 namespace sensino {
 
+/**
+ * Callbacks of a state of a Button, to build a dispatch table.
+ * Either can be nullptr to stay in the state.
+ */
+template <typename E> struct ButtonTransition {
+  E (*pressed)();
+  E (*released)();
+};
+
+/**
+ * Number of states of E, given by a COUNT element after the others,
+ * or 0 if there is none.
+ */
+template <typename E, typename = void> struct ButtonStates {
+  static const size_t value = 0;
+};
+
+template <typename E> struct ButtonStates<E, decltype((void)E::COUNT)> {
+  static const size_t value = static_cast<size_t>(E::COUNT);
+};
+
+/**
+ * Dispatch table of a Button, with an entry per state of E
+ * (see ButtonStates).
+ */
+template <typename E>
+using ButtonTable = ButtonTransition<E>[ButtonStates<E>::value];
+
 /**
  * Handles pressing a button to choose from a menu.
  *
@@ -17,72 +68,251 @@ namespace sensino {
  *      menu items and must contain a RELEASED element.
  *
  * Callbacks must be provided to act on button pressed or release.
- * - Button pressed callback must return the next state after a
- *   "persistence" number of loops calls has been done.
+ * - Button pressed callback must return the next state when pressed and
+ *   then after a "persistence" number of loop calls while kept pressed, or
+ *   every "persistence" ms if set with setPersistenceMs (recommended, as
+ *   it does not depend on how often loop runs).
  * - Button release callback must return the next state upon release.
+ *
+ * Callbacks can be added by state with addState, or given all at once as
+ * a table of ButtonTransition indexed by the states. With a COUNT element
+ * last in E, the table is sized from it, e.g.
+ *
+ *   constexpr ButtonTable<Menu> menu = {{nextA, nullptr}, ...};
+ *   button.setTable(menu);
+ *
+ * The level of the pin only counts once it has been stable for
+ * "debounce" ms. It is polled by loop, or with begin(true) its changes are
+ * recorded (with their time) by an interrupt and handled by loop, so short
+ * presses are not missed and timings do not depend on the loop.
  */
 template <typename E> class Button {
 
+#if defined(SENSINO_STATIC)
+  typedef E (*THandlerFunction_PressedReleased)();
+#else
   typedef std::function<E()> THandlerFunction_PressedReleased;
+#endif
 
 private:
+  // Level change of the pin, recorded by the interrupt.
+  struct Event {
+    unsigned long at; // In ms
+    bool pressed;
+  };
+
   // Pin number in the board connected to the button.
   unsigned char _button_pin;
 
   // State
   int _pressed_state;
 
-  // Number of loop iterations to show a menu item.
-  unsigned int _persistence = 10;
+  // Time (in ms) to show a menu item, or 0 to count loop calls.
+  unsigned long _persistence = 0;
+
+  // Number of loop calls to show a menu item, and calls so far.
+  unsigned int _persistenceLoops = 10;
+  unsigned int _pressedLoops = 0;
+
+  // Time (in ms) the level must be stable to count.
+  unsigned long _debounce = 30;
 
   // Current state.
   E _state = E::RELEASED;
 
   // Stores Press and Release callbacks.
-  THandlerFunction_PressedReleased _callbacks_pressed[10];
-  THandlerFunction_PressedReleased _callbacks_released[10];
+  THandlerFunction_PressedReleased _callbacks_pressed[BUTTON_MAX_STATES];
+  THandlerFunction_PressedReleased _callbacks_released[BUTTON_MAX_STATES];
+
+  // Table of callbacks, used instead of the above when set.
+  const ButtonTransition<E> *_table = nullptr;
+  size_t _tableSize = 0;
+
+  // Last level read and since when (in ms), and debounced level.
+  bool _raw = false;
+  unsigned long _rawSince = 0;
+  bool _pressed = false;
+
+  // Time (in ms) of the last move through the menu while pressed.
+  unsigned long _movedAt = 0;
+
+  // Ring of level changes, written by the interrupt and read by loop.
+  bool _interrupt = false;
+  Event _events[BUTTON_EVENTS];
+  volatile uint8_t _head = 0;
+  volatile uint8_t _tail = 0;
+  volatile unsigned long _lost = 0;
+
+  static void IRAM_ATTR _isr(void *arg) {
+    Button *button = static_cast<Button *>(arg);
+    uint8_t head = button->_head;
+    uint8_t next = (head + 1) % BUTTON_EVENTS;
+    if (next == button->_tail) {
+      button->_lost++;
+      return;
+    }
+    button->_events[head].at = millis();
+    button->_events[head].pressed =
+        digitalRead(button->_button_pin) == button->_pressed_state;
+    button->_head = next;
+  }
+
+  // Next state from the callbacks of the current state.
+  E _next(bool pressed) {
+    size_t index = static_cast<size_t>(this->_state);
+    if (this->_table != nullptr) {
+      if (index >= this->_tableSize) {
+        return this->_state;
+      }
+      E (*fn)() = pressed ? this->_table[index].pressed
+                          : this->_table[index].released;
+      return fn != nullptr ? fn() : this->_state;
+    }
+    if (index >= BUTTON_MAX_STATES) {
+      return this->_state;
+    }
+    THandlerFunction_PressedReleased &fn =
+        pressed ? this->_callbacks_pressed[index]
+                : this->_callbacks_released[index];
+    return fn != nullptr ? fn() : this->_state;
+  }
+
+  // The debounced level changed at a given time.
+  void _change(bool pressed, unsigned long at) {
+    this->_pressed = pressed;
+    this->_state = this->_next(pressed);
+    this->_movedAt = at;
+    this->_pressedLoops = 0;
+  }
+
+  // Level read at a given time.
+  void _input(bool pressed, unsigned long at) {
+    if (pressed == this->_raw) {
+      return;
+    }
+    // The previous level counts if it lasted long enough.
+    if (this->_raw != this->_pressed &&
+        at - this->_rawSince >= this->_debounce) {
+      this->_change(this->_raw, this->_rawSince);
+    }
+    this->_raw = pressed;
+    this->_rawSince = at;
+  }
 
 public:
+  // persistence is a number of loop calls (10 if 0), see setPersistenceMs.
   Button(unsigned char button_pin, int pressed_state, unsigned int persistence)
       : _button_pin(button_pin), _pressed_state(pressed_state) {
     if (persistence == 0) {
-      this->_persistence = 10;
+      this->_persistenceLoops = 10;
     } else {
-      this->_persistence = persistence;
+      this->_persistenceLoops = persistence;
+    }
+  }
+
+  // Start reading the button, with interrupts (on both edges) if true.
+  void begin(bool interrupt = false) {
+    this->_interrupt = interrupt;
+    if (interrupt) {
+      attachInterruptArg(digitalPinToInterrupt(this->_button_pin), _isr, this,
+                         CHANGE);
     }
   }
 
   // Current state
   E getState() const { return this->_state; }
 
+  // Time (in ms) the level must be stable to count.
+  void setDebounce(unsigned long value) { this->_debounce = value; }
+
+  // Time (in ms) to show a menu item while pressed, instead of the number
+  // of loop calls given to the constructor. 0 counts loop calls again.
+  void setPersistenceMs(unsigned long value) { this->_persistence = value; }
+
+  // Number of level changes lost because loop was too late.
+  unsigned long getLost() const { return this->_lost; }
+
   // Add state to their corresponding callbacks. These callbacks must return the
   // next state.
-  void addState(E _state, THandlerFunction_PressedReleased _fcnPressed,
+  // return false if the state is beyond BUTTON_MAX_STATES.
+  bool addState(E _state, THandlerFunction_PressedReleased _fcnPressed,
                 THandlerFunction_PressedReleased _fcnReleased) {
-    this->_callbacks_pressed[static_cast<unsigned int>(_state)] = _fcnPressed;
-    this->_callbacks_released[static_cast<unsigned int>(_state)] = _fcnReleased;
+    size_t index = static_cast<size_t>(_state);
+    if (index >= BUTTON_MAX_STATES) {
+      return false;
+    }
+    this->_callbacks_pressed[index] = _fcnPressed;
+    this->_callbacks_released[index] = _fcnReleased;
+    return true;
+  }
+
+  // Use a table of callbacks indexed by the states, instead of addState.
+  // The table must live as long as the button (e.g. constexpr or static).
+  template <size_t N> void setTable(const ButtonTransition<E> (&table)[N]) {
+    static_assert(ButtonStates<E>::value == 0 || N == ButtonStates<E>::value,
+                  "The table must have an entry per state of E.");
+    this->_table = table;
+    this->_tableSize = N;
   }
 
   // Call this in your arduino loop.
-  void loop() {
-    static unsigned int buttonPressingCount = this->_persistence;
-    static E nextState = E::RELEASED;
-
-    if (digitalRead(this->_button_pin) == this->_pressed_state) {
-      nextState =
-          this->_callbacks_pressed[static_cast<unsigned int>(this->_state)]();
-      buttonPressingCount--;
-      if (this->_state == E::RELEASED || buttonPressingCount == 0) {
-        buttonPressingCount = this->_persistence;
-        this->_state = nextState;
+  void loop() { this->run(); }
+
+  // Handle the changes of the button (e.g. as a Scheduler task).
+  // return the time (in ms) until it must run again.
+  unsigned long run() {
+    if (this->_interrupt) {
+      while (this->_tail != this->_head) {
+        const Event &event = this->_events[this->_tail];
+        this->_input(event.pressed, event.at);
+        this->_tail = (this->_tail + 1) % BUTTON_EVENTS;
       }
+    }
+    // Read after the events, which can be newer than a time read before.
+    unsigned long now = millis();
+    // Also with interrupts, in case a change was lost.
+    this->_input(digitalRead(this->_button_pin) == this->_pressed_state, now);
 
-    } else {
+    if (this->_raw != this->_pressed &&
+        now - this->_rawSince >= this->_debounce) {
+      this->_change(this->_raw, this->_rawSince);
+    }
+    if (this->_pressed && this->_persistence == 0) {
+      // Counting this call, which may be the one of the press.
+      if (this->_pressedLoops++ >= this->_persistenceLoops) {
+        this->_state = this->_next(true);
+        this->_pressedLoops = 1;
+      }
+    } else if (this->_pressed &&
+               now - this->_movedAt >= this->_persistence) {
+      this->_state = this->_next(true);
+      this->_movedAt = now;
+    }
+    return this->getIdleTime();
+  }
 
-      this->_state =
-          this->_callbacks_released[static_cast<unsigned int>(this->_state)]();
-      buttonPressingCount = this->_persistence;
+  // Time (in ms) until something can change: the end of the debounce or
+  // the next move through the menu, otherwise the next read of the pin.
+  unsigned long getIdleTime() const {
+    unsigned long now = millis();
+    unsigned long idle =
+        this->_interrupt ? BUTTON_IDLE_PERIOD : BUTTON_POLL_PERIOD;
+    if (this->_interrupt && this->_tail != this->_head) {
+      return 0;
+    }
+    if (this->_raw != this->_pressed) {
+      unsigned long elapsed = now - this->_rawSince;
+      idle = elapsed < this->_debounce ? this->_debounce - elapsed : 0;
+    } else if (this->_pressed && this->_persistence == 0) {
+      // Loop calls are counted.
+      idle = BUTTON_POLL_PERIOD;
+    } else if (this->_pressed) {
+      unsigned long elapsed = now - this->_movedAt;
+      unsigned long left =
+          elapsed < this->_persistence ? this->_persistence - elapsed : 0;
+      idle = left < idle ? left : idle;
     }
+    return idle;
   }
 };
 } // namespace sensino
@@ -11,20 +11,44 @@
 #include <Arduino.h>
 
 // change next line to use with another board/shield
-#include <ESP8266HTTPClient.h>
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
 
-#include <CircularBuffer.h>
-#include <PolledTimeout.h>
 #include <Vector.h>
 
 #include <ArduinoJson.h>
 
+#include <type_traits>
+
 #include "HTTPTimeClient.hpp"
+#include "aggregate.hpp"
+#include "backoff.hpp"
+#include "deadband.hpp"
+#include "priority.hpp"
+#include "alloc.hpp"
+#include "delta.hpp"
+#include "spool.hpp"
+#include "stats.hpp"
+#include "upload.hpp"
 
 #include "common.h"
 
+// Maximum number of measurement tasks (see addMeasureTask).
+#ifndef MEASURE_MAX_TASKS
+#define MEASURE_MAX_TASKS 4
+#endif
+
+// Time (in ms) to wait for the radio to reconnect, after which a burst
+// (or a blocking request) fails (see setRadioSleep).
+#ifndef RADIO_WAKE_TIMEOUT
+#define RADIO_WAKE_TIMEOUT 10000
+#endif
+
+// Interval (in ms) at which the radio is polled while it reconnects.
+#ifndef RADIO_POLL_INTERVAL
+#define RADIO_POLL_INTERVAL 10
+#endif
+
 namespace sensino {
 
 // Use this to select if a NTP client or a custom HTTP client is used
@@ -41,14 +65,27 @@ HTTPTimeClient timeClient;
  * - onMeasure
  * - afterMeasure
  *
- * The resulting record is stored in the buffer and contains:
+ * More measurement tasks, each with its own period and phase, can be added
+ * (see addMeasureTask). A callback only runs when its tick is due, and
+ * setIdleSleep lets loop sleep until the earliest one.
+ *
+ * The resulting record is stored in the buffer. If the buffer is full and a
+ * spool was set (see setSpool), records are stored in flash and moved back
+ * to the buffer, oldest first, once the buffer has been drained.
+ *
+ * Each record contains:
  * - uptime: current uptime given the arduino device
- * - timestamp: current timestamp, synced with an NTP server
+ * - timestamp: current timestamp (s), synced with an NTP server
+ * - timestampMs: milliseconds part of the timestamp
+ * - channel: measurement task, 0 for onMeasure
  * - userRecord: the result of onMeasure callback
  *
- * These records are sent to the server as JSON:
+ * These records are sent to the server as JSON (or MessagePack or deltas,
+ * see setEncoding):
  * - uptime: see record.uptime
  * - timestamp: see record.timestamp
+ * - timestampMs: see record.timestampMs
+ * - channel: see record.channel, only with several measurement tasks.
  * - ntpEpoch: epoch synced by the NTP server, can be used to monitor the
  * status.
  * - bootID: a random number generated on device startup, can be used to
@@ -56,12 +93,41 @@ HTTPTimeClient timeClient;
  * - userRecord: the result of onMeasure callback.
  *
  *
+ * When batching is enabled (see setBatchBytes), several records are sent
+ * in a single request as JSON:
+ * - ntpEpoch: see above, sent once per batch.
+ * - bootID: see above, sent once per batch.
+ * - records: an array of objects with uptime, timestamp, timestampMs and
+ *   userRecord.
+ *
+ * With SENSINO_STATIC defined (see alloc.hpp), all the storage is fixed
+ * at compile time and loop does not allocate on the heap. The handlers are
+ * then plain function pointers, so lambdas must not capture.
+ *
+ * Records accumulate in the buffer until it holds flushWatermark of them or
+ * the oldest waited flushDeadline (see setFlushPolicy). The buffer is then
+ * drained in one burst over a single connection. With radio sleep enabled
+ * (see setRadioSleep), the WiFi modem is turned off between bursts; the time
+ * client is only updated while it is on, so set a deadline as well.
+ *
+ * After a failed request, the next one waits with an exponential backoff
+ * (honoring Retry-After), and after several failures only a small probe
+ * request is sent until the server answers again (see Backoff).
+ *
+ * Requests are sent by loop in small steps, so that a slow or dead server
+ * does not block the measurements (see Upload). The public send methods
+ * instead block until the server answers.
+ *
  * Another method is available to send device info to the server:
  * - WiFi.macAddress: mac address of the arduino board.
  * - userDeviceInfo: result of calling fillDeviceInfo callback
+ * - stats: runtime statistics (see getStats). Histograms are sent as
+ *   [count, p50, p99, max], durations in us (upload and sync in ms).
  *
  *
  * Additionally, the following information is sent using the headers:
+ * - Content-Type: application/json, application/msgpack or
+ *   application/x-sensino-delta (see delta.hpp).
  * - SNO-API-KEY: can be used to filter calls to the server (defined on client
  * instantiation).
  * - SNO-SERIAL-NUMBER: can be used to identify the device (defined on client
@@ -70,29 +136,65 @@ HTTPTimeClient timeClient;
  * - SNO-METHOD: used to call different methods in the server
  *      0: sendRecord
  *      1: sendDeviceInfo
- * - SNO-USER-*: items in userConfig.
+ *      2: sendBatch
+ * - SNO-CONFIG-HASH: hash (8 hex digits) of the userConfig headers.
+ * - SNO-USER-*: items in userConfig. Only sent when userConfig changes
+ *   and when the server asks for them (see configCheck).
  *
- * The server must response a json with optionally the following items:
+ * The server must response a json (up to UPLOAD_PAYLOAD_SIZE - 1 bytes, longer
+ * ones are ignored) with optionally the following items:
  * - acqPeriod: an unsigned long that indicates the desired acquisition period
  * (ms).
+ * - flushWatermark, flushDeadline, radioSleep: change the flush policy (see
+ *   setFlushPolicy and setRadioSleep).
  * - devInfoCheck: a boolean used to ask the client to send device info.
+ * - configCheck: a boolean used to ask the client to send the SNO-USER-*
+ *   headers in the next request (e.g. the hash is unknown to the server).
  * - userServerPayload: the result is sent to onUserServerPayload and can be
  * used to modify user settings.
  *
  *
  * It is generic over:
  * - UR userRecord: measure information is sent to the client.
- * - UC userConfig: configuration information.
+ * - UC userConfig: configuration information. If trivially copyable (as it
+ *                 must be with SENSINO_STATIC), its headers are only rendered
+ *                 again when its bytes change.
  * - BS bufferSize: how many elements are stored
  *                  in the buffer before sending.
+ * - SR storedRecord: userRecord stored in the buffer and sent, UR by default.
+ *                    With Summary<UR> (see aggregate.hpp), the measurements
+ *                    are summarized over a window (see setAggregationWindow)
+ *                    and only the summaries are stored and sent, while
+ *                    measure still runs at full rate.
+ * - AS alarmBufferSize: how many records classified as alarms (see
+ *                       onClassify) are stored apart from the BS routine
+ *                       ones, a quarter of BS by default.
  *
  */
-template <typename UR, typename UC, size_t BS> class Client {
-
+template <typename UR, typename UC, size_t BS, typename SR = UR,
+          size_t AS = (BS + 3) / 4>
+class Client {
+
+#if defined(SENSINO_STATIC)
+  typedef std::pair<UR, bool> (*THandlerFunction_Measure)();
+  typedef bool (*THandlerFunction_Read)(const JsonObject &doc);
+  typedef bool (*THandlerFunction_Write)(JsonObject &doc);
+  typedef void (*THandlerFunction_BeforeAfter)();
+  typedef PRIORITY (*THandlerFunction_Classify)(const Record<SR> &record);
+#else
   typedef std::function<std::pair<UR, bool>()> THandlerFunction_Measure;
   typedef std::function<bool(const JsonObject &doc)> THandlerFunction_Read;
   typedef std::function<bool(JsonObject &doc)> THandlerFunction_Write;
   typedef std::function<void()> THandlerFunction_BeforeAfter;
+  typedef std::function<PRIORITY(const Record<SR> &record)>
+      THandlerFunction_Classify;
+#endif
+
+#if defined(SENSINO_STATIC)
+  // Members such as String would allocate (see _refreshConfig).
+  static_assert(std::is_trivially_copyable<UC>::value,
+                "userConfig must be trivially copyable with SENSINO_STATIC.");
+#endif
 
 private:
   // Random number generated when initialized.
@@ -119,30 +221,122 @@ private:
   // true if the warmup has finished.
   bool _isReady = false;
 
-  // Buffer where measurements are stored until sent to the server.
-  CircularBuffer<Record<UR>, BS> _buffer;
-
-  // Ticker
-  esp8266::polledTimeout::periodicMs _acqTicker;
+  // Requests to the server, over a kept alive connection.
+  Upload _upload;
+
+  // Time budget (in us) to advance the request in each loop.
+  unsigned long _uploadBudget = 2000;
+
+  // Records carried by the request in progress, and its method.
+  int _inFlight = 0;
+  int _inFlightMethod = 0;
+  int _inFlightAlarms = 0;
+
+  // true if the server asked for the device info.
+  bool _devInfoPending = false;
+
+  // Retry policy after failed requests.
+  Backoff _backoff;
+
+  // Encoding used for the body of the requests.
+  ENCODING _encoding = ENCODING::JSON;
+
+  // Serialized body (and headers) of the request, grown as needed.
+#if defined(SENSINO_STATIC)
+  char _bodyStorage[SENSINO_BATCH_BYTES];
+  char *_body = _bodyStorage;
+  size_t _bodyCapacity = sizeof(_bodyStorage);
+
+  // Document used to build batches, too large for the stack.
+  Document<SENSINO_BATCH_DOC_SIZE(SENSINO_BATCH_BYTES)> _batchDoc;
+#else
+  char *_body = nullptr;
+  size_t _bodyCapacity = 0;
+#endif
+  size_t _bodyLength = 0;
+  ENCODING _bodyEncoding = ENCODING::JSON;
+  char _headers[SENSINO_HEADERS_SIZE];
+  size_t _headersLength = 0;
+
+  // userConfig when its headers were rendered, to detect changes.
+  UC _configCopy;
+  bool _configRendered = false;
+
+  // SNO-USER-* headers and their hash, rendered when userConfig changes.
+  char _configHeaders[SENSINO_CONFIG_HEADERS_SIZE];
+  size_t _configHeadersLength = 0;
+  uint32_t _configHash = 0;
+
+  // true if the SNO-USER-* headers must be sent, and if the request in
+  // progress carries them.
+  bool _configPending = true;
+  bool _configSending = false;
+
+  // Records wait until there are _flushWatermark of them or the oldest
+  // waited _flushDeadline (in ms, 0 to disable), then the buffer is drained.
+  size_t _flushWatermark = 1;
+  unsigned long _flushDeadline = 0;
+  bool _flushing = false;
+
+  // true to turn the WiFi modem off between bursts.
+  bool _radioSleep = false;
+  bool _radioAsleep = false;
+  unsigned long _radioOnSince = 0; // In ms
+
+  // true when the time client runs as its own task (see runTimeSync).
+  bool _timeSyncTask = false;
+
+  // Runtime statistics, and start (in ms) of the request in progress.
+  ClientStats _stats;
+  unsigned long _uploadStart = 0;
+
+  // Maximum size (in bytes) of the body of a batch request.
+  // 0 disables batching and each record is sent on its own.
+  size_t _batchBytes = 0;
+
+  // Buffer where measurements are stored until sent to the server,
+  // alarms first.
+  PriorityBuffer<Record<SR>, BS, AS> _buffer;
+
+  // Stages between the measurements and the buffer, for each task.
+  Aggregator<UR, SR> _aggregators[MEASURE_MAX_TASKS];
+  Deadband<SR> _deadbands[MEASURE_MAX_TASKS];
+
+  // Overflow storage used when the buffer is full (optional).
+  Spool<Record<SR>> *_spool = nullptr;
+
+  // Measurement tasks. The first one (channel 0) is onMeasureTick and
+  // its period is the acquisition period.
+  struct MeasureTask {
+    THandlerFunction_Measure measure = nullptr;
+    unsigned long period = 0; // In ms
+    unsigned long next = 0;   // In ms
+  };
+  MeasureTask _tasks[MEASURE_MAX_TASKS];
+  uint8_t _taskCount = 1;
+
+  // true to sleep in loop until the next task is due.
+  bool _idleSleep = false;
 
   // Handlers to
   THandlerFunction_BeforeAfter _beforeMeasure = nullptr;
-  THandlerFunction_Measure _onMeasure = nullptr;
   THandlerFunction_BeforeAfter _afterMeasure = nullptr;
   THandlerFunction_Read _onUserServerPayload = nullptr;
   THandlerFunction_Write _fillDeviceInfo = nullptr;
+  THandlerFunction_Classify _classify = nullptr;
 
 public:
   UC userConfig;
 
   Client(const char *endpoint, unsigned int serialNumber, const char *apiKey,
          unsigned long measurePeriodMs)
-      : _acqTicker(0), _endpoint(endpoint), _apiKey(apiKey),
-        _serialNumber(serialNumber) {
+      : _endpoint(endpoint), _serialNumber(serialNumber), _apiKey(apiKey) {
 
     this->userConfig = UC();
 
-    this->_acqTicker.reset(measurePeriodMs);
+    this->_tasks[0].period = measurePeriodMs;
+    this->_tasks[0].next = millis() + measurePeriodMs;
+    this->_upload.begin(endpoint);
   }
 
   void beforeMeasureTick(THandlerFunction_BeforeAfter fn) {
@@ -153,7 +347,88 @@ public:
     this->_afterMeasure = fn;
   }
 
-  void onMeasureTick(THandlerFunction_Measure fn) { this->_onMeasure = fn; }
+  void onMeasureTick(THandlerFunction_Measure fn) {
+    this->_tasks[0].measure = fn;
+  }
+
+  // Add a measurement task, called every period ms, the first time after
+  // phase ms. Its records are tagged with the returned channel.
+  // return the channel, or -1 if there is no room (see MEASURE_MAX_TASKS).
+  int addMeasureTask(unsigned long period, unsigned long phase,
+                     THandlerFunction_Measure fn) {
+    if (this->_taskCount >= MEASURE_MAX_TASKS) {
+      return -1;
+    }
+    MeasureTask &task = this->_tasks[this->_taskCount];
+    task.measure = fn;
+    task.period = period;
+    task.next = millis() + phase;
+    return this->_taskCount++;
+  }
+
+  // Period (in ms) of a measurement task.
+  void setMeasurePeriod(uint8_t channel, unsigned long period) {
+    if (channel < this->_taskCount) {
+      this->_tasks[channel].period = period;
+      this->_tasks[channel].next = millis() + period;
+    }
+  }
+
+  // Time (in ms) until something has to be done in loop:
+  // 0 if a request is in progress or a task is due. It accounts for the
+  // time client, unless it runs as its own task (see setTimeSyncTask).
+  unsigned long getIdleTime() const {
+    bool waiting = this->_backoff.getWait() > 0;
+    bool reconnecting = this->_flushing && this->_upload.isIdle() &&
+                        this->_radioSleep && WiFi.status() != WL_CONNECTED;
+    if (!this->_upload.isIdle() ||
+        (this->_flushing && !waiting && !reconnecting)) {
+      return 0;
+    }
+    unsigned long idle = 4294967295;
+    if (!this->_timeSyncTask && !this->_radioAsleep) {
+      // The next sample of the time update, or the next update.
+      idle = timeClient.getIdleTime();
+    }
+    unsigned long send = 4294967295;
+    if (waiting) {
+      // Nothing to send until the retry delay expires.
+      send = this->_backoff.getWait();
+    } else if (reconnecting) {
+      // Poll the radio until it reconnects (see RADIO_WAKE_TIMEOUT).
+      send = RADIO_POLL_INTERVAL;
+    } else if (!this->_flushing && this->_flushDeadline > 0 &&
+               !this->_buffer.isEmpty()) {
+      // The oldest record must be sent by the flush deadline.
+      unsigned long age = millis() - this->_buffer.first().uptime;
+      if (age >= this->_flushDeadline) {
+        return 0;
+      }
+      send = this->_flushDeadline - age;
+    }
+    if (send < idle) {
+      idle = send;
+    }
+    for (uint8_t channel = 0; channel < this->_taskCount; channel++) {
+      const MeasureTask &task = this->_tasks[channel];
+      if (task.measure == nullptr) {
+        continue;
+      }
+      long left = (long)(task.next - millis());
+      if (left <= 0) {
+        return 0;
+      }
+      if ((unsigned long)left < idle) {
+        idle = left;
+      }
+    }
+    return idle == 4294967295 ? 0 : idle;
+  }
+
+  // Sleep (with delay) at the end of loop until the next task, the flush
+  // deadline or the time client is due (see getIdleTime).
+  // Buttons and screens served in the same loop wait as well.
+  void setIdleSleep(bool value) { this->_idleSleep = value; }
 
   void onUserServerPayload(THandlerFunction_Read fn) {
     this->_onUserServerPayload = fn;
@@ -161,6 +436,11 @@ public:
 
   void fillDeviceInfo(THandlerFunction_Write fn) { this->_fillDeviceInfo = fn; }
 
+  // Classify each record about to be stored (after aggregation and
+  // send-on-delta). Alarms are sent before routine records and have their
+  // own room in the buffer. Without it, all records are routine.
+  void onClassify(THandlerFunction_Classify fn) { this->_classify = fn; }
+
   // Call this method in your setup
   void setup(char *ssid, char *passphrase) {
     randomSeed(analogRead(0));
@@ -178,41 +458,135 @@ public:
 
   // Call this method in your loop
   void loop() {
+    unsigned long idle = this->run();
+    if (this->_idleSleep && idle > 0) {
+      delay(idle);
+    }
+  }
+
+  // Measure, send and update the time client as due, without sleeping
+  // (e.g. as a Scheduler task).
+  // return the time (in ms) until it must run again (see getIdleTime).
+  unsigned long run() {
+    ScopedTimer<micros> loopTimer(this->_stats.loop);
 
     this->_measure_state = MEASURE_STATE::IDLE;
 
-    auto meas = this->measure();
-    if (meas.second) {
-      this->_lastRecord = meas.first;
-      this->_measure_state = MEASURE_STATE::SUCCESS;
-      if (this->_acqTicker) {
-        if (this->_buffer.isFull()) {
-          this->_measure_state = MEASURE_STATE::BUFFER_FULL;
-        } else {
-          this->_measure_state = MEASURE_STATE::STORE;
-          this->_buffer.push(this->_lastRecord);
-        }
-      }
-    } else {
-      this->_measure_state = MEASURE_STATE::ERROR;
+    for (uint8_t channel = 0; channel < this->_taskCount; channel++) {
+      this->_runTask(channel);
+    }
+    if (this->_buffer.size() > this->_stats.highWater) {
+      this->_stats.highWater = this->_buffer.size();
     }
 
-    if (this->_buffer.isEmpty()) {
-      this->_send_state = SEND_STATE::IDLE;
-    } else {
-      if (this->sendPending(1)) {
-        this->_send_state = SEND_STATE::SUCCESS;
-      } else {
-        this->_send_state = SEND_STATE::ERROR;
-      }
+    this->_unspool();
+
+    this->_advanceUpload();
+    if (this->_send_state == SEND_STATE::ERROR) {
+      this->_stats.sendErrors++;
     }
 
+    if (!this->_timeSyncTask && !this->_radioAsleep) {
+      this->_updateTime();
+    }
+
+    return this->getIdleTime();
+  }
+
+  // Update the time client, as its own Scheduler task (see
+  // setTimeSyncTask), while the radio is on.
+  // return the time (in ms) until it must run again.
+  unsigned long runTimeSync() {
+    if (this->_radioAsleep) {
+      // Only the client task wakes the radio up.
+      return this->getIdleTime();
+    }
+    this->_updateTime();
+    return timeClient.getIdleTime();
+  }
+
+  // Leave the time client to runTimeSync instead of run. With radio sleep,
+  // keep it in run, which updates it during the bursts.
+  void setTimeSyncTask(bool value) { this->_timeSyncTask = value; }
+
+  bool getTimeSyncTask() const { return this->_timeSyncTask; }
+
+  void _updateTime() {
+    unsigned long start = micros();
     timeClient.update();
+    this->_stats.timeSync.add(micros() - start);
+  }
+
+  // Measure with a task if its tick is due, and store the record.
+  void _runTask(uint8_t channel) {
+    MeasureTask &task = this->_tasks[channel];
+    if (task.measure == nullptr || (long)(millis() - task.next) < 0) {
+      return;
+    }
+    task.next += task.period;
+    if ((long)(millis() - task.next) >= 0) {
+      // Fell behind, skip the missed ticks.
+      task.next = millis() + task.period;
+    }
+
+    unsigned long start = micros();
+    auto meas = this->measure(channel);
+    this->_stats.measure.add(micros() - start);
+    if (!meas.second) {
+      this->_measure_state = MEASURE_STATE::ERROR;
+      this->_stats.measureErrors++;
+      return;
+    }
+    this->_lastRecord = meas.first;
+
+    // Once routine records go to the spool, new ones follow them
+    // to keep the order. Alarms skip the spool, and can take the place of
+    // the oldest routine record, unless it is being sent.
+    Record<SR> stored;
+    if (!this->_aggregators[channel].add(this->_lastRecord, stored)) {
+      this->_measure_state = MEASURE_STATE::AGGREGATE;
+    } else if (!this->_deadbands[channel].pass(stored)) {
+      this->_measure_state = MEASURE_STATE::SUPPRESSED;
+    } else if (this->_classify != nullptr &&
+               this->_classify(stored) == PRIORITY::ALARM) {
+      if (this->_buffer.push(stored, PRIORITY::ALARM, this->_inFlight == 0)) {
+        this->_measure_state = MEASURE_STATE::STORE;
+      } else {
+        this->_measure_state = MEASURE_STATE::BUFFER_FULL;
+      }
+    } else if (this->_spool != nullptr &&
+               (this->_buffer.isFull(PRIORITY::ROUTINE) ||
+                !this->_spool->isEmpty())) {
+      if (this->_spool->push(stored)) {
+        this->_measure_state = MEASURE_STATE::SPOOL;
+      } else {
+        this->_measure_state = MEASURE_STATE::BUFFER_FULL;
+      }
+    } else if (this->_buffer.isFull(PRIORITY::ROUTINE)) {
+      this->_measure_state = MEASURE_STATE::BUFFER_FULL;
+    } else {
+      this->_measure_state = MEASURE_STATE::STORE;
+      this->_buffer.push(stored, PRIORITY::ROUTINE);
+    }
+    if (this->_measure_state == MEASURE_STATE::BUFFER_FULL) {
+      this->_stats.bufferFull++;
+    }
   }
 
   // Send n records in the buffer to the server.
+  // Blocks until the server answers.
   bool sendPending(uint n) {
     bool success = true;
+    if (this->_isBatching()) {
+      while (!this->_buffer.isEmpty() && n > 0) {
+        int sent = this->sendBatch(n);
+        if (sent <= 0) {
+          return false;
+        }
+        n -= sent;
+      }
+      return success;
+    }
     while (!this->_buffer.isEmpty() && n > 0) {
       if (this->sendRecord(this->_buffer.first())) {
         this->_buffer.shift();
@@ -225,112 +599,720 @@ public:
   }
 
   // Send a record to the server
+  // Blocks until the server answers.
   // return success state.
-  bool sendRecord(Record<UR> record) {
-
-    // Serialize the record to JSON.
-    char body[300];
-    {
-      DynamicJsonDocument doc(300);
-
-      // Time since the device was booted
-      doc["uptime"] = record.uptime;
-      // Time in which the client has synced with the NTP Server.
-      // Useful for debugging
-      doc["ntpEpoch"] = timeClient.getCurrentEpoch();
-      // Current time in UTC.
-      doc["timestamp"] = record.timestamp;
-      // Unique identifier for a boot session.
-      doc["bootID"] = this->_bootID;
-
-      auto docur = doc.createNestedObject("userRecord");
-      record.userRecord.fill(docur);
-      serializeJson(doc, body);
+  bool sendRecord(Record<SR> record) {
+    if (!this->_upload.isIdle()) {
+      return false;
     }
+    return this->_serializeRecord(record) && this->_send(0);
+  }
 
-    return this->_send(body, 0);
+  // Send up to n records in the buffer to the server in a single request.
+  // Records are added (alarms, then oldest first) while the body fits in
+  // the batch budget (see setBatchBytes), but at least one record is always
+  // sent: the document grows for it. With SENSINO_STATIC it cannot, and a
+  // first record that does not fit is dropped (see ClientStats::oversized).
+  // Records are removed from the buffer only if the server accepts the batch.
+  // Blocks until the server answers.
+  // return the number of records sent, or -1 on error.
+  int sendBatch(uint n = BS + AS) {
+    if (!this->_upload.isIdle()) {
+      return -1;
+    }
+    int count = this->_serializeBatch(n);
+    if (count < 0) {
+      this->_dropOversized(2);
+    }
+    if (count <= 0) {
+      return count;
+    }
+    if (!this->_send(2)) {
+      return -1;
+    }
+    for (int i = 0; i < count; i++) {
+      this->_buffer.shift();
+    }
+    return count;
   }
 
   // Send device information to the server
+  // Blocks until the server answers.
   // return success state.
   bool sendDeviceInfo() {
+    if (!this->_upload.isIdle()) {
+      return false;
+    }
+    return this->_serializeDeviceInfo() && this->_send(1);
+  }
 
-    // Serialize the record to JSON.
-    char body[300];
-    {
-      DynamicJsonDocument doc(300);
+  // Serialize a record (with the shared fields) in the body buffer.
+  // return false if it does not fit in the document, which only happens
+  // with SENSINO_STATIC (see SENSINO_DOC_SIZE), otherwise it grows.
+  bool _serializeRecord(Record<SR> record) {
+    ScopedTimer<micros> timer(this->_stats.serialize);
+
+#if defined(SENSINO_STATIC)
+    Document<SENSINO_DOC_SIZE> doc;
+    return this->_buildRecord(doc, record) && this->_serializeDocument(doc);
+#else
+    for (size_t capacity = SENSINO_DOC_SIZE;; capacity *= 2) {
+      HeapDocument doc(capacity);
+      if (this->_buildRecord(doc, record)) {
+        return this->_serializeDocument(doc);
+      }
+      if (doc.capacity() == 0) {
+        return false;
+      }
+    }
+#endif
+  }
 
-      // Arduino mad address.
-      doc["WiFi.macAddress"] = WiFi.macAddress();
+  // Fill a document with a record and the shared fields.
+  // return false if it does not fit.
+  bool _buildRecord(JsonDocument &doc, const Record<SR> &record) const {
+    JsonObject root = doc.to<JsonObject>();
 
-      if (this->_fillDeviceInfo != nullptr) {
-        auto docur = doc.createNestedObject("userDeviceInfo");
-        this->_fillDeviceInfo(docur);
+    this->_fillRecord(root, record);
+    // Time in which the client has synced with the NTP Server.
+    // Useful for debugging
+    root["ntpEpoch"] = timeClient.getCurrentEpoch();
+    // Unique identifier for a boot session.
+    root["bootID"] = this->_bootID;
+
+    return !doc.overflowed();
+  }
+
+  // Serialize up to n records of the buffer as a batch in the body buffer.
+  // return the number of records in the batch, or -1 on error.
+  int _serializeBatch(uint n) {
+    ScopedTimer<micros> timer(this->_stats.serialize);
+    if (this->_buffer.isEmpty() || n == 0) {
+      return 0;
+    }
+    if (n > this->_buffer.size()) {
+      n = this->_buffer.size();
+    }
+
+    if (this->_encoding == ENCODING::DELTA) {
+      return this->_serializeDelta(
+          n, std::integral_constant<bool, HasCodec<SR>::value>());
+    }
+
+#if defined(SENSINO_STATIC)
+    JsonDocument &doc = this->_batchDoc;
+    uint count = this->_buildBatch(doc, n);
+    // Not even the first record fits in the document.
+    if (count == 0 || !this->_serializeDocument(doc)) {
+      return -1;
+    }
+    return count;
+#else
+    // Grow the document until at least the first record fits.
+    for (size_t capacity = SENSINO_BATCH_DOC_SIZE(this->_batchBytes);;
+         capacity *= 2) {
+      HeapDocument doc(capacity);
+      if (doc.capacity() == 0) {
+        return -1;
       }
+      uint count = this->_buildBatch(doc, n);
+      if (count > 0) {
+        return this->_serializeDocument(doc) ? count : -1;
+      }
+    }
+#endif
+  }
+
+  // Fill a document with up to n records of the buffer and the shared
+  // fields, while they fit in it and in the batch budget.
+  // return the number of records, 0 if not even the first one fits.
+  uint _buildBatch(JsonDocument &doc, uint n) const {
+    doc.clear();
+    // Shared fields go once per batch.
+    doc["bootID"] = this->_bootID;
+    doc["ntpEpoch"] = timeClient.getCurrentEpoch();
+    JsonArray records = doc.createNestedArray("records");
+
+    uint count = 0;
+    while (count < n) {
+      JsonObject item = records.createNestedObject();
+      this->_fillRecord(item, this->_buffer[count]);
+      if (doc.overflowed() ||
+          (count > 0 && this->_measure(doc) > this->_batchBytes)) {
+        records.remove(count);
+        break;
+      }
+      count++;
+    }
+    return count;
+  }
+
+  // Serialize up to n records encoded as deltas (see DeltaEncoder).
+  // Without batching, a single record is serialized.
+  // return the number of records in the batch, or -1 on error.
+  int _serializeDelta(uint n, std::true_type) {
+    size_t budget = this->_batchBytes;
+    if (budget == 0) {
+      budget = SENSINO_DELTA_BYTES;
+      n = 1;
+    }
+    if (!this->_reserveBody(budget < SENSINO_DELTA_BYTES ? SENSINO_DELTA_BYTES
+                                                         : budget)) {
+      return -1;
+    }
+
+    DeltaEncoder encoder((uint8_t *)this->_body, budget);
+    encoder.begin(this->_bootID, timeClient.getCurrentEpoch());
 
-      serializeJson(doc, body);
+    uint count = 0;
+    while (count < n && encoder.add(this->_buffer[count])) {
+      count++;
     }
 
-    return this->_send(body, 1);
+    // At least one record is always sent.
+    if (count == 0) {
+      encoder = DeltaEncoder((uint8_t *)this->_body, this->_bodyCapacity);
+      encoder.begin(this->_bootID, timeClient.getCurrentEpoch());
+      if (!encoder.add(this->_buffer.first())) {
+        return -1;
+      }
+      count = 1;
+    }
+
+    this->_bodyLength = encoder.length();
+    this->_bodyEncoding = ENCODING::DELTA;
+    return count;
   }
 
-  bool _send(const char *jsonString, const int method) {
+  // The userRecord has no codec, delta encoding is not available.
+  int _serializeDelta(uint n, std::false_type) { return -1; }
 
-    HTTPClient http;
-    http.begin(this->_endpoint);
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("SNO-API-KEY", this->_apiKey);
-    http.addHeader("SNO-SERIAL-NUMBER", String(this->_serialNumber));
-    http.addHeader("SNO-ACQ-PERIOD", String(this->_acqTicker.getTimeout()));
-    http.addHeader("SNO-METHOD", String(method));
+  // Serialize device information in the body buffer.
+  bool _serializeDeviceInfo() {
+    ScopedTimer<micros> timer(this->_stats.serialize);
 
-    // Serialize the UserConfig to HTTP headers.
-    {
-      DynamicJsonDocument docConfig(300);
-      this->userConfig.fill(docConfig);
+    Document<SENSINO_DOC_SIZE + STATS_DOC_SIZE> doc;
 
-      JsonObject root = docConfig.as<JsonObject>();
-      for (JsonPair item : root) {
-        http.addHeader("SNO-USER-" + String(item.key().c_str()),
-                       item.value().as<String>());
+    // Arduino mad address.
+    uint8_t mac[6];
+    char macAddress[18];
+    WiFi.macAddress(mac);
+    snprintf(macAddress, sizeof(macAddress), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    doc["WiFi.macAddress"] = (const char *)macAddress;
+
+    if (this->_fillDeviceInfo != nullptr) {
+      auto docur = doc.createNestedObject("userDeviceInfo");
+      this->_fillDeviceInfo(docur);
+    }
+
+    JsonObject stats = doc.createNestedObject("stats");
+    this->_fillHistogram(stats, "loop", this->_stats.loop);
+    this->_fillHistogram(stats, "measure", this->_stats.measure);
+    this->_fillHistogram(stats, "serialize", this->_stats.serialize);
+    this->_fillHistogram(stats, "upload", this->_stats.upload);
+    this->_fillHistogram(stats, "timeSync", this->_stats.timeSync);
+    this->_fillHistogram(stats, "sync", timeClient.getSyncStats());
+    stats["syncFailures"] = timeClient.getFailures();
+    stats["measureErrors"] = this->_stats.measureErrors;
+    stats["bufferFull"] = this->_stats.bufferFull;
+    stats["sendErrors"] = this->_stats.sendErrors;
+    stats["highWater"] = this->_stats.highWater;
+    stats["bursts"] = this->_stats.bursts;
+    stats["evicted"] = this->_buffer.getEvicted();
+    stats["breakerOpens"] = this->_backoff.getOpens();
+    stats["radioOn"] = this->_stats.radioOn;
+    stats["truncated"] = this->_stats.truncated;
+    stats["oversized"] = this->_stats.oversized;
+    unsigned long suppressed = 0;
+    for (uint8_t channel = 0; channel < this->_taskCount; channel++) {
+      suppressed += this->_deadbands[channel].getSuppressed();
+    }
+    stats["suppressed"] = suppressed;
+    stats["bytesSent"] = this->getBytesSent();
+    stats["bytesReceived"] = this->getBytesReceived();
+
+    return this->_serializeDocument(doc);
+  }
+
+  // Add a histogram to the stats as [count, p50, p99, max].
+  void _fillHistogram(JsonObject &stats, const char *name,
+                      const Histogram &histogram) const {
+    JsonArray values = stats.createNestedArray(name);
+    values.add(histogram.count());
+    values.add(histogram.percentile(0.5));
+    values.add(histogram.percentile(0.99));
+    values.add(histogram.max());
+  }
+
+  // Serialize the document with the selected encoding in the body buffer.
+  bool _serializeDocument(const JsonDocument &doc) {
+    ENCODING encoding = this->_encoding == ENCODING::MSGPACK ? ENCODING::MSGPACK
+                                                             : ENCODING::JSON;
+    size_t length = this->_measure(doc);
+    if (!this->_reserveBody(length + 1)) {
+      return false;
+    }
+    if (encoding == ENCODING::MSGPACK) {
+      serializeMsgPack(doc, this->_body, this->_bodyCapacity);
+    } else {
+      serializeJson(doc, this->_body, this->_bodyCapacity);
+    }
+    this->_bodyLength = length;
+    this->_bodyEncoding = encoding;
+    return true;
+  }
+
+  // Serialize the next request in the body buffer.
+  // return the number of records it carries, or -1 on error.
+  int _prepareNext(int &method) {
+    if (this->_devInfoPending) {
+      method = 1;
+      return this->_serializeDeviceInfo() ? 0 : -1;
+    }
+    if (this->_isBatching()) {
+      method = 2;
+      // A probe after failures carries a single record.
+      return this->_serializeBatch(this->_backoff.isProbing() ? 1 : BS + AS);
+    }
+    method = 0;
+    return this->_serializeRecord(this->_buffer.first()) ? 1 : -1;
+  }
+
+  // Start a request if there is something to send
+  // and advance the one in progress, without blocking.
+  void _advanceUpload() {
+    if (this->_upload.isIdle()) {
+      if (!this->_devInfoPending && this->_buffer.isEmpty()) {
+        this->_endBurst();
+        this->_send_state = SEND_STATE::IDLE;
+        return;
+      }
+      if (!this->_flushing) {
+        if (!this->_isFlushDue()) {
+          this->_send_state = SEND_STATE::IDLE;
+          return;
+        }
+        if (this->_backoff.getWait() > 0) {
+          // The radio is not woken up before a retry is allowed.
+          this->_send_state = SEND_STATE::WAITING;
+          return;
+        }
+        this->_startBurst();
+      }
+      if (this->_radioSleep && WiFi.status() != WL_CONNECTED) {
+        // Waiting for the radio to reconnect, up to RADIO_WAKE_TIMEOUT
+        // since it woke up. Then the burst fails, and is retried later.
+        if (millis() - this->_radioOnSince < RADIO_WAKE_TIMEOUT) {
+          this->_send_state = SEND_STATE::PENDING;
+          return;
+        }
+        this->_backoff.failure();
+        this->_endBurst();
+        this->_send_state = SEND_STATE::ERROR;
+        return;
+      }
+      if (!this->_backoff.canSend()) {
+        this->_send_state = SEND_STATE::WAITING;
+        return;
+      }
+      this->_inFlight = this->_prepareNext(this->_inFlightMethod);
+      if (this->_inFlight < 0) {
+        this->_dropOversized(this->_inFlightMethod);
+      }
+      if (this->_inFlight < 0 || !this->_startUpload(this->_inFlightMethod)) {
+        // Retried later, like a failed request.
+        this->_inFlight = 0;
+        this->_backoff.failure();
+        this->_send_state = SEND_STATE::ERROR;
+        return;
+      }
+      // Alarms stored while in flight go before the records sent,
+      // so remember how many of each class are sent.
+      this->_inFlightAlarms = this->_buffer.size(PRIORITY::ALARM);
+      if (this->_inFlightAlarms > this->_inFlight) {
+        this->_inFlightAlarms = this->_inFlight;
       }
     }
 
-    int httpCode = http.POST(jsonString);
-    if (httpCode != 200) {
-      http.end();
+    this->_upload.step(this->_uploadBudget);
+    if (!this->_upload.isFinished()) {
+      this->_send_state = SEND_STATE::PENDING;
+      return;
+    }
+
+    if (this->_finishUpload(this->_inFlightMethod)) {
+      this->_buffer.shift(this->_inFlightAlarms,
+                          this->_inFlight - this->_inFlightAlarms);
+      this->_send_state = SEND_STATE::SUCCESS;
+    } else {
+      this->_send_state = SEND_STATE::ERROR;
+    }
+    this->_inFlight = 0;
+  }
+
+  // With SENSINO_STATIC the storage cannot grow, so a record that cannot
+  // be serialized on its own never will: drop it rather than block the
+  // buffer behind it.
+  void _dropOversized(int method) {
+#if defined(SENSINO_STATIC)
+    if (method != 1 && !this->_buffer.isEmpty()) {
+      this->_buffer.shift();
+      this->_stats.oversized++;
+    }
+#endif
+  }
+
+  // true if the buffer must be drained according to the flush policy.
+  bool _isFlushDue() const {
+    if (this->_devInfoPending ||
+        this->_buffer.size() >= this->_flushWatermark ||
+        !this->_buffer.isEmpty(PRIORITY::ALARM) ||
+        this->_buffer.isFull(PRIORITY::ROUTINE) ||
+        (this->_spool != nullptr && !this->_spool->isEmpty())) {
+      return true;
+    }
+    return this->_flushDeadline > 0 &&
+           millis() - this->_buffer.first().uptime >= this->_flushDeadline;
+  }
+
+  // Start draining the buffer, waking the radio up if needed.
+  void _startBurst() {
+    this->_flushing = true;
+    this->_stats.bursts++;
+    this->_wakeRadio();
+  }
+
+  // The buffer has been drained, let the radio sleep if enabled.
+  void _endBurst() {
+    this->_flushing = false;
+    if (!this->_radioSleep || this->_radioAsleep) {
+      return;
+    }
+    this->_upload.stop();
+    WiFi.forceSleepBegin();
+    this->_radioAsleep = true;
+    this->_stats.radioOn += millis() - this->_radioOnSince;
+  }
+
+  void _wakeRadio() {
+    if (!this->_radioAsleep) {
+      return;
+    }
+    WiFi.forceSleepWake();
+    this->_radioAsleep = false;
+    this->_radioOnSince = millis();
+  }
+
+  // Send the body buffer to the server and wait for the answer.
+  // return success state.
+  bool _send(const int method) {
+    if (!this->_backoff.canSend()) {
+      return false;
+    }
+    if (this->_radioAsleep) {
+      this->_wakeRadio();
+      unsigned long start = millis();
+      while (WiFi.status() != WL_CONNECTED &&
+             millis() - start < RADIO_WAKE_TIMEOUT) {
+        delay(RADIO_POLL_INTERVAL);
+      }
+    }
+    if (!this->_startUpload(method)) {
       return false;
     }
+    while (!this->_upload.isFinished()) {
+      this->_upload.step(this->_uploadBudget);
+      yield();
+    }
+    bool success = this->_finishUpload(method);
+    if (success && this->_devInfoPending) {
+      this->sendDeviceInfo();
+    }
+    return success;
+  }
 
-    String payload = http.getString();
-    http.end();
+  // Append a header to the request.
+  // return false if it does not fit.
+  bool _addHeader(const char *name, const char *value) {
+    size_t room = SENSINO_HEADERS_SIZE - this->_headersLength;
+    int length = snprintf(&this->_headers[this->_headersLength], room,
+                          "%s: %s\r\n", name, value);
+    if (length < 0 || (size_t)length >= room) {
+      return false;
+    }
+    this->_headersLength += length;
+    return true;
+  }
 
-    // Deserialize the Payload
-    {
-      DynamicJsonDocument docPayload(300);
-      deserializeJson(docPayload, payload);
+  // Build the headers and start sending the body buffer.
+  bool _startUpload(const int method) {
+    const char *contentType = "application/json";
+    if (this->_bodyEncoding == ENCODING::MSGPACK) {
+      contentType = "application/msgpack";
+    } else if (this->_bodyEncoding == ENCODING::DELTA) {
+      contentType = "application/x-sensino-delta";
+    }
+    char serialNumber[11];
+    char acqPeriod[11];
+    char methodName[12];
+    char hash[9];
+    snprintf(serialNumber, sizeof(serialNumber), "%u", this->_serialNumber);
+    snprintf(acqPeriod, sizeof(acqPeriod), "%lu",
+             this->_tasks[0].period);
+    snprintf(methodName, sizeof(methodName), "%d", method);
+
+    // The full userConfig only goes when needed, its hash always does.
+    this->_refreshConfig();
+    snprintf(hash, sizeof(hash), "%08lx", (unsigned long)this->_configHash);
+
+    this->_headersLength = 0;
+    bool fits = this->_addHeader("Content-Type", contentType) &&
+                this->_addHeader("SNO-API-KEY", this->_apiKey) &&
+                this->_addHeader("SNO-SERIAL-NUMBER", serialNumber) &&
+                this->_addHeader("SNO-ACQ-PERIOD", acqPeriod) &&
+                this->_addHeader("SNO-METHOD", methodName) &&
+                this->_addHeader("SNO-CONFIG-HASH", hash);
+
+    this->_configSending = this->_configPending;
+    if (this->_configSending) {
+      fits = fits && this->_headersLength + this->_configHeadersLength <
+                         SENSINO_HEADERS_SIZE;
+      if (fits) {
+        memcpy(&this->_headers[this->_headersLength], this->_configHeaders,
+               this->_configHeadersLength);
+        this->_headersLength += this->_configHeadersLength;
+      }
+    }
+    if (!fits) {
+      return false;
+    }
+
+    this->_uploadStart = millis();
+    return this->_upload.start(this->_headers, this->_headersLength,
+                               this->_body, this->_bodyLength);
+  }
+
+  // Handle the answer to the finished request and release the uploader.
+  // return success state.
+  bool _finishUpload(const int method) {
+    int status = this->_upload.getStatus();
+    bool success =
+        this->_upload.getState() == UPLOAD_STATE::DONE && status == 200;
+    this->_stats.upload.add(millis() - this->_uploadStart);
+    if (success) {
+      this->_backoff.success();
+    } else {
+      this->_backoff.failure(this->_upload.getRetryAfter() * 1000);
+    }
+
+    if (success) {
+      if (method == 1) {
+        this->_devInfoPending = false;
+      }
+      if (this->_configSending) {
+        this->_configPending = false;
+      }
+      // Deserialize the Payload, unless it was cut (see UPLOAD_PAYLOAD_SIZE).
+      Document<SENSINO_DOC_SIZE> docPayload;
+      if (this->_upload.isTruncated()) {
+        this->_stats.truncated++;
+      } else {
+        deserializeJson(docPayload, this->_upload.getPayload(),
+                        this->_upload.getPayloadLength());
+      }
       if (docPayload.containsKey("acqPeriod")) {
-        this->_acqTicker.reset(docPayload["acqPeriod"].as<unsigned long>());
+        this->setMeasurePeriod(0, docPayload["acqPeriod"].as<unsigned long>());
+      }
+      if (docPayload.containsKey("flushWatermark") ||
+          docPayload.containsKey("flushDeadline")) {
+        this->setFlushPolicy(
+            docPayload["flushWatermark"] | this->_flushWatermark,
+            docPayload["flushDeadline"] | this->_flushDeadline);
+      }
+      if (docPayload.containsKey("radioSleep")) {
+        this->setRadioSleep(docPayload["radioSleep"].as<bool>());
       }
       if (docPayload.containsKey("devInfoCheck")) {
-        this->sendDeviceInfo();
+        this->_devInfoPending = true;
+      }
+      if (docPayload.containsKey("configCheck")) {
+        this->_configPending = true;
       }
       if (docPayload.containsKey("userServerPayload")) {
+        JsonObject userPayload = docPayload["userServerPayload"];
+        if (userPayload.containsKey("deadband")) {
+          this->_updateDeadband(userPayload["deadband"]);
+        }
+      }
+      if (docPayload.containsKey("userServerPayload") &&
+          this->_onUserServerPayload != nullptr) {
         this->_onUserServerPayload(docPayload["userServerPayload"]);
       }
+    } else if (status == 415) {
+      // The server does not understand the encoding,
+      // fall back to JSON for the next requests.
+      this->_encoding = ENCODING::JSON;
+    }
+
+    this->_upload.reset();
+    return success;
+  }
+
+  // Render the SNO-USER-* headers again if userConfig changed.
+  // They are sent again if their hash changed.
+  void _refreshConfig() {
+    bool changed = this->_isConfigChanged(std::is_trivially_copyable<UC>());
+    if (this->_configRendered && !changed) {
+      return;
+    }
+    bool rendered = this->_configRendered;
+    uint32_t previous = this->_configHash;
+    this->_configRendered = true;
+
+    // Items that do not fit in SENSINO_CONFIG_HEADERS_SIZE are skipped.
+    this->_configHeadersLength = 0;
+    {
+      Document<SENSINO_DOC_SIZE> docConfig;
+      this->userConfig.fill(docConfig);
+
+      JsonObject root = docConfig.as<JsonObject>();
+      for (JsonPair item : root) {
+        char value[64];
+        if (item.value().is<const char *>()) {
+          snprintf(value, sizeof(value), "%s",
+                   item.value().as<const char *>());
+        } else {
+          serializeJson(item.value(), value, sizeof(value));
+        }
+        size_t room = SENSINO_CONFIG_HEADERS_SIZE - this->_configHeadersLength;
+        int length = snprintf(&this->_configHeaders[this->_configHeadersLength],
+                              room, "SNO-USER-%s: %s\r\n",
+                              item.key().c_str(), value);
+        if (length > 0 && (size_t)length < room) {
+          this->_configHeadersLength += length;
+        }
+      }
+    }
+
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+    for (size_t n = 0; n < this->_configHeadersLength; n++) {
+      hash ^= (uint8_t)this->_configHeaders[n];
+      hash *= 16777619UL;
     }
+    this->_configHash = hash;
+    if (!rendered || hash != previous) {
+      this->_configPending = true;
+    }
+  }
+
+  // true if userConfig changed since its headers were rendered,
+  // comparing its bytes.
+  bool _isConfigChanged(std::true_type) {
+    if (memcmp((const void *)&this->_configCopy,
+               (const void *)&this->userConfig, sizeof(UC)) == 0) {
+      return false;
+    }
+    memcpy((void *)&this->_configCopy, (const void *)&this->userConfig,
+           sizeof(UC));
+    return true;
+  }
+
+  // It cannot be compared (e.g. String members): render the headers again
+  // and compare their hash.
+  bool _isConfigChanged(std::false_type) { return true; }
+
+  // Apply the deadband settings sent by the server:
+  // {"enabled": true, "heartbeat": 900000, "fields": {"name": [abs, rel]}}
+  void _updateDeadband(JsonObject settings) {
+    if (settings.containsKey("enabled")) {
+      this->setSendOnDelta(settings["enabled"].as<bool>());
+    }
+    if (settings.containsKey("heartbeat")) {
+      this->setHeartbeat(settings["heartbeat"].as<unsigned long>());
+    }
+    JsonObject fields = settings["fields"];
+    for (JsonPair item : fields) {
+      JsonArray threshold = item.value().as<JsonArray>();
+      this->setDeltaThreshold(item.key().c_str(), threshold[0].as<float>(),
+                              threshold[1].as<float>());
+    }
+  }
+
+  // Move records from the spool to the buffer, once its routine records
+  // have been drained.
+  void _unspool() {
+    if (this->_spool == nullptr || !this->_buffer.isEmpty(PRIORITY::ROUTINE)) {
+      return;
+    }
+    Record<SR> record;
+    while (!this->_buffer.isFull(PRIORITY::ROUTINE) &&
+           this->_spool->shift(record)) {
+      this->_buffer.push(record, PRIORITY::ROUTINE);
+    }
+  }
+
+  // Size in bytes of the serialized document with the selected encoding.
+  size_t _measure(const JsonDocument &doc) const {
+    if (this->_encoding == ENCODING::MSGPACK) {
+      return measureMsgPack(doc);
+    }
+    return measureJson(doc);
+  }
+
+  // true if records are sent in batches.
+  bool _isBatching() const {
+    return this->_batchBytes > 0 || this->_encoding == ENCODING::DELTA;
+  }
+
+  // Make room in the body buffer, which is reused between requests.
+  bool _reserveBody(size_t size) {
+    if (size <= this->_bodyCapacity) {
+      return true;
+    }
+#if defined(SENSINO_STATIC)
+    return false;
+#else
+    Allocations::add(size);
+    char *body = (char *)realloc(this->_body, size);
+    if (body == nullptr) {
+      return false;
+    }
+    this->_body = body;
+    this->_bodyCapacity = size;
     return true;
+#endif
+  }
+
+  // Fill the per-record fields of the JSON document.
+  void _fillRecord(JsonObject doc, Record<SR> record) const {
+    // Time since the device was booted
+    doc["uptime"] = record.uptime;
+    // Current time in UTC.
+    doc["timestamp"] = record.timestamp;
+    doc["timestampMs"] = record.timestampMs;
+    // Measurement task, only when there are several.
+    if (this->_taskCount > 1) {
+      doc["channel"] = record.channel;
+    }
+
+    auto docur = doc.createNestedObject("userRecord");
+    record.userRecord.fill(docur);
   }
 
   //
-  std::pair<Record<UR>, bool> measure() const {
+  std::pair<Record<UR>, bool> measure(uint8_t channel = 0) const {
     Record<UR> rec;
+    rec.channel = channel;
     if (this->_beforeMeasure != nullptr) {
       this->_beforeMeasure();
     }
     rec.uptime = millis();
-    rec.timestamp = timeClient.getEpochTime();
-    auto meas = _onMeasure();
+    unsigned long long epochMs = timeClient.millisToEpochMs(rec.uptime);
+    rec.timestamp = epochMs / 1000;
+    rec.timestampMs = epochMs % 1000;
+    auto meas = this->_tasks[channel].measure();
     if (!meas.second) {
       return std::make_pair(rec, false);
     }
@@ -341,7 +1323,150 @@ public:
     return std::make_pair(rec, true);
   }
 
-  bool isBufferFull() const { return this->_buffer.isFull(); }
+  // true if there is no room for routine records.
+  bool isBufferFull() const {
+    return this->_buffer.isFull(PRIORITY::ROUTINE);
+  }
+
+  // Length (in ms) of the aggregation window, when SR is a Summary.
+  // It applies to all the measurement tasks, each one aggregated apart.
+  void setAggregationWindow(unsigned long window) {
+    for (uint8_t channel = 0; channel < MEASURE_MAX_TASKS; channel++) {
+      this->_aggregators[channel].setWindow(window);
+    }
+  }
+
+  // Send-on-delta: only keep records that moved beyond the thresholds
+  // (see Deadband), or after a heartbeat interval. The server can change
+  // it with "deadband" in userServerPayload (see _updateDeadband).
+  // It applies to all the measurement tasks, each one filtered apart.
+  void setSendOnDelta(bool value) {
+    for (uint8_t channel = 0; channel < MEASURE_MAX_TASKS; channel++) {
+      this->_deadbands[channel].setEnabled(value);
+    }
+  }
+
+  bool getSendOnDelta() const { return this->_deadbands[0].isEnabled(); }
+
+  // Threshold of a field of the stored record, by name.
+  bool setDeltaThreshold(const char *name, float absolute, float relative) {
+    bool success = true;
+    for (uint8_t channel = 0; channel < MEASURE_MAX_TASKS; channel++) {
+      success = this->_deadbands[channel].setThreshold(name, absolute,
+                                                       relative) &&
+                success;
+    }
+    return success;
+  }
+
+  // Maximum time (in ms) without keeping a record.
+  void setHeartbeat(unsigned long value) {
+    for (uint8_t channel = 0; channel < MEASURE_MAX_TASKS; channel++) {
+      this->_deadbands[channel].setHeartbeat(value);
+    }
+  }
+
+  // Store records in flash when the buffer is full.
+  // The spool must have been started (see Spool::begin).
+  void setSpool(Spool<Record<SR>> *spool) { this->_spool = spool; }
+
+  // Encoding used for the body of the requests.
+  // If the server answers 415 (Unsupported Media Type), JSON is used.
+  // DELTA requires a userRecord with a codec method (see DeltaEncoder),
+  // otherwise JSON is used.
+  void setEncoding(ENCODING value) {
+    if (value == ENCODING::DELTA && !HasCodec<SR>::value) {
+      value = ENCODING::JSON;
+    }
+    this->_encoding = value;
+  }
+
+  ENCODING getEncoding() const { return this->_encoding; }
+
+  // Maximum size (in bytes) of a batch request body. 0 disables batching.
+  // With SENSINO_STATIC, it is limited by SENSINO_BATCH_BYTES.
+  void setBatchBytes(size_t value) {
+#if defined(SENSINO_STATIC)
+    if (value >= this->_bodyCapacity) {
+      value = this->_bodyCapacity - 1;
+    }
+#endif
+    this->_batchBytes = value;
+  }
+
+  size_t getBatchBytes() const { return this->_batchBytes; }
+
+  // Number of requests that reused an already open connection.
+  unsigned long getConnectionReuses() const {
+    return this->_upload.getReuses();
+  }
+
+  // Number of requests that required opening a new connection.
+  unsigned long getConnectionReconnects() const {
+    return this->_upload.getReconnects();
+  }
+
+  // Records are sent once the buffer holds watermark of them (capped to
+  // the buffer size) or the oldest waited deadline ms (0 to disable).
+  // The default (1, 0) sends each record as soon as possible.
+  void setFlushPolicy(size_t watermark, unsigned long deadline) {
+    if (watermark < 1) {
+      watermark = 1;
+    } else if (watermark > BS) {
+      watermark = BS;
+    }
+    this->_flushWatermark = watermark;
+    this->_flushDeadline = deadline;
+  }
+
+  size_t getFlushWatermark() const { return this->_flushWatermark; }
+
+  unsigned long getFlushDeadline() const { return this->_flushDeadline; }
+
+  // Turn the WiFi modem off between bursts (see setFlushPolicy).
+  void setRadioSleep(bool value) {
+    this->_radioSleep = value;
+    if (!value) {
+      this->_wakeRadio();
+    }
+  }
+
+  bool getRadioSleep() const { return this->_radioSleep; }
+
+  // Runtime statistics, also sent with the device info.
+  const ClientStats &getStats() const { return this->_stats; }
+
+  void resetStats() { this->_stats = ClientStats(); }
+
+  // Bytes of the requests sent to the server.
+  unsigned long getBytesSent() const { return this->_upload.getBytesSent(); }
+
+  // Bytes of the answers received from the server.
+  unsigned long getBytesReceived() const {
+    return this->_upload.getBytesReceived();
+  }
+
+  // Delay (in ms) after the first failed request, doubled on each
+  // consecutive failure up to max (see Backoff).
+  void setRetryDelays(unsigned long base, unsigned long max) {
+    this->_backoff.setDelays(base, max);
+  }
+
+  // Consecutive failures after which only a probe request is sent
+  // until the server answers again.
+  void setBreakerThreshold(unsigned int value) {
+    this->_backoff.setThreshold(value);
+  }
+
+  BREAKER_STATE getBreakerState() const { return this->_backoff.getState(); }
+
+  // Time budget (in us) used in each loop to advance the upload.
+  void setUploadBudget(unsigned long value) { this->_uploadBudget = value; }
+
+  // Timeout (in ms) for a whole request to the server.
+  void setUploadTimeout(unsigned long value) {
+    this->_upload.setTimeout(value);
+  }
 
   Record<UR> getLastRecord() const { return this->_lastRecord; }
 
@@ -0,0 +1,154 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Model of the local clock used by the time clients.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef CLOCK_SAMPLES
+#define CLOCK_SAMPLES 8
+#endif
+
+#ifndef CLOCK_MAX_DRIFT
+#define CLOCK_MAX_DRIFT 0.0005 // 500 ppm
+#endif
+
+namespace sensino {
+
+/**
+ * Maps millis() to epoch (ms), correcting the drift of the local clock.
+ *
+ * The frequency error of millis() is estimated by a linear fit over the
+ * last CLOCK_SAMPLES syncs, and the mapping is anchored at the last one.
+ *
+ * The sync interval adapts to the observed error: before adding a sync,
+ * the model predicts its time. If the error is below half the bound, the
+ * interval doubles (up to the maximum), if it is above the bound it is
+ * halved (down to the minimum).
+ */
+class ClockModel {
+
+private:
+  // Last syncs, in a ring.
+  unsigned long _millis[CLOCK_SAMPLES];
+  unsigned long long _epochMs[CLOCK_SAMPLES];
+  byte _count = 0;
+  byte _next = 0;
+
+  // Last sync.
+  unsigned long _millisRef = 0;
+  unsigned long long _epochRef = 0;
+
+  // Fractional frequency error of millis().
+  double _drift = 0;
+
+  // Error (in ms) of the prediction for the last sync.
+  long _error = 0;
+
+  unsigned long _interval;
+  unsigned long _minInterval;
+  unsigned long _maxInterval;
+  unsigned long _bound = 100; // In ms
+
+  void _fit() {
+    if (this->_count < 2) {
+      this->_drift = 0;
+      return;
+    }
+    // Least squares slope, relative to the oldest sample for precision.
+    byte first = (this->_next + CLOCK_SAMPLES - this->_count) % CLOCK_SAMPLES;
+    double meanX = 0;
+    double meanY = 0;
+    for (byte n = 0; n < this->_count; n++) {
+      byte i = (first + n) % CLOCK_SAMPLES;
+      meanX += (double)(this->_millis[i] - this->_millis[first]);
+      meanY += (double)(this->_epochMs[i] - this->_epochMs[first]);
+    }
+    meanX /= this->_count;
+    meanY /= this->_count;
+
+    double sxy = 0;
+    double sxx = 0;
+    for (byte n = 0; n < this->_count; n++) {
+      byte i = (first + n) % CLOCK_SAMPLES;
+      double dx = (double)(this->_millis[i] - this->_millis[first]) - meanX;
+      double dy = (double)(this->_epochMs[i] - this->_epochMs[first]) - meanY;
+      sxy += dx * dy;
+      sxx += dx * dx;
+    }
+    if (sxx <= 0) {
+      return;
+    }
+    this->_drift = sxy / sxx - 1;
+    if (this->_drift > CLOCK_MAX_DRIFT) {
+      this->_drift = CLOCK_MAX_DRIFT;
+    } else if (this->_drift < -CLOCK_MAX_DRIFT) {
+      this->_drift = -CLOCK_MAX_DRIFT;
+    }
+  }
+
+public:
+  ClockModel(unsigned long interval)
+      : _interval(interval), _minInterval(interval),
+        _maxInterval(interval * 16) {}
+
+  // Add a sync: epochMs was the time when millis() was at.
+  void addSample(unsigned long at, unsigned long long epochMs) {
+    if (this->_count > 0) {
+      this->_error = (long)(epochMs - this->toEpochMs(at));
+      unsigned long error = labs(this->_error);
+      if (error > this->_bound) {
+        this->_interval /= 2;
+      } else if (error < this->_bound / 2) {
+        this->_interval *= 2;
+      }
+      if (this->_interval < this->_minInterval) {
+        this->_interval = this->_minInterval;
+      } else if (this->_interval > this->_maxInterval) {
+        this->_interval = this->_maxInterval;
+      }
+    }
+
+    this->_millis[this->_next] = at;
+    this->_epochMs[this->_next] = epochMs;
+    this->_next = (this->_next + 1) % CLOCK_SAMPLES;
+    if (this->_count < CLOCK_SAMPLES) {
+      this->_count++;
+    }
+    this->_millisRef = at;
+    this->_epochRef = epochMs;
+    this->_fit();
+  }
+
+  // Epoch (in ms) when millis() was (or will be) value.
+  unsigned long long toEpochMs(unsigned long value) const {
+    long elapsed = (long)(value - this->_millisRef);
+    return this->_epochRef + elapsed + (long long)(elapsed * this->_drift);
+  }
+
+  // Time (in ms) until the next sync is needed.
+  unsigned long getInterval() const { return this->_interval; }
+
+  // Minimum and maximum sync interval (in ms).
+  void setIntervals(unsigned long minInterval, unsigned long maxInterval) {
+    this->_minInterval = minInterval;
+    this->_maxInterval = maxInterval < minInterval ? minInterval : maxInterval;
+    this->_interval = minInterval;
+  }
+
+  // Maximum error (in ms) tolerated between syncs.
+  void setBound(unsigned long value) { this->_bound = value; }
+
+  // Estimated frequency error of millis() (e.g. 1e-5 is 10 ppm fast).
+  double getDrift() const { return -this->_drift; }
+
+  // Error (in ms) of the prediction for the last sync.
+  long getError() const { return this->_error; }
+
+  bool isSynced() const { return this->_count > 0; }
+};
+
+} // namespace sensino
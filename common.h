@@ -12,11 +12,27 @@ enum class MEASURE_STATE {
   ERROR,       // Error while measuring.
   STORE,       // Measurement was successful and stored in the buffer.
   BUFFER_FULL, // Measurement was successful but the buffer was full.
+  SPOOL,       // Measurement was successful and stored in the flash spool.
+  AGGREGATE,   // Measurement was successful and added to the aggregation.
+  SUPPRESSED,  // Measurement was successful but did not change enough.
 };
 enum class SEND_STATE {
   IDLE,    // No sent was done.
   SUCCESS, // Record was sent.
-  ERROR    // Error while sending.
+  ERROR,   // Error while sending.
+  PENDING, // A request is in progress.
+  WAITING  // Waiting before retrying after errors.
+};
+
+enum class PRIORITY {
+  ROUTINE, // Sent after the alarms, first to be spooled or dropped.
+  ALARM,   // Sent before any routine record.
+};
+
+enum class ENCODING {
+  JSON,    // application/json
+  MSGPACK, // application/msgpack
+  DELTA,   // application/x-sensino-delta, batches only (see delta.hpp).
 };
 
 template <typename UC> struct Config {
@@ -26,7 +42,9 @@ template <typename UC> struct Config {
 
 template <typename UR> struct Record {
   unsigned long uptime;
-  unsigned long timestamp;
+  unsigned long timestamp;    // In s
+  unsigned short timestampMs; // Milliseconds within the timestamp second.
+  unsigned char channel;      // Measurement task (see addMeasureTask).
   UR userRecord;
 };
 
@@ -0,0 +1,190 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Send-on-delta filtering of records.
+ *
+ */
+#pragma once
+
+#include <math.h>
+#include <string.h>
+
+#include <type_traits>
+
+#include "aggregate.hpp"
+#include "common.h"
+#include "delta.hpp"
+
+// Number of fields with a threshold (see setThreshold). The values of up
+// to DELTA_MAX_FIELDS fields of a record are compared.
+#ifndef DEADBAND_MAX_FIELDS
+#define DEADBAND_MAX_FIELDS 8
+#endif
+#define DEADBAND_NAME_SIZE 16
+
+namespace sensino {
+
+/**
+ * Lets a record through only if it differs enough from the last one
+ * let through, or if nothing went through for a while (heartbeat).
+ *
+ * A record differs enough when any field moved more than its threshold:
+ *   |value - last| > max(absolute, relative * |last|)
+ * Fields without a threshold pass on any change. Records with more than
+ * DELTA_MAX_FIELDS fields always pass.
+ *
+ * Fields are found by name with the codec method of the userRecord (see
+ * DeltaState). Without codec, every record goes through. The count of a
+ * Summary is not compared: it follows the timing of the measures.
+ *
+ * It is disabled by default.
+ *
+ * It is generic over:
+ * - R userRecord: record being filtered.
+ */
+template <typename R> class Deadband {
+
+private:
+  struct Threshold {
+    char name[DEADBAND_NAME_SIZE];
+    float absolute;
+    float relative;
+  };
+
+  // Compares the fields of a record with the last one let through.
+  class Comparator {
+  public:
+    Deadband *deadband;
+    size_t index = 0;
+    bool changed = false;
+
+    Comparator(Deadband *deadband) : deadband(deadband) {}
+
+    template <typename T> void field(const char *name, T &value) {
+      if (this->index >= DELTA_MAX_FIELDS) {
+        // Too many fields to compare, keep the record.
+        this->changed = true;
+      } else {
+        double v = (double)value;
+        double last = this->deadband->_last[this->index];
+        const Threshold *threshold = this->deadband->_find(name);
+        double band = 0;
+        if (threshold != nullptr) {
+          band = threshold->absolute;
+          if (threshold->relative * fabs(last) > band) {
+            band = threshold->relative * fabs(last);
+          }
+        }
+        if (fabs(v - last) > band) {
+          this->changed = true;
+        }
+        this->deadband->_current[this->index] = v;
+      }
+      this->index++;
+    }
+
+    template <typename T, typename S>
+    void field(const char *name, T &value, S scale) {
+      this->field(name, value);
+    }
+  };
+
+  bool _enabled = false;
+
+  Threshold _thresholds[DEADBAND_MAX_FIELDS];
+  size_t _thresholdCount = 0;
+
+  // Maximum time (in ms) without letting a record through.
+  unsigned long _heartbeat = 900000;
+
+  // Fields and time (uptime) of the last record let through,
+  // and fields of the record being checked.
+  bool _hasLast = false;
+  double _last[DELTA_MAX_FIELDS];
+  double _current[DELTA_MAX_FIELDS];
+  unsigned long _lastAt = 0;
+
+  // Records filtered out.
+  unsigned long _suppressed = 0;
+
+  const Threshold *_find(const char *name) const {
+    for (size_t n = 0; n < this->_thresholdCount; n++) {
+      if (strcmp(this->_thresholds[n].name, name) == 0) {
+        return &this->_thresholds[n];
+      }
+    }
+    return nullptr;
+  }
+
+  bool _changed(R &record, std::true_type) {
+    Comparator comparator(this);
+    record.codec(comparator);
+    return comparator.changed;
+  }
+
+  bool _changed(R &record, std::false_type) { return true; }
+
+public:
+  Deadband() {
+    if (IsSummary<R>::value) {
+      this->setThreshold("count", INFINITY, 0);
+    }
+  }
+
+  // Check a record, to be called with every record in order.
+  // return true if the record must be kept.
+  bool pass(Record<R> record) {
+    if (!this->_enabled) {
+      return true;
+    }
+    bool changed = this->_changed(
+        record.userRecord, std::integral_constant<bool, HasCodec<R>::value>());
+    bool silent = record.uptime - this->_lastAt >= this->_heartbeat;
+    if (!this->_hasLast || changed || silent) {
+      this->_hasLast = true;
+      this->_lastAt = record.uptime;
+      memcpy(this->_last, this->_current, sizeof(this->_last));
+      return true;
+    }
+    this->_suppressed++;
+    return false;
+  }
+
+  // Enabling it again (e.g. with each answer of the server) keeps the
+  // last record let through.
+  void setEnabled(bool value) {
+    if (value != this->_enabled) {
+      this->_hasLast = false;
+    }
+    this->_enabled = value;
+  }
+
+  bool isEnabled() const { return this->_enabled; }
+
+  // Threshold of a field (or all fields with that name).
+  // return false if there is no room for more thresholds.
+  bool setThreshold(const char *name, float absolute, float relative) {
+    Threshold *threshold = const_cast<Threshold *>(this->_find(name));
+    if (threshold == nullptr) {
+      if (this->_thresholdCount >= DEADBAND_MAX_FIELDS) {
+        return false;
+      }
+      threshold = &this->_thresholds[this->_thresholdCount++];
+      strncpy(threshold->name, name, DEADBAND_NAME_SIZE - 1);
+      threshold->name[DEADBAND_NAME_SIZE - 1] = '\0';
+    }
+    threshold->absolute = absolute;
+    threshold->relative = relative;
+    return true;
+  }
+
+  // Maximum time (in ms) without letting a record through.
+  void setHeartbeat(unsigned long value) { this->_heartbeat = value; }
+
+  unsigned long getHeartbeat() const { return this->_heartbeat; }
+
+  // Number of records filtered out.
+  unsigned long getSuppressed() const { return this->_suppressed; }
+};
+
+} // namespace sensino
@@ -0,0 +1,346 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Compact encoding of record batches using deltas and varints.
+ *
+ * It does not depend on Arduino so that it can be used
+ * to decode the batches on the server side.
+ *
+ */
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+#define DELTA_VERSION 3
+// Enough for a Summary (see aggregate.hpp).
+#ifndef DELTA_MAX_FIELDS
+#define DELTA_MAX_FIELDS 32
+#endif
+
+namespace sensino {
+
+/**
+ * State shared by the encoder and the decoder.
+ *
+ * Wire format (all integers are LEB128 varints, signed ones zig-zag encoded):
+ * - version (1 byte)
+ * - bootID (signed)
+ * - ntpEpoch
+ * - for each record, until the end of the buffer:
+ *   - uptime: signed delta of the delta with the previous record.
+ *   - timestamp (in ms): signed delta of the delta with the previous record.
+ *   - channel.
+ *   - for each field of the userRecord, in the order given by its codec:
+ *     - integers: signed delta with the previous record.
+ *     - quantized floats: round(value * scale), as a signed delta with the
+ *       previous record.
+ *     - other floats: IEEE 754, 4 bytes (8 for doubles), little endian.
+ *
+ * The first record is encoded against zeros, i.e. in full.
+ *
+ * The userRecord must describe its fields with a codec method,
+ * which is used both to encode and decode:
+ *
+ *   template <typename C> void codec(C &c) {
+ *     c.field("temperature", this->temperature, 100); // centi-degrees
+ *     c.field("humidity", this->humidity);
+ *   }
+ */
+class DeltaState {
+
+protected:
+  int64_t _uptime;
+  int64_t _uptimeDelta;
+  int64_t _timestamp;
+  int64_t _timestampDelta;
+  int64_t _fields[DELTA_MAX_FIELDS];
+
+  // Index of the next field in the current record.
+  size_t _field;
+
+  void _reset() {
+    this->_uptime = 0;
+    this->_uptimeDelta = 0;
+    this->_timestamp = 0;
+    this->_timestampDelta = 0;
+    memset(this->_fields, 0, sizeof(this->_fields));
+    this->_field = 0;
+  }
+
+  static uint64_t _zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  }
+
+  static int64_t _unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+  }
+};
+
+/**
+ * Encode records in a buffer.
+ *
+ * Call begin, then add records until it returns false.
+ */
+class DeltaEncoder : public DeltaState {
+
+private:
+  uint8_t *_buffer;
+  size_t _capacity;
+  size_t _length = 0;
+  bool _overflow = false;
+
+  void _byte(uint8_t value) {
+    if (this->_length >= this->_capacity) {
+      this->_overflow = true;
+      return;
+    }
+    this->_buffer[this->_length++] = value;
+  }
+
+  void _varint(uint64_t value) {
+    while (value >= 0x80) {
+      this->_byte((uint8_t)(value | 0x80));
+      value >>= 7;
+    }
+    this->_byte((uint8_t)value);
+  }
+
+  void _signed(int64_t value) { this->_varint(_zigzag(value)); }
+
+  void _raw(const void *value, size_t size) {
+    // Little endian, as the ESP8266 and most hosts.
+    const uint8_t *bytes = (const uint8_t *)value;
+    for (size_t n = 0; n < size; n++) {
+      this->_byte(bytes[n]);
+    }
+  }
+
+  // Encode a value as a delta with the same field in the previous record.
+  void _delta(int64_t value) {
+    if (this->_field >= DELTA_MAX_FIELDS) {
+      this->_overflow = true;
+      return;
+    }
+    this->_signed(value - this->_fields[this->_field]);
+    this->_fields[this->_field++] = value;
+  }
+
+public:
+  DeltaEncoder(uint8_t *buffer, size_t capacity)
+      : _buffer(buffer), _capacity(capacity) {
+    this->_reset();
+  }
+
+  // Start a new batch.
+  bool begin(long bootID, unsigned long ntpEpoch) {
+    this->_reset();
+    this->_length = 0;
+    this->_overflow = false;
+    this->_byte(DELTA_VERSION);
+    this->_signed(bootID);
+    this->_varint(ntpEpoch);
+    return !this->_overflow;
+  }
+
+  // Append a record to the batch.
+  // return false (leaving the batch untouched) if it does not fit.
+  template <typename UR> bool add(Record<UR> record) {
+    DeltaState saved = *this;
+    size_t length = this->_length;
+
+    int64_t uptimeDelta = (int64_t)record.uptime - this->_uptime;
+    this->_signed(uptimeDelta - this->_uptimeDelta);
+    this->_uptime = record.uptime;
+    this->_uptimeDelta = uptimeDelta;
+
+    int64_t timestamp = (int64_t)record.timestamp * 1000 + record.timestampMs;
+    int64_t timestampDelta = timestamp - this->_timestamp;
+    this->_signed(timestampDelta - this->_timestampDelta);
+    this->_timestamp = timestamp;
+    this->_timestampDelta = timestampDelta;
+
+    this->_varint(record.channel);
+
+    this->_field = 0;
+    record.userRecord.codec(*this);
+
+    if (this->_overflow) {
+      *static_cast<DeltaState *>(this) = saved;
+      this->_length = length;
+      this->_overflow = false;
+      return false;
+    }
+    return true;
+  }
+
+  // Number of bytes used.
+  size_t length() const { return this->_length; }
+
+  // Integer field.
+  template <typename T> void field(const char *name, T &value) {
+    this->_delta((int64_t)value);
+  }
+
+  // Float field, sent as is.
+  void field(const char *name, float &value) {
+    this->_field++;
+    this->_raw(&value, sizeof(value));
+  }
+
+  void field(const char *name, double &value) {
+    this->_field++;
+    this->_raw(&value, sizeof(value));
+  }
+
+  // Float field, quantized as round(value * scale).
+  void field(const char *name, float &value, float scale) {
+    this->_delta(lroundf(value * scale));
+  }
+
+  void field(const char *name, double &value, double scale) {
+    this->_delta(llround(value * scale));
+  }
+};
+
+/**
+ * Decode records from a buffer.
+ *
+ * Call begin, then next until it returns false.
+ */
+class DeltaDecoder : public DeltaState {
+
+private:
+  const uint8_t *_buffer;
+  size_t _length;
+  size_t _position = 0;
+  bool _error = false;
+
+  uint8_t _byte() {
+    if (this->_position >= this->_length) {
+      this->_error = true;
+      return 0;
+    }
+    return this->_buffer[this->_position++];
+  }
+
+  uint64_t _varint() {
+    uint64_t value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+      uint8_t b = this->_byte();
+      value |= (uint64_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) {
+        return value;
+      }
+    }
+    this->_error = true;
+    return value;
+  }
+
+  int64_t _signed() { return _unzigzag(this->_varint()); }
+
+  void _raw(void *value, size_t size) {
+    uint8_t *bytes = (uint8_t *)value;
+    for (size_t n = 0; n < size; n++) {
+      bytes[n] = this->_byte();
+    }
+  }
+
+  int64_t _delta() {
+    if (this->_field >= DELTA_MAX_FIELDS) {
+      this->_error = true;
+      return 0;
+    }
+    this->_fields[this->_field] += this->_signed();
+    return this->_fields[this->_field++];
+  }
+
+public:
+  DeltaDecoder(const uint8_t *buffer, size_t length)
+      : _buffer(buffer), _length(length) {
+    this->_reset();
+  }
+
+  // Read the batch header.
+  // return false if the batch is not valid.
+  bool begin(long &bootID, unsigned long &ntpEpoch) {
+    this->_reset();
+    this->_position = 0;
+    this->_error = false;
+    if (this->_byte() != DELTA_VERSION) {
+      return false;
+    }
+    bootID = (long)this->_signed();
+    ntpEpoch = (unsigned long)this->_varint();
+    return !this->_error;
+  }
+
+  // Read the next record.
+  // return false at the end of the batch or on error.
+  template <typename UR> bool next(Record<UR> &record) {
+    if (this->_error || this->_position >= this->_length) {
+      return false;
+    }
+
+    this->_uptimeDelta += this->_signed();
+    this->_uptime += this->_uptimeDelta;
+    record.uptime = (unsigned long)this->_uptime;
+
+    this->_timestampDelta += this->_signed();
+    this->_timestamp += this->_timestampDelta;
+    record.timestamp = (unsigned long)(this->_timestamp / 1000);
+    record.timestampMs = (unsigned short)(this->_timestamp % 1000);
+
+    record.channel = (unsigned char)this->_varint();
+
+    this->_field = 0;
+    record.userRecord.codec(*this);
+
+    return !this->_error;
+  }
+
+  bool hasError() const { return this->_error; }
+
+  // Integer field.
+  template <typename T> void field(const char *name, T &value) {
+    value = (T)this->_delta();
+  }
+
+  // Float field, sent as is.
+  void field(const char *name, float &value) {
+    this->_field++;
+    this->_raw(&value, sizeof(value));
+  }
+
+  void field(const char *name, double &value) {
+    this->_field++;
+    this->_raw(&value, sizeof(value));
+  }
+
+  // Float field, quantized as round(value * scale).
+  void field(const char *name, float &value, float scale) {
+    value = (float)this->_delta() / scale;
+  }
+
+  void field(const char *name, double &value, double scale) {
+    value = (double)this->_delta() / scale;
+  }
+};
+
+/**
+ * true if the userRecord provides a codec method.
+ */
+template <typename UR> class HasCodec {
+  template <typename U>
+  static char _test(decltype(&U::template codec<DeltaEncoder>));
+  template <typename U> static long _test(...);
+
+public:
+  static const bool value = sizeof(_test<UR>(nullptr)) == 1;
+};
+
+} // namespace sensino
@@ -0,0 +1,209 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Latency of the loop phases, bytes on the wire and heap allocations of a
+ * Client run against a simulated server, the loop latency while the server
+ * does not answer (opening a connection blocks up to the connect timeout),
+ * the latency of the blocking calls (sendRecord, NTPClient::forceUpdate,
+ * Screen::rows3), and the bytes pushed to the display per screen update.
+ *
+ *   bench_client [records] [latency ms] [jitter ms] [loss] [batch bytes]
+ *                [json|msgpack|delta]
+ *
+ * Durations include the real CPU time on the host (see sim::setRealtime)
+ * plus the simulated network time. Rebuild with -DBENCH_BS=n to change the
+ * buffer size.
+ *
+ */
+#include "NTPClient.h"
+#include "client.hpp"
+#include "screen.hpp"
+
+#include "sim.hpp"
+
+#ifndef BENCH_BS
+#define BENCH_BS 10
+#endif
+
+struct UserRecord {
+  float temperature = 0;
+  float pressure = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["p"] = this->pressure;
+    doc["h"] = this->humidity;
+  }
+
+  template <typename C> void codec(C &codec) {
+    codec.field("t", this->temperature, 100);
+    codec.field("p", this->pressure, 10);
+    codec.field("h", this->humidity);
+  }
+};
+
+struct UserConfig {
+  int mode = 1;
+
+  void fill(JsonDocument &doc) const { doc["mode"] = this->mode; }
+};
+
+static void report(const char *name, const sensino::Histogram &histogram,
+                   const char *unit = "us") {
+  printf("%-18s n=%-6u p50=%-8u p99=%-8u max=%-8u (%s)\n", name,
+         histogram.count(), histogram.percentile(0.5),
+         histogram.percentile(0.99), histogram.max(), unit);
+}
+
+int main(int argc, char **argv) {
+  unsigned long records = argc > 1 ? atol(argv[1]) : 1000;
+  sim::HttpServer server("sensino.test");
+  server.log = false;
+  server.link.latency = argc > 2 ? atol(argv[2]) : 20;
+  server.link.jitter = argc > 3 ? atol(argv[3]) : 5;
+  server.link.loss = argc > 4 ? atof(argv[4]) : 0;
+  size_t batchBytes = argc > 5 ? atol(argv[5]) : 0;
+  const char *encoding = argc > 6 ? argv[6] : "json";
+
+  sim::HttpServer timeServer("time.test");
+  timeServer.log = false;
+  timeServer.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    unsigned long long epochMs = sim::epochMs(request.at);
+    response.body = std::to_string(epochMs / 1000) + "." +
+                    std::to_string(epochMs % 1000 + 1000).substr(1);
+    return response;
+  });
+  sim::NtpServer ntpServer("pool.ntp.org");
+
+  sensino::timeClient.begin("http://time.test/");
+  sensino::Client<UserRecord, UserConfig, BENCH_BS> client(
+      "http://sensino.test/", 1, "key", 1000);
+  unsigned long measured = 0;
+  client.onMeasureTick([&measured]() {
+    UserRecord record;
+    record.temperature = 20 + (measured % 50) * 0.01;
+    record.pressure = 1013.2;
+    record.humidity = 40 + measured % 7;
+    measured++;
+    return std::make_pair(record, true);
+  });
+  client.setBatchBytes(batchBytes);
+  if (strcmp(encoding, "msgpack") == 0) {
+    client.setEncoding(sensino::ENCODING::MSGPACK);
+  } else if (strcmp(encoding, "delta") == 0) {
+    client.setEncoding(sensino::ENCODING::DELTA);
+  }
+  client.setIdleSleep(true);
+
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  // Warm up (first connection, time sync, growing the body buffer).
+  // As the core does, yield between calls to loop.
+  while (measured < 5) {
+    client.loop();
+    yield();
+  }
+  client.resetStats();
+  unsigned long bytesSent = client.getBytesSent();
+  unsigned long bytesReceived = client.getBytesReceived();
+  unsigned long allocations = sim::allocations();
+  unsigned long long allocatedBytes = sim::allocatedBytes();
+
+  sim::setRealtime(true);
+  unsigned long first = measured;
+  while (measured - first < records) {
+    client.loop();
+    yield();
+  }
+  sim::setRealtime(false);
+
+  printf("Client<BS=%d> %lu records, %s, batch %lu bytes, link %lu+-%lu ms, "
+         "loss %.2f\n",
+         BENCH_BS, records, encoding, (unsigned long)batchBytes,
+         server.link.latency, server.link.jitter, server.link.loss);
+  const sensino::ClientStats &stats = client.getStats();
+  report("loop", stats.loop);
+  report("measure", stats.measure);
+  report("serialize", stats.serialize);
+  report("upload", stats.upload, "ms");
+  report("timeSync", stats.timeSync);
+  printf("%-18s %lu sent, %lu received, %.1f per record\n", "bytes",
+         client.getBytesSent() - bytesSent,
+         client.getBytesReceived() - bytesReceived,
+         (double)(client.getBytesSent() - bytesSent) / records);
+  printf("%-18s %lu (%llu bytes)\n", "allocations",
+         sim::allocations() - allocations,
+         sim::allocatedBytes() - allocatedBytes);
+  printf("%-18s %lu requests, %lu connections, %lu errors\n", "server",
+         server.received, server.connections, (unsigned long)stats.sendErrors);
+
+  // Opening a connection blocks until the handshake times out.
+  client.resetStats();
+  server.unreachable = true;
+  unsigned long start = millis();
+  while (millis() - start < 60000) {
+    client.loop();
+    yield();
+  }
+  server.unreachable = false;
+  report("loop unreachable", stats.loop);
+  printf("%-18s %lu errors, %lu ms blocked (max) per connect\n",
+         "unreachable", (unsigned long)stats.sendErrors,
+         (unsigned long)stats.loop.max() / 1000);
+
+  // Blocking calls, once the request in progress is done.
+  client.resetStats();
+  while (client.getSendState() != sensino::SEND_STATE::SUCCESS) {
+    client.loop();
+    yield();
+  }
+  while (client.getSendState() == sensino::SEND_STATE::PENDING) {
+    client.loop();
+    yield();
+  }
+  sim::setRealtime(true);
+  sensino::Histogram sendRecord;
+  unsigned long failed = 0;
+  for (int n = 0; n < 100; n++) {
+    unsigned long start = micros();
+    failed += !client.sendRecord(client.getLastRecord());
+    sendRecord.add(micros() - start);
+  }
+
+  WiFiUDP udp;
+  sensino::NTPClient ntpClient(udp);
+  ntpClient.begin();
+  sensino::Histogram forceUpdate;
+  for (int n = 0; n < 20; n++) {
+    unsigned long start = micros();
+    ntpClient.forceUpdate();
+    forceUpdate.add(micros() - start);
+  }
+
+  sensino::Screen screen;
+  screen.setup();
+  screen.rows3("Temperature", "20.0 C", "OK");
+  unsigned long busBytes = screen.u8g2.getBusBytes();
+  sensino::Histogram rows3;
+  char row[16];
+  for (int n = 0; n < 100; n++) {
+    snprintf(row, sizeof(row), "%d.%d C", 20 + n % 3, n % 10);
+    unsigned long start = micros();
+    screen.rows3("Temperature", row, "OK");
+    rows3.add(micros() - start);
+  }
+  sim::setRealtime(false);
+
+  report("sendRecord", sendRecord);
+  printf("%-18s %lu\n", "sendRecord errors", failed);
+  report("NTP forceUpdate", forceUpdate);
+  report("Screen::rows3", rows3);
+  printf("%-18s %.1f bytes per update (%d for the whole frame)\n", "screen bus",
+         (double)(screen.u8g2.getBusBytes() - busBytes) / 100,
+         SCREEN_BUFFER_SIZE);
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Cost of the userConfig headers on each request: bytes on the wire with
+ * the full SNO-USER-* set and with only SNO-CONFIG-HASH, and the time to
+ * render the set against the time to check the cached one.
+ *
+ *   bench_config [iterations]
+ *
+ * Times are real CPU time on the host, compare them with each other
+ * rather than with the board.
+ *
+ */
+#include "client.hpp"
+
+#include "sim.hpp"
+
+#include <chrono>
+
+struct UserRecord {
+  float temperature = 0;
+
+  void fill(JsonObject &doc) const { doc["t"] = this->temperature; }
+};
+
+struct UserConfig {
+  char site[16] = "greenhouse-3";
+  int gain = 4;
+  float offset = -0.25;
+
+  void fill(JsonDocument &doc) const {
+    doc["site"] = (const char *)this->site;
+    doc["gain"] = this->gain;
+    doc["offset"] = this->offset;
+  }
+};
+
+typedef sensino::Client<UserRecord, UserConfig, 10> BenchClient;
+
+sim::HttpServer server("sensino.test");
+
+// Time (in ns) per call of fn.
+template <typename F> double timeIt(int iterations, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; n++) {
+    fn();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+             .count() /
+         (double)iterations;
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  WiFi.begin(ssid, passphrase);
+  delay(1000);
+
+  BenchClient client("http://sensino.test/", 1, "key", 1000);
+  sensino::Record<UserRecord> record = {};
+  record.timestamp = 1700086400;
+
+  // The first request carries the full set, the next ones only the hash.
+  client.sendRecord(record);
+  size_t full = server.requests.back().size;
+  client.sendRecord(record);
+  size_t hashed = server.requests.back().size;
+  printf("%-10s %6zu bytes/request\n", "full", full);
+  printf("%-10s %6zu bytes/request\n", "hash", hashed);
+  printf("%-10s %6ld bytes/request\n", "saving",
+         (long)full - (long)hashed);
+
+  // Rendering is what every request did before the headers were cached,
+  // force it by changing userConfig.
+  int gain = 0;
+  double render = timeIt(iterations, [&]() {
+    client.userConfig.gain = gain++ % 2;
+    client._refreshConfig();
+  });
+  double cached = timeIt(iterations, [&]() { client._refreshConfig(); });
+  printf("%-10s %8.0f ns/request\n", "render", render);
+  printf("%-10s %8.0f ns/request\n", "cached", cached);
+  printf("%-10s %8.0f ns/request\n", "saving", render - cached);
+  return 0;
+}
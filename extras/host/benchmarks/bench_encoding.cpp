@@ -0,0 +1,120 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Bytes per record and encode time per record of each encoding, for
+ * single records and for batches.
+ *
+ *   bench_encoding [iterations]
+ *
+ * Times are real CPU time on the host, compare them between encodings
+ * rather than with the board. Build with ARDUINOJSON_DIR (see
+ * CMakeLists.txt) to time the real ArduinoJson instead of the stand-in.
+ *
+ */
+#include "client.hpp"
+
+#include "sim.hpp"
+
+#include <chrono>
+
+#define BENCH_BS 20
+
+struct UserRecord {
+  float temperature = 0;
+  float pressure = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["p"] = this->pressure;
+    doc["h"] = this->humidity;
+  }
+
+  template <typename C> void codec(C &codec) {
+    codec.field("t", this->temperature, 100);
+    codec.field("p", this->pressure, 10);
+    codec.field("h", this->humidity);
+  }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+typedef sensino::Client<UserRecord, UserConfig, BENCH_BS> BenchClient;
+
+sim::HttpServer server("sensino.test");
+
+// Time (in ns) per call of fn.
+template <typename F> double timeIt(int iterations, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; n++) {
+    fn();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+             .count() /
+         (double)iterations;
+}
+
+void single(const char *name, sensino::ENCODING encoding, int iterations) {
+  BenchClient client("http://sensino.test/", 1, "key", 1000);
+  client.setEncoding(encoding);
+  sensino::Record<UserRecord> record = {};
+  record.uptime = 86400000;
+  record.timestamp = 1700086400;
+  record.timestampMs = 123;
+  record.userRecord.temperature = 21.37;
+  record.userRecord.pressure = 1013.2;
+  record.userRecord.humidity = 43;
+
+  client.sendRecord(record);
+  size_t bytes = server.requests.back().body.size();
+  double ns = timeIt(iterations, [&]() { client._serializeRecord(record); });
+  printf("%-18s %8.1f bytes/record %10.0f ns/record\n", name, (double)bytes,
+         ns);
+}
+
+void batch(const char *name, sensino::ENCODING encoding, int iterations) {
+  BenchClient client("http://sensino.test/", 1, "key", 1000);
+  int counter = 0;
+  client.onMeasureTick([&counter]() {
+    UserRecord record;
+    record.temperature = 21 + (counter % 10) * 0.01;
+    record.pressure = 1013.2;
+    record.humidity = 43 + counter % 3;
+    counter++;
+    return std::make_pair(record, true);
+  });
+  client.setEncoding(encoding);
+  client.setBatchBytes(4000);
+  client.setFlushPolicy(BENCH_BS, 0);
+  while (counter < BENCH_BS - 1) {
+    client.run();
+    delay(1000);
+  }
+
+  size_t received = server.received;
+  int records = client._serializeBatch(BENCH_BS);
+  double ns = timeIt(iterations, [&]() { client._serializeBatch(BENCH_BS); });
+  client.sendBatch();
+  size_t bytes = server.received > received ? server.requests.back().body.size()
+                                            : 0;
+  printf("%-18s %8.1f bytes/record %10.0f ns/record (%d per batch)\n", name,
+         (double)bytes / records, ns / records, records);
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  WiFi.begin(ssid, passphrase);
+  delay(1000);
+
+  single("json", sensino::ENCODING::JSON, iterations);
+  single("msgpack", sensino::ENCODING::MSGPACK, iterations);
+  batch("json batch", sensino::ENCODING::JSON, iterations / BENCH_BS);
+  batch("msgpack batch", sensino::ENCODING::MSGPACK, iterations / BENCH_BS);
+  batch("delta batch", sensino::ENCODING::DELTA, iterations / BENCH_BS);
+  return 0;
+}
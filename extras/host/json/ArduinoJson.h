@@ -0,0 +1,1753 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the subset of ArduinoJson 6 used by the library, for the
+ * host build when the real library is not found (see CMakeLists.txt).
+ *
+ * Documents have a fixed capacity, accounted as on the ESP8266: 16 bytes
+ * per value and the length (plus one) of each copied string. Like with
+ * ArduinoJson, const char * values and keys are linked, not copied, and
+ * a document that ran out of room reports it with overflowed().
+ *
+ */
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <type_traits>
+
+#include <Arduino.h>
+
+#define ARDUINOJSON_SLOT_SIZE 16
+#define ARDUINOJSON_NESTING_LIMIT 10
+
+#define JSON_ARRAY_SIZE(n) ((n)*ARDUINOJSON_SLOT_SIZE)
+#define JSON_OBJECT_SIZE(n) ((n)*ARDUINOJSON_SLOT_SIZE)
+
+namespace json {
+
+enum class TYPE : uint8_t { NUL, BOOL, INT, UINT, FLOAT, STRING, ARRAY, OBJECT };
+
+struct Slot {
+  TYPE type = TYPE::NUL;
+  union {
+    bool b;
+    int64_t i;
+    uint64_t u;
+    double f;
+    const char *s;
+    struct {
+      Slot *head;
+      Slot *tail;
+    } c;
+  } v;
+  const char *key = nullptr;
+  Slot *next = nullptr;
+};
+
+// Values and copied strings of a document, in a fixed region.
+class Pool {
+
+private:
+  Slot *_slots = nullptr;
+  char *_strings = nullptr;
+  size_t _capacity = 0;
+  size_t _slotsUsed = 0;
+  size_t _stringsUsed = 0;
+  bool _overflowed = false;
+
+public:
+  // Physical room for a capacity: a Slot per possible value, and strings.
+  static constexpr size_t footprint(size_t capacity) {
+    return (capacity / ARDUINOJSON_SLOT_SIZE + 1) * sizeof(Slot) + capacity +
+           1;
+  }
+
+  void attach(void *region, size_t capacity) {
+    size_t slots = capacity / ARDUINOJSON_SLOT_SIZE + 1;
+    this->_slots = (Slot *)region;
+    this->_strings = (char *)region + slots * sizeof(Slot);
+    this->_capacity = region != nullptr ? capacity : 0;
+    this->clear();
+  }
+
+  void clear() {
+    this->_slotsUsed = 0;
+    this->_stringsUsed = 0;
+    this->_overflowed = false;
+  }
+
+  Slot *allocSlot() {
+    if (this->usage() + ARDUINOJSON_SLOT_SIZE > this->_capacity) {
+      this->_overflowed = true;
+      return nullptr;
+    }
+    Slot *slot = new (&this->_slots[this->_slotsUsed++]) Slot();
+    return slot;
+  }
+
+  const char *saveString(const char *value, size_t length) {
+    if (this->usage() + length + 1 > this->_capacity) {
+      this->_overflowed = true;
+      return nullptr;
+    }
+    char *copy = &this->_strings[this->_stringsUsed];
+    memcpy(copy, value, length);
+    copy[length] = 0;
+    this->_stringsUsed += length + 1;
+    return copy;
+  }
+
+  size_t usage() const {
+    return this->_slotsUsed * ARDUINOJSON_SLOT_SIZE + this->_stringsUsed;
+  }
+
+  size_t capacity() const { return this->_capacity; }
+
+  bool overflowed() const { return this->_overflowed; }
+
+  void setOverflowed() { this->_overflowed = true; }
+};
+
+inline void append(Slot *parent, Slot *child) {
+  if (parent->v.c.tail == nullptr) {
+    parent->v.c.head = child;
+  } else {
+    parent->v.c.tail->next = child;
+  }
+  parent->v.c.tail = child;
+}
+
+inline void setCollection(Slot *slot, TYPE type) {
+  slot->type = type;
+  slot->v.c.head = nullptr;
+  slot->v.c.tail = nullptr;
+}
+
+inline Slot *findMember(const Slot *object, const char *key) {
+  if (object == nullptr || object->type != TYPE::OBJECT || key == nullptr) {
+    return nullptr;
+  }
+  for (Slot *slot = object->v.c.head; slot != nullptr; slot = slot->next) {
+    if (strcmp(slot->key, key) == 0) {
+      return slot;
+    }
+  }
+  return nullptr;
+}
+
+inline Slot *findElement(const Slot *array, size_t index) {
+  if (array == nullptr || array->type != TYPE::ARRAY) {
+    return nullptr;
+  }
+  Slot *slot = array->v.c.head;
+  for (; slot != nullptr && index > 0; index--) {
+    slot = slot->next;
+  }
+  return slot;
+}
+
+inline size_t countChildren(const Slot *slot) {
+  if (slot == nullptr ||
+      (slot->type != TYPE::ARRAY && slot->type != TYPE::OBJECT)) {
+    return 0;
+  }
+  size_t count = 0;
+  for (Slot *child = slot->v.c.head; child != nullptr; child = child->next) {
+    count++;
+  }
+  return count;
+}
+
+inline void unlink(Slot *parent, Slot *child) {
+  Slot *previous = nullptr;
+  for (Slot *slot = parent->v.c.head; slot != nullptr; slot = slot->next) {
+    if (slot == child) {
+      if (previous == nullptr) {
+        parent->v.c.head = slot->next;
+      } else {
+        previous->next = slot->next;
+      }
+      if (parent->v.c.tail == slot) {
+        parent->v.c.tail = previous;
+      }
+      return;
+    }
+    previous = slot;
+  }
+}
+
+// Sink that counts or copies the serialized bytes.
+class Writer {
+
+private:
+  char *_buffer;
+  size_t _capacity;
+  size_t _length = 0;
+  String *_string = nullptr;
+
+public:
+  Writer(char *buffer, size_t capacity)
+      : _buffer(buffer), _capacity(capacity) {}
+
+  Writer(String &string) : _buffer(nullptr), _capacity(0), _string(&string) {}
+
+  void write(const char *data, size_t size) {
+    for (size_t n = 0; n < size; n++) {
+      this->put(data[n]);
+    }
+  }
+
+  void write(const char *data) { this->write(data, strlen(data)); }
+
+  void put(char c) {
+    if (this->_string != nullptr) {
+      *this->_string += c;
+      this->_length++;
+      return;
+    }
+    if (this->_buffer == nullptr) {
+      this->_length++;
+      return;
+    }
+    // Room is kept for the terminator.
+    if (this->_length + 1 < this->_capacity) {
+      this->_buffer[this->_length++] = c;
+      this->_buffer[this->_length] = 0;
+    }
+  }
+
+  size_t length() const { return this->_length; }
+};
+
+inline void writeJsonString(Writer &writer, const char *value) {
+  writer.put('"');
+  for (const char *c = value; *c != 0; c++) {
+    switch (*c) {
+    case '"':
+      writer.write("\\\"");
+      break;
+    case '\\':
+      writer.write("\\\\");
+      break;
+    case '\b':
+      writer.write("\\b");
+      break;
+    case '\f':
+      writer.write("\\f");
+      break;
+    case '\n':
+      writer.write("\\n");
+      break;
+    case '\r':
+      writer.write("\\r");
+      break;
+    case '\t':
+      writer.write("\\t");
+      break;
+    default:
+      if ((uint8_t)*c < 0x20) {
+        char escaped[7];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", (uint8_t)*c);
+        writer.write(escaped);
+      } else {
+        writer.put(*c);
+      }
+    }
+  }
+  writer.put('"');
+}
+
+inline void writeJson(Writer &writer, const Slot *slot) {
+  char number[32];
+  if (slot == nullptr) {
+    writer.write("null");
+    return;
+  }
+  switch (slot->type) {
+  case TYPE::NUL:
+    writer.write("null");
+    break;
+  case TYPE::BOOL:
+    writer.write(slot->v.b ? "true" : "false");
+    break;
+  case TYPE::INT:
+    snprintf(number, sizeof(number), "%lld", (long long)slot->v.i);
+    writer.write(number);
+    break;
+  case TYPE::UINT:
+    snprintf(number, sizeof(number), "%llu", (unsigned long long)slot->v.u);
+    writer.write(number);
+    break;
+  case TYPE::FLOAT:
+    if (isnan(slot->v.f)) {
+      writer.write("NaN");
+    } else if (isinf(slot->v.f)) {
+      writer.write(slot->v.f > 0 ? "Infinity" : "-Infinity");
+    } else {
+      snprintf(number, sizeof(number), "%.9g", slot->v.f);
+      writer.write(number);
+    }
+    break;
+  case TYPE::STRING:
+    writeJsonString(writer, slot->v.s);
+    break;
+  case TYPE::ARRAY:
+    writer.put('[');
+    for (Slot *child = slot->v.c.head; child != nullptr; child = child->next) {
+      if (child != slot->v.c.head) {
+        writer.put(',');
+      }
+      writeJson(writer, child);
+    }
+    writer.put(']');
+    break;
+  case TYPE::OBJECT:
+    writer.put('{');
+    for (Slot *child = slot->v.c.head; child != nullptr; child = child->next) {
+      if (child != slot->v.c.head) {
+        writer.put(',');
+      }
+      writeJsonString(writer, child->key);
+      writer.put(':');
+      writeJson(writer, child);
+    }
+    writer.put('}');
+    break;
+  }
+}
+
+inline void writeBigEndian(Writer &writer, uint64_t value, int bytes) {
+  for (int n = bytes - 1; n >= 0; n--) {
+    writer.put((char)((value >> (8 * n)) & 0xFF));
+  }
+}
+
+inline void writeMsgPackString(Writer &writer, const char *value) {
+  size_t length = strlen(value);
+  if (length < 32) {
+    writer.put((char)(0xA0 | length));
+  } else if (length < 0x100) {
+    writer.put((char)0xD9);
+    writeBigEndian(writer, length, 1);
+  } else if (length < 0x10000) {
+    writer.put((char)0xDA);
+    writeBigEndian(writer, length, 2);
+  } else {
+    writer.put((char)0xDB);
+    writeBigEndian(writer, length, 4);
+  }
+  writer.write(value, length);
+}
+
+inline void writeMsgPackUnsigned(Writer &writer, uint64_t value) {
+  if (value < 0x80) {
+    writer.put((char)value);
+  } else if (value < 0x100) {
+    writer.put((char)0xCC);
+    writeBigEndian(writer, value, 1);
+  } else if (value < 0x10000) {
+    writer.put((char)0xCD);
+    writeBigEndian(writer, value, 2);
+  } else if (value < 0x100000000ULL) {
+    writer.put((char)0xCE);
+    writeBigEndian(writer, value, 4);
+  } else {
+    writer.put((char)0xCF);
+    writeBigEndian(writer, value, 8);
+  }
+}
+
+inline void writeMsgPackSigned(Writer &writer, int64_t value) {
+  if (value >= 0) {
+    writeMsgPackUnsigned(writer, value);
+  } else if (value >= -32) {
+    writer.put((char)(int8_t)value);
+  } else if (value >= INT8_MIN) {
+    writer.put((char)0xD0);
+    writeBigEndian(writer, (uint8_t)value, 1);
+  } else if (value >= INT16_MIN) {
+    writer.put((char)0xD1);
+    writeBigEndian(writer, (uint16_t)value, 2);
+  } else if (value >= INT32_MIN) {
+    writer.put((char)0xD2);
+    writeBigEndian(writer, (uint32_t)value, 4);
+  } else {
+    writer.put((char)0xD3);
+    writeBigEndian(writer, (uint64_t)value, 8);
+  }
+}
+
+inline void writeMsgPackSize(Writer &writer, size_t size, uint8_t fix,
+                             uint8_t code16) {
+  if (size < 16) {
+    writer.put((char)(fix | size));
+  } else if (size < 0x10000) {
+    writer.put((char)code16);
+    writeBigEndian(writer, size, 2);
+  } else {
+    writer.put((char)(code16 + 1));
+    writeBigEndian(writer, size, 4);
+  }
+}
+
+inline void writeMsgPack(Writer &writer, const Slot *slot) {
+  if (slot == nullptr) {
+    writer.put((char)0xC0);
+    return;
+  }
+  switch (slot->type) {
+  case TYPE::NUL:
+    writer.put((char)0xC0);
+    break;
+  case TYPE::BOOL:
+    writer.put((char)(slot->v.b ? 0xC3 : 0xC2));
+    break;
+  case TYPE::INT:
+    writeMsgPackSigned(writer, slot->v.i);
+    break;
+  case TYPE::UINT:
+    writeMsgPackUnsigned(writer, slot->v.u);
+    break;
+  case TYPE::FLOAT: {
+    // As float32 when it does not lose precision.
+    float narrow = (float)slot->v.f;
+    if ((double)narrow == slot->v.f || isnan(slot->v.f)) {
+      uint32_t bits;
+      memcpy(&bits, &narrow, sizeof(bits));
+      writer.put((char)0xCA);
+      writeBigEndian(writer, bits, 4);
+    } else {
+      uint64_t bits;
+      memcpy(&bits, &slot->v.f, sizeof(bits));
+      writer.put((char)0xCB);
+      writeBigEndian(writer, bits, 8);
+    }
+    break;
+  }
+  case TYPE::STRING:
+    writeMsgPackString(writer, slot->v.s);
+    break;
+  case TYPE::ARRAY:
+    writeMsgPackSize(writer, countChildren(slot), 0x90, 0xDC);
+    for (Slot *child = slot->v.c.head; child != nullptr; child = child->next) {
+      writeMsgPack(writer, child);
+    }
+    break;
+  case TYPE::OBJECT:
+    writeMsgPackSize(writer, countChildren(slot), 0x80, 0xDE);
+    for (Slot *child = slot->v.c.head; child != nullptr; child = child->next) {
+      writeMsgPackString(writer, child->key);
+      writeMsgPack(writer, child);
+    }
+    break;
+  }
+}
+
+} // namespace json
+
+class JsonObject;
+class JsonArray;
+class JsonDocument;
+
+/**
+ * Reference to a value of a document. A missing member can be assigned,
+ * which adds it to its object.
+ */
+class JsonVariant {
+
+protected:
+  json::Pool *_pool = nullptr;
+  json::Slot *_slot = nullptr;
+
+  // Object and key of a member not added yet.
+  json::Slot *_parent = nullptr;
+  const char *_key = nullptr;
+  bool _copyKey = false; // A String key is copied, like with ArduinoJson.
+
+  // The slot of the value, added to its object if missing.
+  json::Slot *_materialize() {
+    if (this->_slot != nullptr || this->_pool == nullptr ||
+        this->_parent == nullptr) {
+      return this->_slot;
+    }
+    if (this->_parent->type == json::TYPE::NUL) {
+      json::setCollection(this->_parent, json::TYPE::OBJECT);
+    }
+    if (this->_parent->type != json::TYPE::OBJECT) {
+      return nullptr;
+    }
+    json::Slot *slot = this->_pool->allocSlot();
+    if (slot == nullptr) {
+      return nullptr;
+    }
+    slot->key = this->_key;
+    if (this->_copyKey) {
+      slot->key = this->_pool->saveString(this->_key, strlen(this->_key));
+      if (slot->key == nullptr) {
+        return nullptr;
+      }
+    }
+    json::append(this->_parent, slot);
+    this->_slot = slot;
+    this->_parent = nullptr;
+    return slot;
+  }
+
+  void _setString(const char *value, bool copy) {
+    json::Slot *slot = this->_materialize();
+    if (slot == nullptr) {
+      return;
+    }
+    if (value == nullptr) {
+      slot->type = json::TYPE::NUL;
+      return;
+    }
+    if (copy) {
+      value = this->_pool->saveString(value, strlen(value));
+      if (value == nullptr) {
+        slot->type = json::TYPE::NUL;
+        return;
+      }
+    }
+    slot->type = json::TYPE::STRING;
+    slot->v.s = value;
+  }
+
+  double _number() const {
+    if (this->_slot == nullptr) {
+      return 0;
+    }
+    switch (this->_slot->type) {
+    case json::TYPE::BOOL:
+      return this->_slot->v.b ? 1 : 0;
+    case json::TYPE::INT:
+      return (double)this->_slot->v.i;
+    case json::TYPE::UINT:
+      return (double)this->_slot->v.u;
+    case json::TYPE::FLOAT:
+      return this->_slot->v.f;
+    default:
+      return 0;
+    }
+  }
+
+  template <typename T> T _integer() const {
+    if (this->_slot == nullptr) {
+      return 0;
+    }
+    switch (this->_slot->type) {
+    case json::TYPE::BOOL:
+      return this->_slot->v.b ? 1 : 0;
+    case json::TYPE::INT:
+      return (T)this->_slot->v.i;
+    case json::TYPE::UINT:
+      return (T)this->_slot->v.u;
+    case json::TYPE::FLOAT:
+      return (T)this->_slot->v.f;
+    default:
+      return 0;
+    }
+  }
+
+  bool _isNumber() const {
+    return this->_slot != nullptr && (this->_slot->type == json::TYPE::INT ||
+                                      this->_slot->type == json::TYPE::UINT ||
+                                      this->_slot->type == json::TYPE::FLOAT);
+  }
+
+  bool _isInteger() const {
+    return this->_slot != nullptr && (this->_slot->type == json::TYPE::INT ||
+                                      this->_slot->type == json::TYPE::UINT);
+  }
+
+  // Member or element of this value (which must exist to be read).
+  JsonVariant _member(const char *key, bool copyKey = false) const {
+    JsonVariant variant;
+    variant._pool = this->_pool;
+    variant._slot = json::findMember(this->_slot, key);
+    if (variant._slot == nullptr && this->_slot != nullptr &&
+        (this->_slot->type == json::TYPE::OBJECT ||
+         this->_slot->type == json::TYPE::NUL)) {
+      variant._parent = this->_slot;
+      variant._key = key;
+      variant._copyKey = copyKey;
+    }
+    return variant;
+  }
+
+  // Replace the value by an empty collection.
+  JsonVariant _toCollection(json::TYPE type) {
+    JsonVariant variant;
+    json::Slot *slot = this->_materialize();
+    if (slot != nullptr) {
+      json::setCollection(slot, type);
+      variant._pool = this->_pool;
+      variant._slot = slot;
+    }
+    return variant;
+  }
+
+  // Add an element at the end of the array.
+  JsonVariant _addElement() {
+    JsonVariant variant;
+    if (this->_slot == nullptr || this->_slot->type != json::TYPE::ARRAY) {
+      return variant;
+    }
+    json::Slot *slot = this->_pool->allocSlot();
+    if (slot != nullptr) {
+      json::append(this->_slot, slot);
+      variant._pool = this->_pool;
+      variant._slot = slot;
+    }
+    return variant;
+  }
+
+  friend class JsonDocument;
+  friend class JsonPair;
+  friend class JsonObjectIterator;
+  friend class JsonArrayIterator;
+  friend const json::Slot *jsonSlot(const JsonVariant &variant);
+
+public:
+  JsonVariant() {}
+
+  JsonVariant(json::Pool *pool, json::Slot *slot)
+      : _pool(pool), _slot(slot) {}
+
+  bool isNull() const {
+    return this->_slot == nullptr || this->_slot->type == json::TYPE::NUL;
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value, JsonVariant &>::type
+  operator=(T value) {
+    json::Slot *slot = this->_materialize();
+    if (slot == nullptr) {
+      return *this;
+    }
+    if (std::is_same<T, bool>::value) {
+      slot->type = json::TYPE::BOOL;
+      slot->v.b = value;
+    } else if (std::is_floating_point<T>::value) {
+      slot->type = json::TYPE::FLOAT;
+      slot->v.f = value;
+    } else if (std::is_signed<T>::value) {
+      slot->type = json::TYPE::INT;
+      slot->v.i = (int64_t)value;
+    } else {
+      slot->type = json::TYPE::UINT;
+      slot->v.u = (uint64_t)value;
+    }
+    return *this;
+  }
+
+  JsonVariant &operator=(const char *value) {
+    this->_setString(value, false);
+    return *this;
+  }
+
+  JsonVariant &operator=(char *value) {
+    this->_setString(value, true);
+    return *this;
+  }
+
+  JsonVariant &operator=(const String &value) {
+    this->_setString(value.c_str(), true);
+    return *this;
+  }
+
+  JsonVariant &operator=(decltype(nullptr)) {
+    json::Slot *slot = this->_materialize();
+    if (slot != nullptr) {
+      slot->type = json::TYPE::NUL;
+    }
+    return *this;
+  }
+
+  JsonVariant operator[](const char *key) const { return this->_member(key); }
+
+  JsonVariant operator[](const String &key) const {
+    return this->_member(key.c_str(), true);
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value, JsonVariant>::type
+  operator[](T index) const {
+    return JsonVariant(this->_pool, json::findElement(this->_slot, index));
+  }
+
+  bool containsKey(const char *key) const {
+    return json::findMember(this->_slot, key) != nullptr;
+  }
+
+  size_t size() const { return json::countChildren(this->_slot); }
+
+  JsonObject createNestedObject(const char *key);
+
+  JsonArray createNestedArray(const char *key);
+
+  JsonObject createNestedObject();
+
+  JsonArray createNestedArray();
+
+  template <typename T> T as() const;
+
+  template <typename T> bool is() const;
+
+  template <typename T> T to();
+
+  template <typename T> bool add(T value) {
+    JsonVariant element = this->_addElement();
+    if (element._slot == nullptr) {
+      return false;
+    }
+    element = value;
+    return true;
+  }
+
+  void remove(const char *key) {
+    json::Slot *slot = json::findMember(this->_slot, key);
+    if (slot != nullptr) {
+      json::unlink(this->_slot, slot);
+    }
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value>::type remove(T index) {
+    json::Slot *slot = json::findElement(this->_slot, index);
+    if (slot != nullptr) {
+      json::unlink(this->_slot, slot);
+    }
+  }
+
+  template <typename T,
+            typename = typename std::enable_if<
+                std::is_arithmetic<T>::value ||
+                std::is_same<T, const char *>::value>::type>
+  operator T() const {
+    return this->as<T>();
+  }
+};
+
+inline const json::Slot *jsonSlot(const JsonVariant &variant) {
+  return variant._slot;
+}
+
+// Name and value of a member of an object.
+class JsonString {
+
+private:
+  const char *_value;
+
+public:
+  JsonString(const char *value) : _value(value) {}
+
+  const char *c_str() const { return this->_value; }
+
+  bool operator==(const char *other) const {
+    return strcmp(this->_value, other) == 0;
+  }
+};
+
+class JsonPair {
+
+private:
+  json::Pool *_pool;
+  json::Slot *_slot;
+
+public:
+  JsonPair(json::Pool *pool, json::Slot *slot) : _pool(pool), _slot(slot) {}
+
+  JsonString key() const { return JsonString(this->_slot->key); }
+
+  JsonVariant value() const { return JsonVariant(this->_pool, this->_slot); }
+};
+
+class JsonObjectIterator {
+
+private:
+  json::Pool *_pool;
+  json::Slot *_slot;
+
+public:
+  JsonObjectIterator(json::Pool *pool, json::Slot *slot)
+      : _pool(pool), _slot(slot) {}
+
+  JsonPair operator*() const { return JsonPair(this->_pool, this->_slot); }
+
+  JsonObjectIterator &operator++() {
+    this->_slot = this->_slot->next;
+    return *this;
+  }
+
+  bool operator!=(const JsonObjectIterator &other) const {
+    return this->_slot != other._slot;
+  }
+};
+
+class JsonArrayIterator {
+
+private:
+  json::Pool *_pool;
+  json::Slot *_slot;
+
+public:
+  JsonArrayIterator(json::Pool *pool, json::Slot *slot)
+      : _pool(pool), _slot(slot) {}
+
+  JsonVariant operator*() const {
+    return JsonVariant(this->_pool, this->_slot);
+  }
+
+  JsonArrayIterator &operator++() {
+    this->_slot = this->_slot->next;
+    return *this;
+  }
+
+  bool operator!=(const JsonArrayIterator &other) const {
+    return this->_slot != other._slot;
+  }
+};
+
+class JsonObject : public JsonVariant {
+
+public:
+  JsonObject() {}
+
+  JsonObject(const JsonVariant &variant) : JsonVariant(variant) {
+    if (this->_slot != nullptr && this->_slot->type != json::TYPE::OBJECT) {
+      this->_slot = nullptr;
+    }
+    this->_parent = nullptr;
+  }
+
+  JsonObjectIterator begin() const {
+    return JsonObjectIterator(this->_pool, this->_slot != nullptr
+                                               ? this->_slot->v.c.head
+                                               : nullptr);
+  }
+
+  JsonObjectIterator end() const {
+    return JsonObjectIterator(this->_pool, nullptr);
+  }
+
+  JsonObject createNestedObject(const char *key) {
+    return JsonVariant::createNestedObject(key);
+  }
+
+  JsonArray createNestedArray(const char *key);
+};
+
+class JsonArray : public JsonVariant {
+
+public:
+  JsonArray() {}
+
+  JsonArray(const JsonVariant &variant) : JsonVariant(variant) {
+    if (this->_slot != nullptr && this->_slot->type != json::TYPE::ARRAY) {
+      this->_slot = nullptr;
+    }
+    this->_parent = nullptr;
+  }
+
+  JsonArrayIterator begin() const {
+    return JsonArrayIterator(this->_pool, this->_slot != nullptr
+                                              ? this->_slot->v.c.head
+                                              : nullptr);
+  }
+
+  JsonArrayIterator end() const {
+    return JsonArrayIterator(this->_pool, nullptr);
+  }
+
+  JsonObject createNestedObject() {
+    return JsonVariant::createNestedObject();
+  }
+
+  JsonArray createNestedArray();
+};
+
+typedef JsonVariant JsonVariantConst;
+typedef JsonObject JsonObjectConst;
+typedef JsonArray JsonArrayConst;
+
+inline JsonObject JsonVariant::createNestedObject(const char *key) {
+  return this->_member(key)._toCollection(json::TYPE::OBJECT);
+}
+
+inline JsonArray JsonVariant::createNestedArray(const char *key) {
+  return this->_member(key)._toCollection(json::TYPE::ARRAY);
+}
+
+inline JsonObject JsonVariant::createNestedObject() {
+  return this->_addElement()._toCollection(json::TYPE::OBJECT);
+}
+
+inline JsonArray JsonVariant::createNestedArray() {
+  return this->_addElement()._toCollection(json::TYPE::ARRAY);
+}
+
+inline JsonArray JsonObject::createNestedArray(const char *key) {
+  return JsonVariant::createNestedArray(key);
+}
+
+inline JsonArray JsonArray::createNestedArray() {
+  return JsonVariant::createNestedArray();
+}
+
+namespace json {
+
+template <typename T, typename Enable = void> struct Converter {
+  static T as(const JsonVariant &variant) { return T(variant); }
+  static bool is(const JsonVariant &variant) { return false; }
+};
+
+template <> struct Converter<bool> {
+  static bool as(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    if (slot == nullptr) {
+      return false;
+    }
+    switch (slot->type) {
+    case TYPE::BOOL:
+      return slot->v.b;
+    case TYPE::INT:
+    case TYPE::UINT:
+      return slot->v.u != 0;
+    case TYPE::FLOAT:
+      return slot->v.f != 0;
+    default:
+      return false;
+    }
+  }
+  static bool is(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr && slot->type == TYPE::BOOL;
+  }
+};
+
+template <typename T>
+struct Converter<T, typename std::enable_if<std::is_integral<T>::value &&
+                                            !std::is_same<T, bool>::value>::type> {
+  static T as(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    if (slot == nullptr) {
+      return 0;
+    }
+    switch (slot->type) {
+    case TYPE::BOOL:
+      return slot->v.b ? 1 : 0;
+    case TYPE::INT:
+      return (T)slot->v.i;
+    case TYPE::UINT:
+      return (T)slot->v.u;
+    case TYPE::FLOAT:
+      return (T)slot->v.f;
+    default:
+      return 0;
+    }
+  }
+  static bool is(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr &&
+           (slot->type == TYPE::INT || slot->type == TYPE::UINT);
+  }
+};
+
+template <typename T>
+struct Converter<T,
+                 typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static T as(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    if (slot == nullptr) {
+      return 0;
+    }
+    switch (slot->type) {
+    case TYPE::BOOL:
+      return slot->v.b ? 1 : 0;
+    case TYPE::INT:
+      return (T)slot->v.i;
+    case TYPE::UINT:
+      return (T)slot->v.u;
+    case TYPE::FLOAT:
+      return (T)slot->v.f;
+    default:
+      return 0;
+    }
+  }
+  static bool is(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr &&
+           (slot->type == TYPE::INT || slot->type == TYPE::UINT ||
+            slot->type == TYPE::FLOAT);
+  }
+};
+
+template <> struct Converter<const char *> {
+  static const char *as(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr && slot->type == TYPE::STRING ? slot->v.s
+                                                         : nullptr;
+  }
+  static bool is(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr && slot->type == TYPE::STRING;
+  }
+};
+
+template <> struct Converter<String> {
+  static String as(const JsonVariant &variant) {
+    const char *value = Converter<const char *>::as(variant);
+    return String(value != nullptr ? value : "");
+  }
+  static bool is(const JsonVariant &variant) {
+    return Converter<const char *>::is(variant);
+  }
+};
+
+template <> struct Converter<JsonObject> {
+  static JsonObject as(const JsonVariant &variant) {
+    return JsonObject(variant);
+  }
+  static bool is(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr && slot->type == TYPE::OBJECT;
+  }
+};
+
+template <> struct Converter<JsonArray> {
+  static JsonArray as(const JsonVariant &variant) {
+    return JsonArray(variant);
+  }
+  static bool is(const JsonVariant &variant) {
+    const Slot *slot = jsonSlot(variant);
+    return slot != nullptr && slot->type == TYPE::ARRAY;
+  }
+};
+
+template <> struct Converter<JsonVariant> {
+  static JsonVariant as(const JsonVariant &variant) { return variant; }
+  static bool is(const JsonVariant &variant) { return true; }
+};
+
+} // namespace json
+
+template <typename T> T JsonVariant::as() const {
+  return json::Converter<T>::as(*this);
+}
+
+template <typename T> bool JsonVariant::is() const {
+  return json::Converter<T>::is(*this);
+}
+
+template <typename T> T JsonVariant::to() {
+  if (std::is_same<T, JsonArray>::value) {
+    return T(this->_toCollection(json::TYPE::ARRAY));
+  }
+  if (std::is_same<T, JsonObject>::value) {
+    return T(this->_toCollection(json::TYPE::OBJECT));
+  }
+  *this = nullptr;
+  return T(*this);
+}
+
+// The value if it has the type of the default, otherwise the default.
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value, T>::type
+operator|(const JsonVariant &variant, T value) {
+  return variant.is<T>() ? variant.as<T>() : value;
+}
+
+inline const char *operator|(const JsonVariant &variant, const char *value) {
+  return variant.is<const char *>() ? variant.as<const char *>() : value;
+}
+
+/**
+ * Document with a fixed capacity (see StaticJsonDocument and
+ * BasicJsonDocument).
+ */
+class JsonDocument {
+
+protected:
+  json::Pool _pool;
+  json::Slot _root;
+
+  JsonDocument() {}
+
+  JsonVariant _variant() const {
+    return JsonVariant(const_cast<json::Pool *>(&this->_pool),
+                       const_cast<json::Slot *>(&this->_root));
+  }
+
+  friend const json::Slot *jsonSlot(const JsonDocument &doc);
+
+public:
+  JsonDocument(const JsonDocument &) = delete;
+  JsonDocument &operator=(const JsonDocument &) = delete;
+
+  void clear() {
+    this->_pool.clear();
+    this->_root = json::Slot();
+  }
+
+  bool overflowed() const { return this->_pool.overflowed(); }
+
+  size_t memoryUsage() const { return this->_pool.usage(); }
+
+  size_t capacity() const { return this->_pool.capacity(); }
+
+  // Used by the parsers.
+  json::Pool &pool() { return this->_pool; }
+
+  bool isNull() const { return this->_root.type == json::TYPE::NUL; }
+
+  size_t size() const { return json::countChildren(&this->_root); }
+
+  JsonVariant operator[](const char *key) { return this->_variant()[key]; }
+
+  JsonVariant operator[](const char *key) const {
+    return this->_variant()[key];
+  }
+
+  JsonVariant operator[](const String &key) {
+    return this->_variant()[key];
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value, JsonVariant>::type
+  operator[](T index) const {
+    return this->_variant()[index];
+  }
+
+  bool containsKey(const char *key) const {
+    return this->_variant().containsKey(key);
+  }
+
+  JsonObject createNestedObject(const char *key) {
+    return this->_variant().createNestedObject(key);
+  }
+
+  JsonArray createNestedArray(const char *key) {
+    return this->_variant().createNestedArray(key);
+  }
+
+  JsonObject createNestedObject() {
+    return this->_variant().createNestedObject();
+  }
+
+  JsonArray createNestedArray() {
+    return this->_variant().createNestedArray();
+  }
+
+  template <typename T> bool add(T value) {
+    if (this->_root.type == json::TYPE::NUL) {
+      json::setCollection(&this->_root, json::TYPE::ARRAY);
+    }
+    return this->_variant().add(value);
+  }
+
+  void remove(const char *key) { this->_variant().remove(key); }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value>::type remove(T index) {
+    this->_variant().remove(index);
+  }
+
+  template <typename T> T as() const { return this->_variant().as<T>(); }
+
+  template <typename T> bool is() const { return this->_variant().is<T>(); }
+
+  // Replace the content by an empty object or array.
+  template <typename T> T to() {
+    this->clear();
+    return this->_variant().to<T>();
+  }
+
+  template <typename T> JsonDocument &operator=(T value) {
+    this->clear();
+    JsonVariant root = this->_variant();
+    root = value;
+    return *this;
+  }
+
+  operator JsonVariant() const { return this->_variant(); }
+};
+
+inline const json::Slot *jsonSlot(const JsonDocument &doc) {
+  return &doc._root;
+}
+
+template <size_t N> class StaticJsonDocument : public JsonDocument {
+
+private:
+  typename std::aligned_storage<sizeof(json::Slot),
+                                alignof(json::Slot)>::type
+      _region[(json::Pool::footprint(N) + sizeof(json::Slot) - 1) /
+              sizeof(json::Slot)];
+
+public:
+  StaticJsonDocument() { this->_pool.attach(this->_region, N); }
+};
+
+template <typename A> class BasicJsonDocument : public JsonDocument {
+
+private:
+  A _allocator;
+  void *_region = nullptr;
+
+public:
+  BasicJsonDocument(size_t capacity) {
+    this->_region = this->_allocator.allocate(json::Pool::footprint(capacity));
+    this->_pool.attach(this->_region, capacity);
+  }
+
+  ~BasicJsonDocument() {
+    if (this->_region != nullptr) {
+      this->_allocator.deallocate(this->_region);
+    }
+  }
+};
+
+namespace json {
+
+struct DefaultAllocator {
+  void *allocate(size_t size) { return malloc(size); }
+  void deallocate(void *pointer) { free(pointer); }
+  void *reallocate(void *pointer, size_t size) {
+    return realloc(pointer, size);
+  }
+};
+
+} // namespace json
+
+typedef BasicJsonDocument<json::DefaultAllocator> DynamicJsonDocument;
+
+// Serialization, of a document or of a value in it.
+
+template <typename T> size_t serializeJson(const T &source, char *output,
+                                           size_t size) {
+  json::Writer writer(output, size);
+  if (size > 0) {
+    output[0] = 0;
+  }
+  json::writeJson(writer, jsonSlot(source));
+  return writer.length();
+}
+
+template <typename T> size_t serializeJson(const T &source, String &output) {
+  json::Writer writer(output);
+  json::writeJson(writer, jsonSlot(source));
+  return writer.length();
+}
+
+template <typename T> size_t measureJson(const T &source) {
+  json::Writer writer(nullptr, 0);
+  json::writeJson(writer, jsonSlot(source));
+  return writer.length();
+}
+
+template <typename T>
+size_t serializeMsgPack(const T &source, void *output, size_t size) {
+  json::Writer writer((char *)output, size);
+  json::writeMsgPack(writer, jsonSlot(source));
+  return writer.length();
+}
+
+template <typename T> size_t measureMsgPack(const T &source) {
+  json::Writer writer(nullptr, 0);
+  json::writeMsgPack(writer, jsonSlot(source));
+  return writer.length();
+}
+
+// Deserialization, the strings are copied in the document.
+
+class DeserializationError {
+
+public:
+  enum Code {
+    Ok,
+    EmptyInput,
+    IncompleteInput,
+    InvalidInput,
+    NoMemory,
+    TooDeep
+  };
+
+private:
+  Code _code;
+
+public:
+  DeserializationError(Code code = Ok) : _code(code) {}
+
+  Code code() const { return this->_code; }
+
+  explicit operator bool() const { return this->_code != Ok; }
+
+  bool operator==(Code code) const { return this->_code == code; }
+
+  bool operator!=(Code code) const { return this->_code != code; }
+
+  const char *c_str() const {
+    static const char *names[] = {"Ok",           "EmptyInput",
+                                  "IncompleteInput", "InvalidInput",
+                                  "NoMemory",     "TooDeep"};
+    return names[this->_code];
+  }
+};
+
+namespace json {
+
+class JsonParser {
+
+private:
+  Pool &_pool;
+  const char *_input;
+  const char *_end;
+  DeserializationError::Code _error = DeserializationError::Ok;
+
+  void _skipSpaces() {
+    while (this->_input < this->_end &&
+           (*this->_input == ' ' || *this->_input == '\t' ||
+            *this->_input == '\n' || *this->_input == '\r')) {
+      this->_input++;
+    }
+  }
+
+  bool _fail(DeserializationError::Code code) {
+    if (this->_error == DeserializationError::Ok) {
+      this->_error = code;
+    }
+    return false;
+  }
+
+  bool _expect(char c) {
+    this->_skipSpaces();
+    if (this->_input >= this->_end) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    if (*this->_input != c) {
+      return this->_fail(DeserializationError::InvalidInput);
+    }
+    this->_input++;
+    return true;
+  }
+
+  // Parse a quoted string and copy it in the pool.
+  bool _string(const char *&value) {
+    if (!this->_expect('"')) {
+      return false;
+    }
+    char buffer[256];
+    size_t length = 0;
+    while (true) {
+      if (this->_input >= this->_end) {
+        return this->_fail(DeserializationError::IncompleteInput);
+      }
+      char c = *this->_input++;
+      if (c == '"') {
+        break;
+      }
+      if (c == '\\') {
+        if (this->_input >= this->_end) {
+          return this->_fail(DeserializationError::IncompleteInput);
+        }
+        c = *this->_input++;
+        switch (c) {
+        case 'b':
+          c = '\b';
+          break;
+        case 'f':
+          c = '\f';
+          break;
+        case 'n':
+          c = '\n';
+          break;
+        case 'r':
+          c = '\r';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case 'u': {
+          if (this->_end - this->_input < 4) {
+            return this->_fail(DeserializationError::IncompleteInput);
+          }
+          char hex[5] = {this->_input[0], this->_input[1], this->_input[2],
+                         this->_input[3], 0};
+          this->_input += 4;
+          unsigned long code = strtoul(hex, nullptr, 16);
+          // Only the ASCII range is decoded.
+          c = code < 0x80 ? (char)code : '?';
+          break;
+        }
+        default:
+          break;
+        }
+      }
+      if (length >= sizeof(buffer) - 1) {
+        return this->_fail(DeserializationError::NoMemory);
+      }
+      buffer[length++] = c;
+    }
+    value = this->_pool.saveString(buffer, length);
+    if (value == nullptr) {
+      return this->_fail(DeserializationError::NoMemory);
+    }
+    return true;
+  }
+
+  bool _literal(const char *word) {
+    size_t length = strlen(word);
+    if ((size_t)(this->_end - this->_input) < length) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    if (strncmp(this->_input, word, length) != 0) {
+      return this->_fail(DeserializationError::InvalidInput);
+    }
+    this->_input += length;
+    return true;
+  }
+
+  bool _number(Slot *slot) {
+    char buffer[40];
+    size_t length = 0;
+    bool real = false;
+    while (this->_input < this->_end && length < sizeof(buffer) - 1 &&
+           strchr("+-0123456789.eE", *this->_input) != nullptr) {
+      real = real || strchr(".eE", *this->_input) != nullptr;
+      buffer[length++] = *this->_input++;
+    }
+    buffer[length] = 0;
+    if (length == 0) {
+      return this->_fail(DeserializationError::InvalidInput);
+    }
+    if (real) {
+      slot->type = TYPE::FLOAT;
+      slot->v.f = strtod(buffer, nullptr);
+    } else if (buffer[0] == '-') {
+      slot->type = TYPE::INT;
+      slot->v.i = strtoll(buffer, nullptr, 10);
+    } else {
+      slot->type = TYPE::UINT;
+      slot->v.u = strtoull(buffer, nullptr, 10);
+    }
+    return true;
+  }
+
+public:
+  JsonParser(Pool &pool, const char *input, size_t length)
+      : _pool(pool), _input(input), _end(input + length) {}
+
+  bool value(Slot *slot, int depth) {
+    if (depth > ARDUINOJSON_NESTING_LIMIT) {
+      return this->_fail(DeserializationError::TooDeep);
+    }
+    this->_skipSpaces();
+    if (this->_input >= this->_end) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    switch (*this->_input) {
+    case '{':
+      this->_input++;
+      setCollection(slot, TYPE::OBJECT);
+      this->_skipSpaces();
+      if (this->_input < this->_end && *this->_input == '}') {
+        this->_input++;
+        return true;
+      }
+      while (true) {
+        const char *key;
+        if (!this->_string(key) || !this->_expect(':')) {
+          return false;
+        }
+        Slot *child = this->_pool.allocSlot();
+        if (child == nullptr) {
+          return this->_fail(DeserializationError::NoMemory);
+        }
+        child->key = key;
+        append(slot, child);
+        if (!this->value(child, depth + 1)) {
+          return false;
+        }
+        this->_skipSpaces();
+        if (this->_input < this->_end && *this->_input == ',') {
+          this->_input++;
+          continue;
+        }
+        return this->_expect('}');
+      }
+    case '[':
+      this->_input++;
+      setCollection(slot, TYPE::ARRAY);
+      this->_skipSpaces();
+      if (this->_input < this->_end && *this->_input == ']') {
+        this->_input++;
+        return true;
+      }
+      while (true) {
+        Slot *child = this->_pool.allocSlot();
+        if (child == nullptr) {
+          return this->_fail(DeserializationError::NoMemory);
+        }
+        append(slot, child);
+        if (!this->value(child, depth + 1)) {
+          return false;
+        }
+        this->_skipSpaces();
+        if (this->_input < this->_end && *this->_input == ',') {
+          this->_input++;
+          continue;
+        }
+        return this->_expect(']');
+      }
+    case '"':
+      slot->type = TYPE::STRING;
+      return this->_string(slot->v.s);
+    case 't':
+      slot->type = TYPE::BOOL;
+      slot->v.b = true;
+      return this->_literal("true");
+    case 'f':
+      slot->type = TYPE::BOOL;
+      slot->v.b = false;
+      return this->_literal("false");
+    case 'n':
+      slot->type = TYPE::NUL;
+      return this->_literal("null");
+    default:
+      return this->_number(slot);
+    }
+  }
+
+  DeserializationError::Code error() const { return this->_error; }
+};
+
+class MsgPackParser {
+
+private:
+  Pool &_pool;
+  const uint8_t *_input;
+  const uint8_t *_end;
+  DeserializationError::Code _error = DeserializationError::Ok;
+
+  bool _fail(DeserializationError::Code code) {
+    if (this->_error == DeserializationError::Ok) {
+      this->_error = code;
+    }
+    return false;
+  }
+
+  bool _read(uint64_t &value, int bytes) {
+    if (this->_end - this->_input < bytes) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    value = 0;
+    for (int n = 0; n < bytes; n++) {
+      value = value << 8 | *this->_input++;
+    }
+    return true;
+  }
+
+  bool _string(const char *&value, size_t length) {
+    if ((size_t)(this->_end - this->_input) < length) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    value = this->_pool.saveString((const char *)this->_input, length);
+    this->_input += length;
+    if (value == nullptr) {
+      return this->_fail(DeserializationError::NoMemory);
+    }
+    return true;
+  }
+
+  bool _key(const char *&key) {
+    if (this->_input >= this->_end) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    uint8_t code = *this->_input++;
+    uint64_t length;
+    if ((code & 0xE0) == 0xA0) {
+      length = code & 0x1F;
+    } else if (code == 0xD9 || code == 0xDA || code == 0xDB) {
+      if (!this->_read(length, 1 << (code - 0xD9))) {
+        return false;
+      }
+    } else {
+      return this->_fail(DeserializationError::InvalidInput);
+    }
+    return this->_string(key, length);
+  }
+
+  bool _collection(Slot *slot, TYPE type, uint64_t size, int depth) {
+    setCollection(slot, type);
+    for (uint64_t n = 0; n < size; n++) {
+      Slot *child = this->_pool.allocSlot();
+      if (child == nullptr) {
+        return this->_fail(DeserializationError::NoMemory);
+      }
+      if (type == TYPE::OBJECT && !this->_key(child->key)) {
+        return false;
+      }
+      append(slot, child);
+      if (!this->value(child, depth + 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+public:
+  MsgPackParser(Pool &pool, const char *input, size_t length)
+      : _pool(pool), _input((const uint8_t *)input),
+        _end((const uint8_t *)input + length) {}
+
+  bool value(Slot *slot, int depth) {
+    if (depth > ARDUINOJSON_NESTING_LIMIT) {
+      return this->_fail(DeserializationError::TooDeep);
+    }
+    if (this->_input >= this->_end) {
+      return this->_fail(DeserializationError::IncompleteInput);
+    }
+    uint8_t code = *this->_input++;
+    uint64_t value;
+    if (code < 0x80) {
+      slot->type = TYPE::UINT;
+      slot->v.u = code;
+      return true;
+    }
+    if (code >= 0xE0) {
+      slot->type = TYPE::INT;
+      slot->v.i = (int8_t)code;
+      return true;
+    }
+    if ((code & 0xF0) == 0x80) {
+      return this->_collection(slot, TYPE::OBJECT, code & 0x0F, depth);
+    }
+    if ((code & 0xF0) == 0x90) {
+      return this->_collection(slot, TYPE::ARRAY, code & 0x0F, depth);
+    }
+    if ((code & 0xE0) == 0xA0) {
+      slot->type = TYPE::STRING;
+      return this->_string(slot->v.s, code & 0x1F);
+    }
+    switch (code) {
+    case 0xC0:
+      slot->type = TYPE::NUL;
+      return true;
+    case 0xC2:
+    case 0xC3:
+      slot->type = TYPE::BOOL;
+      slot->v.b = code == 0xC3;
+      return true;
+    case 0xCA: {
+      if (!this->_read(value, 4)) {
+        return false;
+      }
+      uint32_t bits = (uint32_t)value;
+      float number;
+      memcpy(&number, &bits, sizeof(number));
+      slot->type = TYPE::FLOAT;
+      slot->v.f = number;
+      return true;
+    }
+    case 0xCB:
+      if (!this->_read(value, 8)) {
+        return false;
+      }
+      slot->type = TYPE::FLOAT;
+      memcpy(&slot->v.f, &value, sizeof(value));
+      return true;
+    case 0xCC:
+    case 0xCD:
+    case 0xCE:
+    case 0xCF:
+      if (!this->_read(value, 1 << (code - 0xCC))) {
+        return false;
+      }
+      slot->type = TYPE::UINT;
+      slot->v.u = value;
+      return true;
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3: {
+      int bytes = 1 << (code - 0xD0);
+      if (!this->_read(value, bytes)) {
+        return false;
+      }
+      int shift = 64 - 8 * bytes;
+      slot->type = TYPE::INT;
+      slot->v.i = (int64_t)(value << shift) >> shift;
+      return true;
+    }
+    case 0xD9:
+    case 0xDA:
+    case 0xDB:
+      if (!this->_read(value, 1 << (code - 0xD9))) {
+        return false;
+      }
+      slot->type = TYPE::STRING;
+      return this->_string(slot->v.s, value);
+    case 0xDC:
+    case 0xDD:
+      if (!this->_read(value, code == 0xDC ? 2 : 4)) {
+        return false;
+      }
+      return this->_collection(slot, TYPE::ARRAY, value, depth);
+    case 0xDE:
+    case 0xDF:
+      if (!this->_read(value, code == 0xDE ? 2 : 4)) {
+        return false;
+      }
+      return this->_collection(slot, TYPE::OBJECT, value, depth);
+    default:
+      return this->_fail(DeserializationError::InvalidInput);
+    }
+  }
+
+  DeserializationError::Code error() const { return this->_error; }
+};
+
+template <typename P>
+DeserializationError deserialize(JsonDocument &doc, const char *input,
+                                 size_t length) {
+  doc.clear();
+  if (input == nullptr || length == 0) {
+    return DeserializationError::EmptyInput;
+  }
+  P parser(doc.pool(), input, length);
+  if (!parser.value(const_cast<Slot *>(jsonSlot(doc)), 0)) {
+    return parser.error();
+  }
+  return DeserializationError::Ok;
+}
+
+} // namespace json
+
+inline DeserializationError deserializeJson(JsonDocument &doc,
+                                            const char *input, size_t length) {
+  return json::deserialize<json::JsonParser>(doc, input, length);
+}
+
+inline DeserializationError deserializeJson(JsonDocument &doc,
+                                            const char *input) {
+  return deserializeJson(doc, input, input != nullptr ? strlen(input) : 0);
+}
+
+inline DeserializationError deserializeJson(JsonDocument &doc,
+                                            const String &input) {
+  return deserializeJson(doc, input.c_str(), input.length());
+}
+
+inline DeserializationError deserializeMsgPack(JsonDocument &doc,
+                                               const char *input,
+                                               size_t length) {
+  return json::deserialize<json::MsgPackParser>(doc, input, length);
+}
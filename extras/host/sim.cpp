@@ -0,0 +1,876 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Simulation of the board and the network for the host build.
+ *
+ */
+#include "sim.hpp"
+
+#include <ArduinoJson.h>
+#include <ESP8266HTTPClient.h>
+#include <ESP8266WiFi.h>
+#include <ESP_EEPROM.h>
+#include <U8g2lib.h>
+#include <WiFiUdp.h>
+
+#include <chrono>
+#include <deque>
+#include <new>
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+EEPROMClass EEPROM;
+
+const uint8_t u8g2_font_crox3tb_tf[1] = {3};
+const uint8_t u8g2_font_crox4tb_tf[1] = {4};
+
+namespace {
+
+// Clock.
+uint64_t virtualTime = 0;
+unsigned long yieldTime = 100;
+bool realtime = false;
+std::chrono::steady_clock::time_point realStart;
+
+// Local clock (millis and micros): offset with the simulated time when the
+// skew was last set, and its rate error since.
+double clockSkew = 0;
+uint64_t skewFrom = 0;
+int64_t skewOffset = 0;
+
+// Random numbers (xorshift).
+uint64_t rng = 88172645463325252ULL;
+
+// Heap.
+unsigned long allocationCount = 0;
+unsigned long long allocationBytes = 0;
+int untracked = 0;
+
+// Pins.
+int levels[32];
+void (*isrs[32])(void *) = {};
+void *isrArgs[32] = {};
+bool pinsInitialized = false;
+
+// Network.
+unsigned long dnsLatency = 0;
+bool dnsDown = false;
+unsigned long lookups = 0;
+
+bool wifiDown = false;
+bool radioOn = true;
+unsigned long wakeLatency = 200;
+uint64_t connectedAt = 0;
+uint64_t radioOnSince = 0;
+unsigned long long radioOnTotal = 0;
+unsigned long wakes = 0;
+
+std::vector<sim::HttpServer *> &httpServers() {
+  static std::vector<sim::HttpServer *> servers;
+  return servers;
+}
+
+std::vector<sim::UdpServer *> &udpServers() {
+  static std::vector<sim::UdpServer *> servers;
+  return servers;
+}
+
+std::map<std::string, uint32_t> &hosts() {
+  static std::map<std::string, uint32_t> hosts;
+  return hosts;
+}
+
+void track(size_t size) {
+  if (untracked == 0) {
+    allocationCount++;
+    allocationBytes += size;
+  }
+}
+
+void initPins() {
+  if (!pinsInitialized) {
+    for (int &level : levels) {
+      level = HIGH;
+    }
+    pinsInitialized = true;
+  }
+}
+
+std::string lower(std::string value) {
+  for (char &c : value) {
+    c = tolower(c);
+  }
+  return value;
+}
+
+bool parseUrl(const std::string &url, std::string &host, uint16_t &port,
+              std::string &path) {
+  if (url.compare(0, 7, "http://") != 0) {
+    return false;
+  }
+  size_t start = 7;
+  size_t slash = url.find('/', start);
+  std::string authority = url.substr(start, slash - start);
+  path = slash == std::string::npos ? "/" : url.substr(slash);
+  size_t colon = authority.find(':');
+  port = colon == std::string::npos ? 80 : atoi(authority.c_str() + colon + 1);
+  host = authority.substr(0, colon);
+  return true;
+}
+
+} // namespace
+
+// Heap accounting: the allocations of the tests and the library (which are
+// linked with --wrap, see CMakeLists.txt) and of operator new.
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  track(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  track(count * size);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  track(size);
+  return __real_realloc(pointer, size);
+}
+}
+
+void *operator new(size_t size) {
+  void *pointer = malloc(size > 0 ? size : 1);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *pointer) noexcept { free(pointer); }
+
+void operator delete[](void *pointer) noexcept { free(pointer); }
+
+void operator delete(void *pointer, size_t size) noexcept { free(pointer); }
+
+void operator delete[](void *pointer, size_t size) noexcept { free(pointer); }
+
+// Arduino core.
+
+unsigned long millis() { return (unsigned long)(sim::localTime() / 1000); }
+
+unsigned long micros() { return (unsigned long)sim::localTime(); }
+
+// Delays are timed by the local clock.
+void delay(unsigned long ms) {
+  sim::advance((uint64_t)(ms * 1000.0 / (1 + clockSkew)));
+}
+
+void delayMicroseconds(unsigned int us) {
+  sim::advance((uint64_t)(us / (1 + clockSkew)));
+}
+
+void yield() { sim::advance(yieldTime); }
+
+long random(long max) {
+  if (max <= 0) {
+    return 0;
+  }
+  return (long)(sim::uniform() * max);
+}
+
+long random(long min, long max) {
+  if (max <= min) {
+    return min;
+  }
+  return min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) { sim::seed(seed); }
+
+int analogRead(uint8_t pin) { return random(1024); }
+
+int digitalRead(uint8_t pin) {
+  initPins();
+  return levels[pin % 32];
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) { sim::setPin(pin, value); }
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode) {
+  attachInterruptArg(pin, (void (*)(void *))fn, nullptr, mode);
+}
+
+void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg,
+                        int mode) {
+  isrs[pin % 32] = fn;
+  isrArgs[pin % 32] = arg;
+}
+
+void detachInterrupt(uint8_t pin) { isrs[pin % 32] = nullptr; }
+
+namespace sim {
+
+uint64_t now() {
+  if (!realtime) {
+    return virtualTime;
+  }
+  auto elapsed = std::chrono::steady_clock::now() - realStart;
+  return virtualTime +
+         std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+             .count();
+}
+
+void advance(uint64_t us) { virtualTime += us; }
+
+void setTime(uint64_t us) {
+  virtualTime = us;
+  realStart = std::chrono::steady_clock::now();
+  skewFrom = us;
+  skewOffset = 0;
+}
+
+uint64_t localTime() {
+  uint64_t at = now();
+  return at + skewOffset + (int64_t)((int64_t)(at - skewFrom) * clockSkew);
+}
+
+void setClockSkew(double value) {
+  uint64_t at = now();
+  skewOffset = (int64_t)(localTime() - at);
+  skewFrom = at;
+  clockSkew = value;
+}
+
+void setYield(unsigned long us) { yieldTime = us; }
+
+void setRealtime(bool value) {
+  if (value == realtime) {
+    return;
+  }
+  virtualTime = now();
+  realtime = value;
+  realStart = std::chrono::steady_clock::now();
+}
+
+void seed(unsigned long value) {
+  rng = 88172645463325252ULL ^ ((uint64_t)value * 0x9E3779B97F4A7C15ULL);
+  if (rng == 0) {
+    rng = 1;
+  }
+}
+
+double uniform() {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+unsigned long allocations() { return allocationCount; }
+
+unsigned long long allocatedBytes() { return allocationBytes; }
+
+Untracked::Untracked() { untracked++; }
+
+Untracked::~Untracked() { untracked--; }
+
+void setPin(uint8_t pin, int level) {
+  initPins();
+  pin %= 32;
+  if (levels[pin] == level) {
+    return;
+  }
+  levels[pin] = level;
+  if (isrs[pin] != nullptr) {
+    isrs[pin](isrArgs[pin]);
+  }
+}
+
+void setSerial(bool value) { Serial.enable(value); }
+
+unsigned long Link::delay() const {
+  return this->latency +
+         (this->jitter > 0 ? (unsigned long)random(this->jitter + 1) : 0);
+}
+
+bool Link::lost() const { return this->loss > 0 && uniform() < this->loss; }
+
+void setDnsLatency(unsigned long ms) { dnsLatency = ms; }
+
+void setDnsDown(bool value) { dnsDown = value; }
+
+unsigned long dnsLookups() { return lookups; }
+
+uint32_t address(const char *host) {
+  Untracked guard;
+  auto found = hosts().find(host);
+  if (found != hosts().end()) {
+    return found->second;
+  }
+  uint32_t ip =
+      IPAddress(10, 0, hosts().size() / 250, hosts().size() % 250 + 1);
+  hosts()[host] = ip;
+  return ip;
+}
+
+bool resolve(const char *host, uint32_t &ip) {
+  lookups++;
+  advanceMs(dnsLatency);
+  if (dnsDown || !isWifiConnected()) {
+    return false;
+  }
+  for (HttpServer *server : httpServers()) {
+    if (strcmp(server->host, host) == 0) {
+      ip = address(host);
+      return true;
+    }
+  }
+  for (UdpServer *server : udpServers()) {
+    if (strcmp(server->host, host) == 0) {
+      ip = address(host);
+      return true;
+    }
+  }
+  return false;
+}
+
+void setWifiDown(bool value) { wifiDown = value; }
+
+void setWakeLatency(unsigned long ms) { wakeLatency = ms; }
+
+unsigned long long radioOnMs() {
+  return (radioOnTotal + (radioOn ? now() - radioOnSince : 0)) / 1000;
+}
+
+unsigned long radioWakes() { return wakes; }
+
+bool isRadioOn() { return radioOn; }
+
+bool isWifiConnected() { return radioOn && !wifiDown && now() >= connectedAt; }
+
+std::string HttpRequest::header(const char *name) const {
+  Untracked guard;
+  auto found = this->headers.find(lower(name));
+  return found == this->headers.end() ? std::string() : found->second;
+}
+
+HttpServer::HttpServer(const char *host, uint16_t port)
+    : host(host), port(port) {
+  httpServers().push_back(this);
+}
+
+HttpServer::~HttpServer() {
+  auto &servers = httpServers();
+  for (size_t n = 0; n < servers.size(); n++) {
+    if (servers[n] == this) {
+      servers.erase(servers.begin() + n);
+      break;
+    }
+  }
+}
+
+HttpResponse HttpServer::handle(const HttpRequest &request) {
+  this->received++;
+  if (this->log) {
+    this->requests.push_back(request);
+  }
+  if (!this->handler) {
+    HttpResponse response;
+    response.body = "{}";
+    return response;
+  }
+  return this->handler(request);
+}
+
+HttpServer *findHttp(uint32_t ip, uint16_t port) {
+  for (HttpServer *server : httpServers()) {
+    if (address(server->host) == ip && server->port == port) {
+      return server;
+    }
+  }
+  return nullptr;
+}
+
+HttpServer *findHttp(const char *host) {
+  for (HttpServer *server : httpServers()) {
+    if (strcmp(server->host, host) == 0) {
+      return server;
+    }
+  }
+  return nullptr;
+}
+
+UdpServer::UdpServer(const char *host, uint16_t port)
+    : host(host), port(port) {
+  udpServers().push_back(this);
+}
+
+UdpServer::~UdpServer() {
+  auto &servers = udpServers();
+  for (size_t n = 0; n < servers.size(); n++) {
+    if (servers[n] == this) {
+      servers.erase(servers.begin() + n);
+      break;
+    }
+  }
+}
+
+UdpServer *findUdp(uint32_t ip, uint16_t port) {
+  for (UdpServer *server : udpServers()) {
+    if (address(server->host) == ip && server->port == port) {
+      return server;
+    }
+  }
+  return nullptr;
+}
+
+// Write a time (ms since Jan. 1, 1970) as a 64 bit NTP timestamp.
+static void writeNtpTime(uint8_t *buffer, unsigned long long epochMs) {
+  unsigned long long ms = epochMs + 2208988800ULL * 1000;
+  uint32_t seconds = ms / 1000;
+  uint32_t fraction = (uint32_t)(((ms % 1000) << 32) / 1000);
+  for (int n = 0; n < 4; n++) {
+    buffer[n] = seconds >> (24 - 8 * n);
+    buffer[4 + n] = fraction >> (24 - 8 * n);
+  }
+}
+
+NtpServer::NtpServer(const char *host, long offset)
+    : UdpServer(host, 123), offset(offset) {
+  this->handler = [this](const std::vector<uint8_t> &request, uint64_t at) {
+    std::vector<uint8_t> answer(48, 0);
+    if (request.size() < 48) {
+      return std::vector<uint8_t>();
+    }
+    answer[0] = 0x24; // No leap, version 4, server.
+    answer[1] = this->stratum;
+    // The originate timestamp echoes the transmit one of the request.
+    memcpy(&answer[24], &request[40], 8);
+    unsigned long long time = epochMs(at) + this->offset;
+    writeNtpTime(&answer[32], time);
+    writeNtpTime(&answer[40], time);
+    return answer;
+  };
+}
+
+// State of a TCP connection to a HttpServer.
+struct Connection {
+  HttpServer *server = nullptr;
+  bool open = false;
+  std::string input;  // Request bytes not handled yet.
+  std::string output; // Response bytes.
+  size_t read = 0;
+  uint64_t readyAt = 0; // In us, when the response arrives.
+  bool close = false;
+
+  // Handle the complete requests in the input.
+  void process() {
+    while (this->open) {
+      size_t end = this->input.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        return;
+      }
+      HttpRequest request;
+      std::string head = this->input.substr(0, end);
+      size_t line = head.find("\r\n");
+      std::string first = head.substr(0, line);
+      size_t space = first.find(' ');
+      request.method = first.substr(0, space);
+      request.path = first.substr(space + 1, first.rfind(' ') - space - 1);
+      while (line != std::string::npos) {
+        size_t next = head.find("\r\n", line + 2);
+        std::string header = head.substr(line + 2, next - line - 2);
+        size_t colon = header.find(':');
+        if (colon != std::string::npos) {
+          size_t value = header.find_first_not_of(' ', colon + 1);
+          request.headers[lower(header.substr(0, colon))] =
+              value == std::string::npos ? "" : header.substr(value);
+        }
+        line = next;
+      }
+      size_t length = atol(request.header("content-length").c_str());
+      if (this->input.size() < end + 4 + length) {
+        return;
+      }
+      request.body = this->input.substr(end + 4, length);
+      request.size = end + 4 + length;
+      this->input.erase(0, request.size);
+
+      if (this->server->link.lost()) {
+        this->server->dropped++;
+        this->open = false;
+        return;
+      }
+      unsigned long up = this->server->link.delay();
+      unsigned long down = this->server->link.delay();
+      request.at = now() + (uint64_t)up * 1000;
+      HttpResponse response = this->server->handle(request);
+
+      char status[96];
+      snprintf(status, sizeof(status),
+               "HTTP/1.1 %d Status\r\nContent-Length: %u\r\n",
+               response.status, (unsigned int)response.body.size());
+      this->output.erase(0, this->read);
+      this->read = 0;
+      this->output += status;
+      this->output += response.headers;
+      if (response.close) {
+        this->output += "Connection: close\r\n";
+      }
+      this->output += "\r\n";
+      this->output += response.body;
+      this->readyAt = now() + (uint64_t)(up + down) * 1000;
+      this->close = response.close;
+    }
+  }
+
+  size_t available() const {
+    return now() >= this->readyAt ? this->output.size() - this->read : 0;
+  }
+};
+
+// State of a UDP socket.
+struct Packet {
+  std::vector<uint8_t> data;
+  uint64_t at; // In us, when it arrives.
+};
+
+struct Socket {
+  std::deque<Packet> inbox;
+  std::vector<uint8_t> outgoing;
+  uint32_t ip = 0;
+  uint16_t port = 0;
+  bool sending = false;
+  Packet current;
+  size_t read = 0;
+};
+
+} // namespace sim
+
+// WiFi.
+
+void WiFiClass::begin(const char *ssid, const char *passphrase) {
+  connectedAt = sim::now() + (uint64_t)wakeLatency * 1000;
+}
+
+void WiFiClass::disconnect() { connectedAt = UINT64_MAX; }
+
+int WiFiClass::status() {
+  return sim::isWifiConnected() ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+uint8_t *WiFiClass::macAddress(uint8_t *mac) {
+  const uint8_t value[6] = {0x5C, 0xCF, 0x7F, 0x00, 0x00, 0x01};
+  memcpy(mac, value, sizeof(value));
+  return mac;
+}
+
+String WiFiClass::macAddress() { return String("5C:CF:7F:00:00:01"); }
+
+int WiFiClass::hostByName(const char *host, IPAddress &ip) {
+  uint32_t address;
+  if (!sim::resolve(host, address)) {
+    return 0;
+  }
+  ip = IPAddress(address);
+  return 1;
+}
+
+void WiFiClass::forceSleepBegin() {
+  if (!radioOn) {
+    return;
+  }
+  radioOnTotal += sim::now() - radioOnSince;
+  radioOn = false;
+}
+
+void WiFiClass::forceSleepWake() {
+  if (radioOn) {
+    return;
+  }
+  radioOn = true;
+  radioOnSince = sim::now();
+  connectedAt = sim::now() + (uint64_t)wakeLatency * 1000;
+  wakes++;
+}
+
+// TCP.
+
+WiFiClient::~WiFiClient() {
+  sim::Untracked guard;
+  delete this->_connection;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  sim::Untracked guard;
+  if (this->_connection == nullptr) {
+    this->_connection = new sim::Connection();
+  }
+  sim::Connection &connection = *this->_connection;
+  connection.open = false;
+  connection.input.clear();
+  connection.output.clear();
+  connection.read = 0;
+  connection.close = false;
+  if (!sim::isWifiConnected()) {
+    return 0;
+  }
+  sim::HttpServer *server = sim::findHttp(ip, port);
+  if (server == nullptr || server->down) {
+    // Refused after a round trip.
+    sim::advanceMs(server != nullptr ? 2 * server->link.latency : 0);
+    return 0;
+  }
+  if (server->unreachable) {
+    // No answer to the handshake.
+    sim::advanceMs(this->_timeout);
+    return 0;
+  }
+  sim::advanceMs(server->link.delay() + server->link.delay());
+  server->connections++;
+  connection.server = server;
+  connection.open = true;
+  return 1;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return 0;
+  }
+  return this->connect(ip, port);
+}
+
+uint8_t WiFiClient::connected() {
+  if (this->_connection == nullptr) {
+    return 0;
+  }
+  if (this->_connection->open &&
+      (!sim::isWifiConnected() || this->_connection->server->down ||
+       this->_connection->server->unreachable)) {
+    this->_connection->open = false;
+  }
+  return this->_connection->open || this->_connection->available() > 0;
+}
+
+int WiFiClient::available() {
+  return this->_connection != nullptr ? this->_connection->available() : 0;
+}
+
+size_t WiFiClient::availableForWrite() {
+  return this->_connection != nullptr && this->_connection->open ? 1460 : 0;
+}
+
+int WiFiClient::read() {
+  uint8_t value;
+  return this->read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+  if (this->_connection == nullptr) {
+    return -1;
+  }
+  sim::Connection &connection = *this->_connection;
+  size_t available = connection.available();
+  if (available == 0) {
+    return -1;
+  }
+  size = size < available ? size : available;
+  memcpy(buffer, connection.output.data() + connection.read, size);
+  connection.read += size;
+  if (connection.close && connection.available() == 0) {
+    connection.open = false;
+  }
+  return size;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  sim::Untracked guard;
+  if (this->_connection == nullptr || !this->connected()) {
+    return 0;
+  }
+  this->_connection->input.append((const char *)buffer, size);
+  this->_connection->process();
+  return size;
+}
+
+void WiFiClient::stop() {
+  if (this->_connection != nullptr) {
+    this->_connection->open = false;
+    this->_connection->read = this->_connection->output.size();
+  }
+}
+
+// HTTPClient.
+
+bool HTTPClient::begin(const String &url) {
+  sim::Untracked guard;
+  return parseUrl(url.c_str(), this->_host, this->_port, this->_path);
+}
+
+int HTTPClient::_request(const char *method, const uint8_t *payload,
+                         size_t size) {
+  sim::Untracked guard;
+  this->_body.clear();
+  if (!sim::isWifiConnected()) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  sim::HttpServer *server = sim::findHttp(this->_host.c_str());
+  if (server == nullptr || server->down) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  unsigned long up = server->link.delay();
+  unsigned long down = server->link.delay();
+  if (server->link.lost() || up + down > this->_timeout) {
+    server->dropped++;
+    sim::advanceMs(this->_timeout);
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  sim::HttpRequest request;
+  request.method = method;
+  request.path = this->_path;
+  if (payload != nullptr) {
+    request.body.assign((const char *)payload, size);
+  }
+  request.size = this->_path.size() + size + 64;
+  sim::advanceMs(up);
+  request.at = sim::now();
+  sim::HttpResponse response = server->handle(request);
+  sim::advanceMs(down);
+  this->_body = response.body;
+  return response.status;
+}
+
+// UDP.
+
+WiFiUDP::~WiFiUDP() {
+  sim::Untracked guard;
+  delete this->_socket;
+}
+
+sim::Socket *WiFiUDP::_open() {
+  sim::Untracked guard;
+  if (this->_socket == nullptr) {
+    this->_socket = new sim::Socket();
+  }
+  return this->_socket;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+  this->_open();
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (this->_socket != nullptr) {
+    this->_socket->inbox.clear();
+  }
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+  uint32_t ip;
+  if (!sim::resolve(host, ip)) {
+    return 0;
+  }
+  return this->beginPacket(IPAddress(ip), port);
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  sim::Socket *socket = this->_open();
+  socket->outgoing.clear();
+  socket->ip = ip;
+  socket->port = port;
+  socket->sending = true;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+  sim::Untracked guard;
+  sim::Socket *socket = this->_open();
+  if (!socket->sending) {
+    return 0;
+  }
+  socket->outgoing.insert(socket->outgoing.end(), buffer, buffer + size);
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  sim::Untracked guard;
+  sim::Socket *socket = this->_open();
+  if (!socket->sending) {
+    return 0;
+  }
+  socket->sending = false;
+  if (!sim::isWifiConnected()) {
+    return 0;
+  }
+  sim::UdpServer *server = sim::findUdp(socket->ip, socket->port);
+  if (server == nullptr) {
+    return 1;
+  }
+  server->received++;
+  if (server->down || server->link.lost()) {
+    server->dropped++;
+    return 1;
+  }
+  unsigned long up = server->link.delay();
+  unsigned long down = server->link.delay();
+  uint64_t at = sim::now() + (uint64_t)up * 1000;
+  std::vector<uint8_t> answer = server->handler(socket->outgoing, at);
+  if (answer.empty()) {
+    return 1;
+  }
+  sim::Packet packet{answer, at + (uint64_t)down * 1000};
+  auto position = socket->inbox.begin();
+  while (position != socket->inbox.end() && position->at <= packet.at) {
+    position++;
+  }
+  socket->inbox.insert(position, packet);
+  return 1;
+}
+
+int WiFiUDP::parsePacket() {
+  sim::Untracked guard;
+  if (this->_socket == nullptr || this->_socket->inbox.empty() ||
+      this->_socket->inbox.front().at > sim::now()) {
+    return 0;
+  }
+  this->_socket->current = this->_socket->inbox.front();
+  this->_socket->inbox.pop_front();
+  this->_socket->read = 0;
+  return this->_socket->current.data.size();
+}
+
+int WiFiUDP::available() {
+  if (this->_socket == nullptr) {
+    return 0;
+  }
+  return this->_socket->current.data.size() - this->_socket->read;
+}
+
+int WiFiUDP::read() {
+  unsigned char value;
+  return this->read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiUDP::read(unsigned char *buffer, size_t size) {
+  int available = this->available();
+  if (available <= 0) {
+    return 0;
+  }
+  size = size < (size_t)available ? size : available;
+  memcpy(buffer, this->_socket->current.data.data() + this->_socket->read,
+         size);
+  this->_socket->read += size;
+  return size;
+}
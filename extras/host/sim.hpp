@@ -0,0 +1,216 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Simulation of the board and the network for the host build.
+ *
+ * - Time: millis and micros follow a simulated clock that only moves with
+ *   advance, delay, yield and the blocking network calls. With setRealtime,
+ *   the real elapsed time is added, to measure the CPU time of the code.
+ *   The local clock can run fast or slow (see setClockSkew).
+ * - Network: servers are registered by host name and answer after their
+ *   link latency, with jitter and loss (see Link). The WiFi station can be
+ *   taken down, and the radio on time is accounted.
+ * - Heap: every allocation (operator new, malloc, realloc) is counted.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// True time of the simulation at its start (ms since Jan. 1, 1970).
+#define SIM_EPOCH_MS 1700000000000ULL
+
+namespace sim {
+
+// Clock.
+
+// Simulated time (in us) since the start.
+uint64_t now();
+
+// Move the clock forward.
+void advance(uint64_t us);
+
+inline void advanceMs(unsigned long ms) { advance((uint64_t)ms * 1000); }
+
+// Set the clock, e.g. close to a wrap of millis().
+void setTime(uint64_t us);
+
+// Local time (in us) read by millis() and micros().
+uint64_t localTime();
+
+// Rate error of the local clock from now on, e.g. 1e-4 runs 100 ppm fast.
+// Servers and epochMs keep the simulated (true) time.
+void setClockSkew(double value);
+
+// Time (in us) that each yield takes.
+void setYield(unsigned long us);
+
+// Add the real elapsed time to the clock, to measure CPU time.
+void setRealtime(bool value);
+
+// True time (in ms since Jan. 1, 1970) at a simulated time.
+inline unsigned long long epochMs(uint64_t at) {
+  return SIM_EPOCH_MS + at / 1000;
+}
+
+inline unsigned long long epochMs() { return epochMs(now()); }
+
+// Random numbers, the same sequence for the same seed.
+void seed(unsigned long value);
+double uniform();
+
+// Heap.
+
+// Allocations so far, and bytes requested.
+unsigned long allocations();
+unsigned long long allocatedBytes();
+
+// Allocations made in its scope are not counted (used by the stand-ins).
+class Untracked {
+public:
+  Untracked();
+  ~Untracked();
+};
+
+// Board.
+
+// Level of a pin, calling its interrupt handler on a change.
+void setPin(uint8_t pin, int level);
+
+// Print what is written to Serial.
+void setSerial(bool value);
+
+// Network.
+
+/**
+ * Conditions of the path to a server.
+ */
+struct Link {
+  unsigned long latency = 10; // In ms, one way
+  unsigned long jitter = 0;   // In ms, up to, added to each way
+  double loss = 0;            // Probability to lose a request
+
+  // Time (in ms) taken by one way.
+  unsigned long delay() const;
+
+  // true if a request is lost.
+  bool lost() const;
+};
+
+// Time (in ms) taken by each DNS lookup, and whether they fail.
+void setDnsLatency(unsigned long ms);
+void setDnsDown(bool value);
+unsigned long dnsLookups();
+
+// Resolve a registered host name (without cost).
+uint32_t address(const char *host);
+
+// The access point cannot be reached.
+void setWifiDown(bool value);
+
+// Time (in ms) to reconnect once the radio is woken up.
+void setWakeLatency(unsigned long ms);
+
+// Time (in ms) the radio has been on, and times it was woken up.
+unsigned long long radioOnMs();
+unsigned long radioWakes();
+bool isRadioOn();
+
+struct HttpRequest {
+  std::string method;
+  std::string path;
+  std::map<std::string, std::string> headers; // Names in lower case
+  std::string body;
+  size_t size = 0; // On the wire
+  uint64_t at = 0; // In us, when the server got it
+
+  // Value of a header, empty if missing.
+  std::string header(const char *name) const;
+};
+
+struct HttpResponse {
+  int status = 200;
+  std::string body;
+  std::string headers; // Extra lines ("Name: value\r\n")
+  bool close = false;  // Close the connection after the response
+};
+
+typedef std::function<HttpResponse(const HttpRequest &)> HttpHandler;
+
+/**
+ * HTTP server answering on a host name and port.
+ */
+class HttpServer {
+
+public:
+  const char *host;
+  uint16_t port;
+  Link link;
+  bool down = false;        // Drop and refuse connections
+  bool unreachable = false; // Drop connections, handshakes time out
+  bool log = true;   // Keep the requests
+  HttpHandler handler;
+
+  std::vector<HttpRequest> requests;
+  unsigned long received = 0;
+  unsigned long connections = 0;
+  unsigned long dropped = 0;
+
+  HttpServer(const char *host, uint16_t port = 80);
+  ~HttpServer();
+
+  void onRequest(HttpHandler fn) { this->handler = fn; }
+
+  HttpResponse handle(const HttpRequest &request);
+};
+
+typedef std::function<std::vector<uint8_t>(const std::vector<uint8_t> &,
+                                           uint64_t at)>
+    UdpHandler;
+
+/**
+ * UDP server answering on a host name and port.
+ */
+class UdpServer {
+
+public:
+  const char *host;
+  uint16_t port;
+  Link link;
+  bool down = false;
+  UdpHandler handler;
+
+  unsigned long received = 0;
+  unsigned long dropped = 0;
+
+  UdpServer(const char *host, uint16_t port);
+  virtual ~UdpServer();
+};
+
+/**
+ * NTP server with the true time plus an offset (in ms).
+ */
+class NtpServer : public UdpServer {
+
+public:
+  long offset;
+  uint8_t stratum = 2;
+
+  NtpServer(const char *host, long offset = 0);
+};
+
+// Used by the stand-ins.
+HttpServer *findHttp(uint32_t ip, uint16_t port);
+HttpServer *findHttp(const char *host);
+UdpServer *findUdp(uint32_t ip, uint16_t port);
+bool resolve(const char *host, uint32_t &ip);
+bool isWifiConnected();
+
+} // namespace sim
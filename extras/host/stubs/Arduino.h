@@ -0,0 +1,187 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the Arduino core in the host build.
+ *
+ * Time is simulated (see sim.hpp): delay and yield advance it instead of
+ * waiting, so tests are fast and repeatable.
+ *
+ */
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+
+typedef uint8_t byte;
+typedef unsigned int uint;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define RISING 2
+#define FALLING 3
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+#define DEC 10
+#define HEX 16
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+int analogRead(uint8_t pin);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void pinMode(uint8_t pin, uint8_t mode);
+
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+inline uint16_t word(uint8_t high, uint8_t low) { return high << 8 | low; }
+
+/**
+ * Arduino String over std::string.
+ */
+class String {
+
+private:
+  std::string _value;
+
+public:
+  String() {}
+  String(const char *value) : _value(value != nullptr ? value : "") {}
+  String(const std::string &value) : _value(value) {}
+  String(char value) : _value(1, value) {}
+  String(int value, unsigned char base = DEC) : String((long)value, base) {}
+  String(unsigned int value, unsigned char base = DEC)
+      : String((unsigned long)value, base) {}
+  String(long value, unsigned char base = DEC) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), base == HEX ? "%lx" : "%ld", value);
+    this->_value = buffer;
+  }
+  String(unsigned long value, unsigned char base = DEC) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), base == HEX ? "%lx" : "%lu", value);
+    this->_value = buffer;
+  }
+  String(double value, unsigned char decimals = 2) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    this->_value = buffer;
+  }
+
+  const char *c_str() const { return this->_value.c_str(); }
+  unsigned int length() const { return this->_value.size(); }
+  bool reserve(unsigned int size) {
+    this->_value.reserve(size);
+    return true;
+  }
+
+  String &operator+=(const String &other) {
+    this->_value += other._value;
+    return *this;
+  }
+  String &operator+=(const char *other) {
+    this->_value += other;
+    return *this;
+  }
+  String &operator+=(char other) {
+    this->_value += other;
+    return *this;
+  }
+
+  bool operator==(const String &other) const {
+    return this->_value == other._value;
+  }
+  bool operator==(const char *other) const { return this->_value == other; }
+  bool operator!=(const String &other) const { return !(*this == other); }
+
+  char operator[](unsigned int index) const { return this->_value[index]; }
+
+  long toInt() const { return atol(this->_value.c_str()); }
+  double toDouble() const { return atof(this->_value.c_str()); }
+  int indexOf(char c) const {
+    size_t index = this->_value.find(c);
+    return index == std::string::npos ? -1 : (int)index;
+  }
+  String substring(unsigned int from) const {
+    return this->_value.substr(from);
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    return this->_value.substr(from, to - from);
+  }
+
+  friend String operator+(const String &a, const String &b) {
+    return a._value + b._value;
+  }
+};
+
+inline String operator+(const char *a, const String &b) {
+  return String(a) + b;
+}
+
+/**
+ * Serial port, printing to stdout when enabled (see sim::setSerial).
+ */
+class HardwareSerial {
+
+private:
+  bool _enabled = false;
+
+public:
+  void begin(unsigned long baud) {}
+  void enable(bool value) { this->_enabled = value; }
+
+  size_t print(const char *value) {
+    return this->_enabled ? printf("%s", value) : 0;
+  }
+  size_t print(const String &value) { return this->print(value.c_str()); }
+  size_t print(char value) { return this->_enabled ? printf("%c", value) : 0; }
+  size_t print(int value) { return this->_enabled ? printf("%d", value) : 0; }
+  size_t print(unsigned int value) {
+    return this->_enabled ? printf("%u", value) : 0;
+  }
+  size_t print(long value) {
+    return this->_enabled ? printf("%ld", value) : 0;
+  }
+  size_t print(unsigned long value) {
+    return this->_enabled ? printf("%lu", value) : 0;
+  }
+  size_t print(double value) {
+    return this->_enabled ? printf("%.2f", value) : 0;
+  }
+  template <typename T> size_t println(T value) {
+    return this->print(value) + this->println();
+  }
+  size_t println() { return this->print("\n"); }
+};
+
+extern HardwareSerial Serial;
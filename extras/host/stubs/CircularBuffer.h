@@ -0,0 +1,76 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the CircularBuffer library in the host build.
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+
+template <typename T, size_t S, typename IT = size_t> class CircularBuffer {
+
+private:
+  T _items[S];
+  IT _head = 0;
+  IT _count = 0;
+
+public:
+  static constexpr IT capacity = S;
+
+  // Add at the end, overwriting the first element when full.
+  // return false if an element was overwritten.
+  bool push(T value) {
+    this->_items[(this->_head + this->_count) % S] = value;
+    if (this->_count == S) {
+      this->_head = (this->_head + 1) % S;
+      return false;
+    }
+    this->_count++;
+    return true;
+  }
+
+  // Add at the beginning, overwriting the last element when full.
+  bool unshift(T value) {
+    this->_head = (this->_head + S - 1) % S;
+    this->_items[this->_head] = value;
+    if (this->_count == S) {
+      return false;
+    }
+    this->_count++;
+    return true;
+  }
+
+  T shift() {
+    T value = this->_items[this->_head];
+    this->_head = (this->_head + 1) % S;
+    this->_count--;
+    return value;
+  }
+
+  T pop() {
+    this->_count--;
+    return this->_items[(this->_head + this->_count) % S];
+  }
+
+  T first() const { return this->_items[this->_head]; }
+
+  T last() const { return this->_items[(this->_head + this->_count - 1) % S]; }
+
+  T operator[](IT index) const {
+    return this->_items[(this->_head + index) % S];
+  }
+
+  IT size() const { return this->_count; }
+
+  IT available() const { return S - this->_count; }
+
+  bool isEmpty() const { return this->_count == 0; }
+
+  bool isFull() const { return this->_count == S; }
+
+  void clear() {
+    this->_head = 0;
+    this->_count = 0;
+  }
+};
@@ -0,0 +1,58 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the ESP8266 HTTPClient in the host build.
+ *
+ * Requests are blocking, as with the real one: the simulated clock moves
+ * by the round trip of the server (see sim::HttpServer), or by the timeout
+ * if the answer does not arrive in time.
+ *
+ */
+#pragma once
+
+#include <ESP8266WiFi.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient {
+
+private:
+  std::string _host;
+  std::string _path;
+  uint16_t _port = 80;
+  uint16_t _timeout = 5000; // In ms
+  std::string _body;
+
+  int _request(const char *method, const uint8_t *payload, size_t size);
+
+public:
+  bool begin(WiFiClient &client, const String &url) {
+    return this->begin(url);
+  }
+  bool begin(WiFiClient &client, const char *url) {
+    return this->begin(String(url));
+  }
+  bool begin(const String &url);
+  void end() {}
+  void setReuse(bool value) {}
+  void setTimeout(uint16_t timeout) { this->_timeout = timeout; }
+  bool connected() { return true; }
+  void addHeader(const String &name, const String &value, bool first = false,
+                 bool replace = true) {}
+
+  int GET() { return this->_request("GET", nullptr, 0); }
+  int POST(const uint8_t *payload, size_t size) {
+    return this->_request("POST", payload, size);
+  }
+  int POST(const String &payload) {
+    return this->POST((const uint8_t *)payload.c_str(), payload.length());
+  }
+
+  String getString() { return String(this->_body); }
+  int getSize() { return this->_body.size(); }
+};
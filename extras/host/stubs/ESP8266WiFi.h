@@ -0,0 +1,106 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the ESP8266 WiFi library in the host build.
+ *
+ * The station and the TCP connections are simulated (see sim.hpp): a
+ * WiFiClient talks to the sim::HttpServer registered for the address.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+
+#define WL_IDLE_STATUS 0
+#define WL_NO_SSID_AVAIL 1
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+
+enum WiFiSleepType_t {
+  WIFI_NONE_SLEEP = 0,
+  WIFI_LIGHT_SLEEP = 1,
+  WIFI_MODEM_SLEEP = 2
+};
+
+namespace sim {
+struct Connection;
+} // namespace sim
+
+class IPAddress {
+
+private:
+  uint32_t _address = 0;
+
+public:
+  IPAddress() {}
+  IPAddress(uint32_t address) : _address(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : _address((uint32_t)a << 24 | (uint32_t)b << 16 | (uint32_t)c << 8 |
+                 d) {}
+
+  bool isSet() const { return this->_address != 0; }
+  operator uint32_t() const { return this->_address; }
+  bool operator==(const IPAddress &other) const {
+    return this->_address == other._address;
+  }
+};
+
+class WiFiClient {
+
+private:
+  sim::Connection *_connection = nullptr;
+  unsigned long _timeout = 1000; // In ms, as Stream.
+
+public:
+  WiFiClient() {}
+  WiFiClient(const WiFiClient &) = delete;
+  WiFiClient &operator=(const WiFiClient &) = delete;
+  virtual ~WiFiClient();
+
+  // Blocks for a round trip, as the handshake does, or for the timeout
+  // if the server does not answer (see HttpServer::unreachable).
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char *host, uint16_t port);
+
+  uint8_t connected();
+  int available();
+  size_t availableForWrite();
+  int read();
+  int read(uint8_t *buffer, size_t size);
+  size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *value) {
+    return this->write((const uint8_t *)value, strlen(value));
+  }
+  size_t print(const char *value) { return this->write(value); }
+  size_t print(const String &value) { return this->write(value.c_str()); }
+  void stop();
+  void setTimeout(unsigned long timeout) { this->_timeout = timeout; }
+  void setNoDelay(bool value) {}
+  operator bool() { return this->connected(); }
+};
+
+class WiFiClass {
+
+public:
+  void persistent(bool value) {}
+  void mode(int value) {}
+  void begin(const char *ssid, const char *passphrase);
+  void disconnect();
+  void setAutoReconnect(bool value) {}
+  bool setSleepMode(WiFiSleepType_t type) { return true; }
+  int status();
+  uint8_t *macAddress(uint8_t *mac);
+  String macAddress();
+  int RSSI() { return -60; }
+
+  // Blocks for the DNS latency (see sim::setDnsLatency).
+  int hostByName(const char *host, IPAddress &ip);
+
+  void forceSleepBegin();
+  void forceSleepWake();
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,64 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the ESP_EEPROM library in the host build. The content is
+ * kept in memory, and survives a new begin as it does on a board.
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EEPROM_SIZE 4096
+
+class EEPROMClass {
+
+private:
+  uint8_t _data[EEPROM_SIZE];
+  size_t _size = 0;
+  unsigned long _commits = 0;
+
+public:
+  EEPROMClass() { memset(this->_data, 0xFF, sizeof(this->_data)); }
+
+  void begin(size_t size) {
+    this->_size = size < EEPROM_SIZE ? size : EEPROM_SIZE;
+  }
+
+  uint8_t read(int address) const { return this->_data[address]; }
+
+  void write(int address, uint8_t value) { this->_data[address] = value; }
+
+  template <typename T> T &get(int address, T &value) {
+    memcpy((void *)&value, &this->_data[address], sizeof(T));
+    return value;
+  }
+
+  template <typename T> const T &put(int address, const T &value) {
+    memcpy(&this->_data[address], (const void *)&value, sizeof(T));
+    return value;
+  }
+
+  bool commit() {
+    this->_commits++;
+    return true;
+  }
+
+  bool wipe() {
+    memset(this->_data, 0xFF, sizeof(this->_data));
+    return true;
+  }
+
+  void end() {}
+
+  size_t length() const { return this->_size; }
+
+  uint8_t *getDataPtr() { return this->_data; }
+
+  // Number of commits, to count the writes to flash.
+  unsigned long getCommits() const { return this->_commits; }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,129 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for U8g2 in the host build: a 128x64 frame buffer in pages, as
+ * the SH1106 full buffer mode. Glyphs are 8 pixels wide blocks with a
+ * pattern given by the character, which is enough to see what changed.
+ * The bytes pushed to the display are counted (see getBusBytes).
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define U8X8_PIN_NONE 255
+
+#define U8G2_WIDTH 128
+#define U8G2_HEIGHT 64
+#define U8G2_GLYPH_WIDTH 8
+
+typedef const uint8_t *u8g2_cb_t;
+#define U8G2_R0 nullptr
+
+extern const uint8_t u8g2_font_crox3tb_tf[];
+extern const uint8_t u8g2_font_crox4tb_tf[];
+
+class U8G2 {
+
+private:
+  uint8_t _buffer[U8G2_WIDTH * U8G2_HEIGHT / 8];
+  uint8_t _color = 1;
+  uint8_t _height = 12; // Of the glyphs, in pixels
+  unsigned long _busBytes = 0;
+  unsigned long _rowBytes[U8G2_HEIGHT / 8] = {};
+  unsigned long _transfers = 0;
+
+  void _pixel(int x, int y, bool on) {
+    if (x < 0 || x >= U8G2_WIDTH || y < 0 || y >= U8G2_HEIGHT) {
+      return;
+    }
+    uint8_t &page = this->_buffer[(y / 8) * U8G2_WIDTH + x];
+    if (on) {
+      page |= 1 << (y % 8);
+    } else {
+      page &= ~(1 << (y % 8));
+    }
+  }
+
+public:
+  U8G2() { this->clearBuffer(); }
+
+  void begin() {}
+
+  void clearBuffer() { memset(this->_buffer, 0, sizeof(this->_buffer)); }
+
+  void sendBuffer() {
+    this->_busBytes += sizeof(this->_buffer);
+    for (uint8_t row = 0; row < U8G2_HEIGHT / 8; row++) {
+      this->_rowBytes[row] += U8G2_WIDTH;
+    }
+    this->_transfers++;
+  }
+
+  // Push a rectangle of tiles (8x8 pixels) to the display.
+  void updateDisplayArea(uint8_t tx, uint8_t ty, uint8_t tw, uint8_t th) {
+    this->_busBytes += (unsigned long)tw * th * 8;
+    for (uint8_t row = ty; row < ty + th && row < U8G2_HEIGHT / 8; row++) {
+      this->_rowBytes[row] += (unsigned long)tw * 8;
+    }
+    this->_transfers++;
+  }
+
+  void updateDisplay() { this->sendBuffer(); }
+
+  void setFont(const uint8_t *font) {
+    this->_height = font == u8g2_font_crox4tb_tf ? 16 : 12;
+  }
+
+  void setDrawColor(uint8_t color) { this->_color = color; }
+
+  int getStrWidth(const char *value) {
+    return (int)strlen(value) * U8G2_GLYPH_WIDTH;
+  }
+
+  // Draw a string with its baseline at y.
+  int drawStr(int x, int y, const char *value) {
+    for (size_t n = 0; value[n] != 0; n++) {
+      uint8_t c = value[n];
+      for (int column = 0; column < U8G2_GLYPH_WIDTH - 1; column++) {
+        for (int row = 0; row < this->_height; row++) {
+          if ((c >> ((column + row) % 8)) & 1) {
+            this->_pixel(x + (int)n * U8G2_GLYPH_WIDTH + column,
+                         y - this->_height + row, this->_color);
+          }
+        }
+      }
+    }
+    return this->getStrWidth(value);
+  }
+
+  void drawBox(int x, int y, int w, int h) {
+    for (int column = x; column < x + w; column++) {
+      for (int row = y; row < y + h; row++) {
+        this->_pixel(column, row, this->_color);
+      }
+    }
+  }
+
+  uint8_t *getBufferPtr() { return this->_buffer; }
+
+  uint8_t getBufferTileWidth() const { return U8G2_WIDTH / 8; }
+
+  uint8_t getBufferTileHeight() const { return U8G2_HEIGHT / 8; }
+
+  // Bytes pushed to the display, and number of transfers.
+  unsigned long getBusBytes() const { return this->_busBytes; }
+
+  // Bytes pushed to a row of tiles (8 pixels high).
+  unsigned long getBusBytes(uint8_t row) const { return this->_rowBytes[row]; }
+
+  unsigned long getTransfers() const { return this->_transfers; }
+};
+
+class U8G2_SH1106_128X64_NONAME_F_HW_I2C : public U8G2 {
+
+public:
+  U8G2_SH1106_128X64_NONAME_F_HW_I2C(u8g2_cb_t rotation,
+                                     uint8_t reset = U8X8_PIN_NONE) {}
+};
@@ -0,0 +1,9 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for U8x8 in the host build (see U8g2lib.h).
+ *
+ */
+#pragma once
+
+#include <U8g2lib.h>
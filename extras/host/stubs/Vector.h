@@ -0,0 +1,47 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the Vector library in the host build.
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+
+template <typename T> class Vector {
+
+private:
+  T *_values = nullptr;
+  size_t _capacity = 0;
+  size_t _size = 0;
+
+public:
+  Vector() {}
+
+  // Use an external storage of capacity elements.
+  Vector(T *values, size_t capacity) : _values(values), _capacity(capacity) {}
+
+  void setStorage(T *values, size_t capacity) {
+    this->_values = values;
+    this->_capacity = capacity;
+    this->_size = 0;
+  }
+
+  void push_back(const T &value) {
+    if (this->_size < this->_capacity) {
+      this->_values[this->_size++] = value;
+    }
+  }
+
+  void clear() { this->_size = 0; }
+
+  T &operator[](size_t index) { return this->_values[index]; }
+
+  size_t size() const { return this->_size; }
+
+  size_t max_size() const { return this->_capacity; }
+
+  bool empty() const { return this->_size == 0; }
+
+  bool full() const { return this->_size == this->_capacity; }
+};
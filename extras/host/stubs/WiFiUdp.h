@@ -0,0 +1,44 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Stand-in for the ESP8266 WiFiUDP in the host build.
+ *
+ * Packets go to the sim::UdpServer registered for the address, and the
+ * answers arrive after its round trip (see sim.hpp).
+ *
+ */
+#pragma once
+
+#include <Udp.h>
+
+namespace sim {
+struct Socket;
+} // namespace sim
+
+class WiFiUDP : public UDP {
+
+private:
+  sim::Socket *_socket = nullptr;
+
+  sim::Socket *_open();
+
+public:
+  WiFiUDP() {}
+  WiFiUDP(const WiFiUDP &) = delete;
+  WiFiUDP &operator=(const WiFiUDP &) = delete;
+  ~WiFiUDP();
+
+  uint8_t begin(uint16_t port);
+  void stop();
+  // Blocks for the DNS latency (see sim::setDnsLatency).
+  int beginPacket(const char *host, uint16_t port);
+  int beginPacket(IPAddress ip, uint16_t port);
+  int endPacket();
+  size_t write(uint8_t value) { return this->write(&value, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  int parsePacket();
+  int available();
+  int read();
+  int read(unsigned char *buffer, size_t size);
+  void flush() {}
+};
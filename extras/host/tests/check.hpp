@@ -0,0 +1,41 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Minimal checks for the host tests: each test is an executable that
+ * returns non-zero if a check failed.
+ *
+ */
+#pragma once
+
+#include <stdio.h>
+
+namespace check {
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+} // namespace check
+
+// Report a failed condition and go on.
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+      check::failures()++;                                                     \
+    }                                                                          \
+  } while (0)
+
+// Same, printing both values.
+#define CHECK_EQ(a, b)                                                         \
+  do {                                                                         \
+    if (!((a) == (b))) {                                                       \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__,       \
+             __LINE__, #a, #b, (long long)(a), (long long)(b));                \
+      check::failures()++;                                                     \
+    }                                                                          \
+  } while (0)
+
+// Exit code of the test.
+#define CHECK_RESULT()                                                         \
+  (check::failures() == 0 ? (printf("passed\n"), 0)                            \
+                          : (printf("%d failed\n", check::failures()), 1))
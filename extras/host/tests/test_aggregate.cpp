@@ -0,0 +1,148 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Summaries of a window: statistics, window boundary, the deadband over
+ * summaries, and the Client sending one summary per window.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  float temperature = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["h"] = this->humidity;
+  }
+
+  template <typename C> void codec(C &c) {
+    c.field("t", this->temperature, 100);
+    c.field("h", this->humidity);
+  }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+typedef sensino::Summary<UserRecord, true> UserSummary;
+
+sensino::Record<UserRecord> record(unsigned long uptime, float temperature,
+                                   int humidity) {
+  sensino::Record<UserRecord> result = {};
+  result.uptime = uptime;
+  result.timestamp = 1700000000 + uptime / 1000;
+  result.timestampMs = uptime % 1000;
+  result.userRecord.temperature = temperature;
+  result.userRecord.humidity = humidity;
+  return result;
+}
+
+void testStatistics() {
+  sensino::Aggregator<UserRecord, UserSummary> aggregator;
+  aggregator.setWindow(10000);
+  sensino::Record<UserSummary> stored;
+
+  // A window of 10 s, from the first record.
+  const float temperatures[] = {20, 22, 18, 24, 21};
+  for (int n = 0; n < 5; n++) {
+    CHECK(!aggregator.add(record(1000 + 2000 * n, temperatures[n], 40 + n),
+                          stored));
+  }
+  CHECK(!aggregator.add(record(10999, 30, 50), stored));
+
+  // The first record at the end of the window closes it and starts the
+  // next one.
+  CHECK(aggregator.add(record(11000, 0, 0), stored));
+  const UserSummary &summary = stored.userRecord;
+  CHECK_EQ(stored.uptime, 1000);
+  CHECK_EQ(stored.timestamp, 1700000001);
+  CHECK_EQ(summary.count, 6);
+  CHECK(summary.min.temperature == 18);
+  CHECK(summary.max.temperature == 30);
+  CHECK(fabsf(summary.mean.temperature - 22.5f) < 1e-4f);
+  CHECK(summary.last.temperature == 30);
+  CHECK_EQ(summary.min.humidity, 40);
+  CHECK_EQ(summary.max.humidity, 50);
+  CHECK_EQ(summary.mean.humidity, 43); // 43.3, rounded.
+  CHECK_EQ(summary.last.humidity, 50);
+  CHECK(summary.variance.temperature > 0);
+
+  CHECK(aggregator.add(record(21000, 5, 1), stored));
+  CHECK_EQ(stored.uptime, 11000);
+  CHECK_EQ(stored.userRecord.count, 1);
+  CHECK(stored.userRecord.min.temperature == 0);
+  CHECK(stored.userRecord.variance.temperature == 0);
+}
+
+void testDeadband() {
+  sensino::Deadband<UserSummary> deadband;
+  deadband.setEnabled(true);
+  deadband.setThreshold("t", 0.5, 0);
+  deadband.setThreshold("h", 2, 0);
+
+  // The same values over windows of 59 and 60 records.
+  sensino::Record<UserSummary> stored = {};
+  for (int n = 0; n < 10; n++) {
+    stored.uptime = 60000 * n;
+    stored.userRecord.count = 59 + n % 2;
+    stored.userRecord.mean.temperature = 20 + 0.1f * (n % 3);
+    bool kept = deadband.pass(stored);
+    CHECK_EQ(kept, n == 0);
+  }
+  CHECK_EQ(deadband.getSuppressed(), 9);
+
+  // A value that moved still goes.
+  stored.uptime += 60000;
+  stored.userRecord.max.humidity = 10;
+  CHECK(deadband.pass(stored));
+}
+
+void testClient() {
+  sim::HttpServer server("sensino.test");
+  sensino::Client<UserRecord, UserConfig, 10, UserSummary> client(
+      "http://sensino.test/", 1, "key", 1000);
+  int measured = 0;
+  client.onMeasureTick([&measured]() {
+    UserRecord userRecord;
+    userRecord.temperature = 20 + measured % 10;
+    userRecord.humidity = 40;
+    measured++;
+    return std::make_pair(userRecord, true);
+  });
+  client.setAggregationWindow(10000);
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+  unsigned long start = millis();
+  while (millis() - start < 60500) {
+    client.loop();
+    yield();
+  }
+
+  // A summary every 10 records.
+  CHECK(measured >= 60);
+  CHECK(server.received >= 5 && server.received <= 6);
+  DynamicJsonDocument doc(1024);
+  CHECK(!deserializeJson(doc, server.requests.back().body.c_str()));
+  JsonObject summary = doc["userRecord"];
+  CHECK_EQ(summary["count"].as<int>(), 10);
+  CHECK(summary["min"]["t"].as<float>() == 20);
+  CHECK(summary["max"]["t"].as<float>() == 29);
+  CHECK(fabsf(summary["mean"]["t"].as<float>() - 24.5f) < 1e-4f);
+  CHECK_EQ(summary["mean"]["h"].as<int>(), 40);
+}
+
+int main() {
+  WiFi.begin("ssid", "passphrase");
+  delay(1000);
+
+  testStatistics();
+  testDeadband();
+  testClient();
+  return CHECK_RESULT();
+}
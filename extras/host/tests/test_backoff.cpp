@@ -0,0 +1,194 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Retry policy: the exponential backoff, the transitions of the breaker,
+ * Retry-After, and the Client during an outage of the server or the WiFi.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  int counter = 0;
+
+  void fill(JsonObject &doc) const { doc["c"] = this->counter; }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+
+// Answer with 503 and Retry-After (in s) to the next requests.
+int unavailable = 0;
+unsigned long retryAfter = 0;
+
+void testProgression() {
+  sensino::Backoff backoff;
+  backoff.setDelays(1000, 16000);
+  backoff.setThreshold(100);
+  CHECK(backoff.canSend());
+  CHECK_EQ(backoff.getWait(), 0);
+
+  // Half fixed, half random, doubled on each failure up to the maximum.
+  for (unsigned long n = 0; n < 8; n++) {
+    unsigned long expected = 1000UL << n;
+    if (expected > 16000) {
+      expected = 16000;
+    }
+    backoff.failure();
+    unsigned long wait = backoff.getWait();
+    CHECK(wait >= expected / 2 && wait <= expected);
+    CHECK(!backoff.canSend());
+    delay(wait - 1);
+    CHECK(!backoff.canSend());
+    delay(1);
+    CHECK(backoff.canSend());
+  }
+  backoff.success();
+  CHECK_EQ(backoff.getFailures(), 0);
+  CHECK(backoff.canSend());
+}
+
+void testBreaker() {
+  sensino::Backoff backoff;
+  backoff.setDelays(1000, 4000);
+  backoff.setThreshold(3);
+
+  backoff.failure();
+  backoff.failure();
+  CHECK(backoff.getState() == sensino::BREAKER_STATE::CLOSED);
+  backoff.failure();
+  CHECK(backoff.getState() == sensino::BREAKER_STATE::OPEN);
+  CHECK_EQ(backoff.getOpens(), 1);
+
+  // Once the delay expired, a probe; failing it opens the breaker again,
+  // not counted as a new opening.
+  for (int n = 0; n < 3; n++) {
+    CHECK(!backoff.canSend());
+    delay(backoff.getWait());
+    CHECK(backoff.canSend());
+    CHECK(backoff.getState() == sensino::BREAKER_STATE::HALF_OPEN);
+    CHECK(backoff.isProbing());
+    backoff.failure();
+    CHECK(backoff.getState() == sensino::BREAKER_STATE::OPEN);
+  }
+  CHECK_EQ(backoff.getOpens(), 1);
+
+  // Only a successful probe closes it.
+  delay(backoff.getWait());
+  CHECK(backoff.canSend());
+  backoff.success();
+  CHECK(backoff.getState() == sensino::BREAKER_STATE::CLOSED);
+  CHECK(!backoff.isProbing());
+
+  for (int n = 0; n < 3; n++) {
+    backoff.failure();
+  }
+  CHECK_EQ(backoff.getOpens(), 2);
+}
+
+void testRetryAfter() {
+  sensino::Backoff backoff;
+  backoff.setDelays(1000, 4000);
+  backoff.failure(30000);
+  CHECK_EQ(backoff.getWait(), 30000);
+
+  // Through the Client: no request before the server asked.
+  sensino::Client<UserRecord, UserConfig, 10> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  client.onMeasureTick([]() { return std::make_pair(UserRecord(), true); });
+  unavailable = 1;
+  retryAfter = 20;
+  unsigned long received = server.received;
+  while (server.received < received + 2) {
+    client.loop();
+    yield();
+  }
+  uint64_t gap =
+      server.requests[received + 1].at - server.requests[received].at;
+  CHECK(gap >= 20000000);
+  CHECK(gap < 21000000);
+}
+
+// Run the client for a while, the longest loop (in ms) and the requests
+// that failed.
+std::pair<unsigned long, unsigned long>
+run(sensino::Client<UserRecord, UserConfig, 10> &client,
+    unsigned long duration) {
+  unsigned long longest = 0;
+  unsigned long errors = client.getStats().sendErrors;
+  unsigned long start = millis();
+  while (millis() - start < duration) {
+    unsigned long before = millis();
+    client.loop();
+    longest = std::max(longest, millis() - before);
+    yield();
+  }
+  return std::make_pair(longest, client.getStats().sendErrors - errors);
+}
+
+void testOutage() {
+  sensino::Client<UserRecord, UserConfig, 10> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  int measured = 0;
+  client.onMeasureTick([&measured]() {
+    UserRecord record;
+    record.counter = measured++;
+    return std::make_pair(record, true);
+  });
+  client.setRetryDelays(1000, 60000);
+  client.setBreakerThreshold(3);
+  run(client, 5000);
+
+  // The server is down for 10 minutes: retries back off up to a minute,
+  // and measures go on.
+  server.down = true;
+  int before = measured;
+  std::pair<unsigned long, unsigned long> down = run(client, 600000);
+  CHECK(client.getBreakerState() != sensino::BREAKER_STATE::CLOSED);
+  CHECK(down.first < 100);
+  CHECK(down.second >= 10 && down.second <= 20);
+  CHECK(measured - before >= 599);
+
+  // Then the WiFi is.
+  server.down = false;
+  sim::setWifiDown(true);
+  std::pair<unsigned long, unsigned long> wifi = run(client, 600000);
+  CHECK(client.getBreakerState() != sensino::BREAKER_STATE::CLOSED);
+  CHECK(wifi.first < 100);
+  CHECK(wifi.second >= 10 && wifi.second <= 20);
+
+  // Back to normal within a retry delay.
+  sim::setWifiDown(false);
+  unsigned long received = server.received;
+  run(client, 70000);
+  CHECK(client.getBreakerState() == sensino::BREAKER_STATE::CLOSED);
+  CHECK(server.received - received >= 10);
+  printf("outage: longest loop %lu ms, %lu failed requests; WiFi: %lu ms, "
+         "%lu\n",
+         down.first, down.second, wifi.first, wifi.second);
+}
+
+int main() {
+  server.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    if (unavailable > 0) {
+      unavailable--;
+      response.status = 503;
+      response.headers = "Retry-After: " + std::to_string(retryAfter) + "\r\n";
+    }
+    return response;
+  });
+  WiFi.begin("ssid", "passphrase");
+  delay(1000);
+
+  testProgression();
+  testBreaker();
+  testRetryAfter();
+  testOutage();
+  return CHECK_RESULT();
+}
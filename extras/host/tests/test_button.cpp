@@ -0,0 +1,147 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Button: a bouncing contact counts as one press and one release, polled
+ * or with the edges recorded by the interrupt in a ring handled by loop.
+ *
+ */
+#include "button.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+#define PIN 4
+
+enum class Menu { RELEASED, SELECTED, COUNT };
+
+int presses = 0;
+int releases = 0;
+
+void setupButton(sensino::Button<Menu> &button, bool interrupt) {
+  presses = 0;
+  releases = 0;
+  sim::setPin(PIN, HIGH);
+  button.addState(
+      Menu::RELEASED,
+      []() {
+        presses++;
+        return Menu::SELECTED;
+      },
+      nullptr);
+  button.addState(Menu::SELECTED, nullptr, []() {
+    releases++;
+    return Menu::RELEASED;
+  });
+  button.setDebounce(30);
+  button.setPersistenceMs(10000);
+  button.begin(interrupt);
+}
+
+// Bounce between the levels (ms at each), ending on the given one.
+void bounce(int level) {
+  const unsigned long durations[] = {2, 1, 3, 1, 4, 2};
+  for (unsigned long duration : durations) {
+    sim::setPin(PIN, level);
+    delay(duration);
+    sim::setPin(PIN, !level);
+    delay(duration);
+  }
+  sim::setPin(PIN, level);
+}
+
+// Call loop every ms for a while.
+void run(sensino::Button<Menu> &button, unsigned long duration) {
+  unsigned long start = millis();
+  while (millis() - start < duration) {
+    button.loop();
+    delay(1);
+  }
+}
+
+void testPolled() {
+  sensino::Button<Menu> button(PIN, LOW, 0);
+  setupButton(button, false);
+  run(button, 100);
+
+  bounce(LOW);
+  run(button, 100);
+  CHECK_EQ(presses, 1);
+  CHECK(button.getState() == Menu::SELECTED);
+  bounce(HIGH);
+  run(button, 100);
+  CHECK_EQ(releases, 1);
+  CHECK(button.getState() == Menu::RELEASED);
+
+  // A glitch shorter than the debounce is ignored.
+  sim::setPin(PIN, LOW);
+  run(button, 10);
+  sim::setPin(PIN, HIGH);
+  run(button, 100);
+  CHECK_EQ(presses, 1);
+}
+
+void testInterrupt() {
+  sensino::Button<Menu> button(PIN, LOW, 0);
+  setupButton(button, true);
+  run(button, 100);
+
+  // The 13 edges of each bounce are queued while loop does not run,
+  // then handled at once: one press, one release.
+  bounce(LOW);
+  delay(100);
+  CHECK_EQ(presses, 0);
+  unsigned long wait = button.run();
+  CHECK_EQ(presses, 1);
+  CHECK(button.getState() == Menu::SELECTED);
+  CHECK_EQ(wait, BUTTON_IDLE_PERIOD);
+  bounce(HIGH);
+  delay(100);
+  button.loop();
+  CHECK_EQ(releases, 1);
+  CHECK(button.getState() == Menu::RELEASED);
+  CHECK_EQ(button.getLost(), 0);
+
+  // A short press is not missed by a late loop: the ring keeps its times.
+  sim::setPin(PIN, LOW);
+  delay(1);
+  sim::setPin(PIN, HIGH);
+  delay(1);
+  sim::setPin(PIN, LOW);
+  delay(40);
+  sim::setPin(PIN, HIGH);
+  delay(200);
+  button.loop();
+  CHECK_EQ(presses, 2);
+  CHECK_EQ(releases, 2);
+
+  // While a glitch is not.
+  sim::setPin(PIN, LOW);
+  delay(10);
+  sim::setPin(PIN, HIGH);
+  delay(200);
+  button.loop();
+  CHECK_EQ(presses, 2);
+
+  // With the ring full, edges are lost, and the level read by loop still
+  // ends the debounce.
+  for (int n = 0; n < BUTTON_EVENTS; n++) {
+    sim::setPin(PIN, LOW);
+    delay(1);
+    sim::setPin(PIN, HIGH);
+    delay(1);
+  }
+  sim::setPin(PIN, LOW);
+  CHECK(button.getLost() > 0);
+  run(button, 100);
+  CHECK_EQ(presses, 3);
+  CHECK(button.getState() == Menu::SELECTED);
+  sim::setPin(PIN, HIGH);
+  run(button, 100);
+  CHECK_EQ(releases, 3);
+}
+
+int main() {
+  testPolled();
+  testInterrupt();
+  return CHECK_RESULT();
+}
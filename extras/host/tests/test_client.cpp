@@ -0,0 +1,118 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * The Client measures, stores and sends the records to a simulated server,
+ * and sends the userConfig headers again when they change, also for a
+ * userConfig that is not trivially copyable.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  float temperature = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["h"] = this->humidity;
+  }
+};
+
+struct UserConfig {
+  int mode = 1;
+
+  void fill(JsonDocument &doc) const { doc["mode"] = this->mode; }
+};
+
+// Not trivially copyable.
+struct NamedConfig {
+  String name = "probe";
+
+  void fill(JsonDocument &doc) const { doc["name"] = this->name; }
+};
+
+void testNamedConfig(sim::HttpServer &server) {
+  sensino::Client<UserRecord, NamedConfig, 10> client("http://sensino.test/",
+                                                      8, "key", 1000);
+  sensino::Record<UserRecord> record = {};
+  CHECK(client.sendRecord(record));
+  CHECK(server.requests.back().header("sno-user-name") == "probe");
+  std::string hash = server.requests.back().header("sno-config-hash");
+
+  // Unchanged, only the hash goes.
+  CHECK(client.sendRecord(record));
+  CHECK(server.requests.back().header("sno-user-name") == "");
+  CHECK(server.requests.back().header("sno-config-hash") == hash);
+
+  client.userConfig.name = "renamed";
+  CHECK(client.sendRecord(record));
+  CHECK(server.requests.back().header("sno-user-name") == "renamed");
+  CHECK(server.requests.back().header("sno-config-hash") != hash);
+}
+
+int main() {
+  sim::HttpServer server("sensino.test");
+  sim::HttpServer timeServer("time.test");
+  timeServer.log = false;
+  timeServer.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    unsigned long long epochMs = sim::epochMs(request.at);
+    response.body = std::to_string(epochMs / 1000) + "." +
+                    std::to_string(epochMs % 1000 + 1000).substr(1);
+    return response;
+  });
+
+  sensino::timeClient.begin("http://time.test/");
+  sensino::Client<UserRecord, UserConfig, 10> client("http://sensino.test/",
+                                                     7, "key", 1000);
+  int count = 0;
+  client.onMeasureTick([&count]() {
+    UserRecord record;
+    record.temperature = 20.5;
+    record.humidity = count++;
+    return std::make_pair(record, true);
+  });
+
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  unsigned long start = millis();
+  while (millis() - start < 10500) {
+    client.loop();
+    yield();
+  }
+
+  // A record per second, each one in its own request.
+  CHECK(count >= 10);
+  CHECK(server.received >= 9);
+  CHECK(server.connections == 1);
+  CHECK(sensino::timeClient.getCurrentEpoch() > 0);
+
+  const sim::HttpRequest &request = server.requests.back();
+  CHECK(request.method == "POST");
+  CHECK(request.header("sno-api-key") == "key");
+  CHECK(request.header("sno-serial-number") == "7");
+  CHECK(request.header("sno-method") == "0");
+
+  DynamicJsonDocument doc(1024);
+  CHECK(!deserializeJson(doc, request.body.c_str()));
+  CHECK_EQ(doc["userRecord"]["h"].as<int>(), count - 1);
+  CHECK(doc["userRecord"]["t"].as<float>() == 20.5f);
+  CHECK_EQ(doc["bootID"].as<long>() > 0, true);
+
+  // The timestamps follow the time server.
+  unsigned long long recordMs =
+      doc["timestamp"].as<unsigned long long>() * 1000 +
+      doc["timestampMs"].as<unsigned int>();
+  unsigned long long trueMs =
+      sim::epochMs((uint64_t)doc["uptime"].as<unsigned long>() * 1000);
+  CHECK(recordMs + 20 >= trueMs && recordMs <= trueMs + 20);
+
+  testNamedConfig(server);
+
+  return CHECK_RESULT();
+}
@@ -0,0 +1,132 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Send-on-delta: the thresholds of the fields, the heartbeat, and the
+ * settings sent by the server ("deadband" in userServerPayload).
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  float temperature = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["h"] = this->humidity;
+  }
+
+  template <typename C> void codec(C &c) {
+    c.field("t", this->temperature, 100);
+    c.field("h", this->humidity);
+  }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sensino::Record<UserRecord> record(unsigned long uptime, float temperature,
+                                   int humidity) {
+  sensino::Record<UserRecord> result = {};
+  result.uptime = uptime;
+  result.userRecord.temperature = temperature;
+  result.userRecord.humidity = humidity;
+  return result;
+}
+
+void testThresholds() {
+  sensino::Deadband<UserRecord> deadband;
+  CHECK(deadband.pass(record(0, 20, 40)));
+  CHECK(deadband.pass(record(1000, 20, 40)));
+
+  deadband.setEnabled(true);
+  deadband.setThreshold("t", 0.5, 0.05);
+  CHECK(deadband.pass(record(0, 20, 40)));
+
+  // Within max(0.5, 5% of 20): compared with the last record kept, so a
+  // slow drift goes once it adds up.
+  CHECK(!deadband.pass(record(1000, 20.9f, 40)));
+  CHECK(!deadband.pass(record(2000, 19.1f, 40)));
+  CHECK(deadband.pass(record(3000, 21.1f, 40)));
+  CHECK(!deadband.pass(record(4000, 22.1f, 40)));
+
+  // Without threshold, any change goes.
+  CHECK(deadband.pass(record(5000, 21.1f, 41)));
+  CHECK_EQ(deadband.getSuppressed(), 3);
+
+  // Enabling it again keeps the last record kept.
+  deadband.setEnabled(true);
+  CHECK(!deadband.pass(record(6000, 21.1f, 41)));
+}
+
+void testHeartbeat() {
+  sensino::Deadband<UserRecord> deadband;
+  deadband.setEnabled(true);
+  deadband.setHeartbeat(10000);
+
+  // The same record, kept every 10 s.
+  int kept = 0;
+  for (unsigned long uptime = 0; uptime < 60000; uptime += 1000) {
+    if (deadband.pass(record(uptime, 20, 40))) {
+      CHECK_EQ(uptime % 10000, 0);
+      kept++;
+    }
+  }
+  CHECK_EQ(kept, 6);
+}
+
+void testServerSettings() {
+  sim::HttpServer server("sensino.test");
+  server.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    response.body = "{\"userServerPayload\": {\"deadband\": {\"enabled\": true,"
+                    " \"heartbeat\": 10000, \"fields\": {\"t\": [0.5, 0]}}}}";
+    return response;
+  });
+  sensino::Client<UserRecord, UserConfig, 10> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  int measured = 0;
+  client.onMeasureTick([&measured]() {
+    UserRecord userRecord;
+    // Noise within the threshold, then a step at 30 s.
+    userRecord.temperature = (measured < 30 ? 20 : 25) + 0.1f * (measured % 3);
+    userRecord.humidity = 40;
+    measured++;
+    return std::make_pair(userRecord, true);
+  });
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+  unsigned long start = millis();
+  while (millis() - start < 60500) {
+    client.loop();
+    yield();
+  }
+
+  // The first record, the step, and a heartbeat every 10 s (each answer
+  // carries the settings again).
+  CHECK(client.getSendOnDelta());
+  CHECK(measured >= 60);
+  CHECK(server.received >= 6 && server.received <= 8);
+  bool step = false;
+  for (const sim::HttpRequest &request : server.requests) {
+    DynamicJsonDocument doc(1024);
+    CHECK(!deserializeJson(doc, request.body.c_str()));
+    step = step || doc["userRecord"]["t"].as<float>() >= 25;
+  }
+  CHECK(step);
+}
+
+int main() {
+  WiFi.begin("ssid", "passphrase");
+  delay(1000);
+
+  testThresholds();
+  testHeartbeat();
+  testServerSettings();
+  return CHECK_RESULT();
+}
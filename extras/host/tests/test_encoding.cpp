@@ -0,0 +1,243 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * JSON and MessagePack bodies carry the same fields, records larger than
+ * SENSINO_DOC_SIZE are not cut, batches stop at the budget but always
+ * carry the first record, and delta batches decode to the records encoded.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  float temperature = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["h"] = this->humidity;
+  }
+};
+
+// Takes more than SENSINO_DOC_SIZE in a document.
+struct LargeRecord {
+  int values[40];
+
+  void fill(JsonObject &doc) const {
+    static const char *names[] = {
+        "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10",
+        "v11", "v12", "v13", "v14", "v15", "v16", "v17", "v18", "v19", "v20",
+        "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30",
+        "v31", "v32", "v33", "v34", "v35", "v36", "v37", "v38", "v39"};
+    for (int n = 0; n < 40; n++) {
+      doc[names[n]] = this->values[n];
+    }
+  }
+};
+
+// Described by a codec, for the delta encoding.
+struct DeltaRecord {
+  float temperature = 0;
+  int humidity = 0;
+  float pressure = 0;
+
+  template <typename C> void codec(C &c) {
+    c.field("t", this->temperature, 100);
+    c.field("h", this->humidity);
+    c.field("p", this->pressure);
+  }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+
+void testRoundTrip() {
+  sensino::Client<UserRecord, UserConfig, 4> client("http://sensino.test/", 1,
+                                                    "key", 1000);
+  sensino::Record<UserRecord> record = {};
+  record.uptime = 123456;
+  record.timestamp = 1700000123;
+  record.timestampMs = 456;
+  record.userRecord.temperature = 21.25;
+  record.userRecord.humidity = 40;
+
+  CHECK(client.sendRecord(record));
+  client.setEncoding(sensino::ENCODING::MSGPACK);
+  CHECK(client.sendRecord(record));
+
+  const sim::HttpRequest &json = server.requests[server.requests.size() - 2];
+  const sim::HttpRequest &msgpack = server.requests.back();
+  CHECK(json.header("content-type") == "application/json");
+  CHECK(msgpack.header("content-type") == "application/msgpack");
+  CHECK(msgpack.body.size() < json.body.size());
+
+  DynamicJsonDocument a(512);
+  DynamicJsonDocument b(512);
+  CHECK(!deserializeJson(a, json.body.c_str()));
+  CHECK(!deserializeMsgPack(b, msgpack.body.data(), msgpack.body.size()));
+  for (const char *key : {"uptime", "timestamp", "timestampMs", "bootID",
+                          "ntpEpoch"}) {
+    CHECK(b.containsKey(key));
+    CHECK_EQ(a[key].as<long long>(), b[key].as<long long>());
+  }
+  CHECK_EQ(b["uptime"].as<unsigned long>(), 123456);
+  CHECK(b["userRecord"]["t"].as<float>() == 21.25f);
+  CHECK_EQ(b["userRecord"]["h"].as<int>(), 40);
+}
+
+void testLargeRecord() {
+  sensino::Client<LargeRecord, UserConfig, 4> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  sensino::Record<LargeRecord> record = {};
+  for (int n = 0; n < 40; n++) {
+    record.userRecord.values[n] = 1000 + n;
+  }
+  CHECK(client.sendRecord(record));
+  DynamicJsonDocument doc(4096);
+  CHECK(!deserializeJson(doc, server.requests.back().body.c_str()));
+  CHECK_EQ(doc["userRecord"].size(), 40);
+  CHECK_EQ(doc["userRecord"]["v39"].as<int>(), 1039);
+  CHECK(doc.containsKey("bootID"));
+}
+
+void testBatch() {
+  int counter = 0;
+  sensino::Client<UserRecord, UserConfig, 20> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  client.onMeasureTick([&counter]() {
+    UserRecord record;
+    record.humidity = counter++;
+    return std::make_pair(record, true);
+  });
+  client.setFlushPolicy(20, 0);
+  client.setBatchBytes(300);
+  while (counter < 19) {
+    client.loop();
+    yield();
+  }
+
+  // Bounded by the budget.
+  int sent = client.sendBatch();
+  CHECK(sent > 1 && sent < 19);
+  CHECK(server.requests.back().body.size() <= 300);
+
+  // The document grows with the budget.
+  client.setBatchBytes(4000);
+  CHECK_EQ(client.sendBatch(), 19 - sent);
+  DynamicJsonDocument doc(8192);
+  CHECK(!deserializeJson(doc, server.requests.back().body.c_str()));
+  CHECK_EQ(doc["records"].size(), (size_t)(19 - sent));
+  CHECK_EQ(doc["records"][18 - sent]["userRecord"]["h"].as<int>(), 18);
+}
+
+void testDelta() {
+  sensino::Record<DeltaRecord> records[20];
+  for (int n = 0; n < 20; n++) {
+    records[n].uptime = 1000 + 1000 * n + (n % 3);
+    records[n].timestamp = 1700000000 + n;
+    records[n].timestampMs = (n * 37) % 1000;
+    records[n].channel = n % 2;
+    records[n].userRecord.temperature = 21.237f - 0.5f * n;
+    records[n].userRecord.humidity = 40 + n * (n % 2 ? 1 : -1);
+    records[n].userRecord.pressure = 1013.25f + n;
+  }
+
+  // The buffer overflows before the last record.
+  uint8_t buffer[128];
+  sensino::DeltaEncoder encoder(buffer, sizeof(buffer));
+  CHECK(encoder.begin(-12345, 1700000000));
+  int count = 0;
+  while (count < 20 && encoder.add(records[count])) {
+    count++;
+  }
+  CHECK(count > 1 && count < 20);
+  size_t length = encoder.length();
+  CHECK(!encoder.add(records[count]));
+  CHECK_EQ(encoder.length(), length);
+
+  sensino::DeltaDecoder decoder(buffer, length);
+  long bootID = 0;
+  unsigned long ntpEpoch = 0;
+  CHECK(decoder.begin(bootID, ntpEpoch));
+  CHECK_EQ(bootID, -12345);
+  CHECK_EQ(ntpEpoch, 1700000000);
+  int decoded = 0;
+  sensino::Record<DeltaRecord> record;
+  while (decoder.next(record)) {
+    const sensino::Record<DeltaRecord> &expected = records[decoded++];
+    CHECK_EQ(record.uptime, expected.uptime);
+    CHECK_EQ(record.timestamp, expected.timestamp);
+    CHECK_EQ(record.timestampMs, expected.timestampMs);
+    CHECK_EQ(record.channel, expected.channel);
+    // Quantized to hundredths.
+    CHECK(fabsf(record.userRecord.temperature -
+                expected.userRecord.temperature) <= 0.005f);
+    CHECK_EQ(record.userRecord.humidity, expected.userRecord.humidity);
+    CHECK(record.userRecord.pressure == expected.userRecord.pressure);
+  }
+  CHECK(!decoder.hasError());
+  CHECK_EQ(decoded, count);
+}
+
+void testLargeBatch() {
+  sensino::Client<LargeRecord, UserConfig, 4> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  client.onMeasureTick([]() {
+    LargeRecord record = {};
+    return std::make_pair(record, true);
+  });
+  client.setBatchBytes(60);
+  client.setFlushPolicy(4, 0);
+  delay(1000);
+  client.run();
+  // The record does not fit in a document sized for the budget,
+  // it goes alone in a larger one.
+  CHECK_EQ(client.sendBatch(), 1);
+  DynamicJsonDocument doc(4096);
+  CHECK(!deserializeJson(doc, server.requests.back().body.c_str()));
+  CHECK_EQ(doc["records"][0]["userRecord"].size(), 40);
+}
+
+void testLargeBatchLoop() {
+  sensino::Client<LargeRecord, UserConfig, 10> client("http://sensino.test/",
+                                                      1, "key", 1000);
+  int counter = 0;
+  client.onMeasureTick([&counter]() {
+    LargeRecord record = {};
+    record.values[0] = counter++;
+    return std::make_pair(record, true);
+  });
+  client.setBatchBytes(100);
+  unsigned long received = server.received;
+  unsigned long start = millis();
+  while (millis() - start < 60000) {
+    client.loop();
+    yield();
+  }
+
+  // Each record goes on its own, none is stuck or dropped.
+  CHECK(counter >= 59);
+  CHECK(server.received - received >= (unsigned long)counter - 1);
+  CHECK_EQ(client.getStats().sendErrors, 0);
+  CHECK_EQ(client.getStats().bufferFull, 0);
+}
+
+int main() {
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  WiFi.begin(ssid, passphrase);
+  delay(1000);
+
+  testRoundTrip();
+  testLargeRecord();
+  testBatch();
+  testDelta();
+  testLargeBatch();
+  testLargeBatchLoop();
+  return CHECK_RESULT();
+}
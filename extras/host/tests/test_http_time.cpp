@@ -0,0 +1,146 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * HTTPTimeClient against a simulated time server: jitter, wrong answers
+ * slow requests, and a skewed local clock.
+ *
+ */
+#include "HTTPTimeClient.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+sim::HttpServer server("time.test");
+
+// Answers to wrong by this (in ms), every few requests (0 for none).
+long wrongBy = 0;
+unsigned long wrongEvery = 0;
+
+// Error (in ms) of the client clock.
+long error(const sensino::HTTPTimeClient &client) {
+  return (long)(client.getEpochTimeMs() - sim::epochMs());
+}
+
+// Call update every period ms until the update in progress ends.
+bool finish(sensino::HTTPTimeClient &client, unsigned long period) {
+  bool success = client.update();
+  while (client.isUpdating()) {
+    delay(period);
+    success = client.update();
+  }
+  return success;
+}
+
+void testJitter() {
+  server.link.latency = 20;
+  server.link.jitter = 150;
+  sensino::HTTPTimeClient client("http://time.test/");
+  for (int n = 0; n < 5; n++) {
+    CHECK(finish(client, 10));
+    CHECK(client.getRoundTrip() <= 1000);
+    CHECK(labs(error(client)) <= (long)client.getUncertainty() + 1);
+    delay(client.getUpdateInterval());
+  }
+  CHECK_EQ(client.getFailures(), 0);
+}
+
+void testOutliers() {
+  server.link.latency = 20;
+  server.link.jitter = 30;
+  wrongBy = 5000;
+  wrongEvery = 3;
+  sensino::HTTPTimeClient client("http://time.test/");
+  for (int n = 0; n < 5; n++) {
+    CHECK(finish(client, 10));
+    CHECK(labs(error(client)) <= (long)client.getUncertainty() + 1);
+    delay(client.getUpdateInterval());
+  }
+  CHECK(client.getOutliers() >= 10);
+
+  // Without agreement there is no update.
+  wrongEvery = 2;
+  client.setMinSamples(6);
+  CHECK(!finish(client, 10));
+  CHECK_EQ(client.getFailures(), 1);
+  wrongBy = 0;
+  wrongEvery = 0;
+}
+
+void testSlowServer() {
+  server.link.latency = 800;
+  server.link.jitter = 0;
+  sensino::HTTPTimeClient client("http://time.test/");
+  client.setMaxRoundTrip(1000);
+
+  // Requests time out after the maximum round trip.
+  unsigned long longest = 0;
+  bool success = client.update();
+  while (client.isUpdating()) {
+    delay(10);
+    unsigned long start = millis();
+    success = client.update();
+    longest = std::max(longest, millis() - start);
+  }
+  CHECK(!success);
+  CHECK(longest <= 1000);
+  CHECK_EQ(client.getFailures(), 1);
+  CHECK_EQ(client.getCurrentEpoch(), 0);
+}
+
+void testSkew() {
+  server.link.latency = 20;
+  server.link.jitter = 5;
+  sim::setClockSkew(2e-4); // 200 ppm fast.
+  sensino::HTTPTimeClient client("http://time.test/");
+  client.setUpdateInterval(60000);
+  client.setMaxError(100);
+
+  // A day, the clock read every second.
+  unsigned long updates = 0;
+  long worst = 0;
+  bool updating = false;
+  unsigned long start = millis();
+  while (millis() - start < 86400000) {
+    client.update();
+    if (updating && !client.isUpdating()) {
+      updates++;
+    }
+    updating = client.isUpdating();
+    if (!updating && client.getCurrentEpoch() > 0) {
+      worst = std::max(worst, labs(error(client)));
+    }
+    delay(updating ? 10 : 1000);
+  }
+  sim::setClockSkew(0);
+
+  // Within the bound, with at least 10 times fewer updates than one
+  // per interval (1440).
+  printf("skew: %lu updates, worst error %ld ms, drift %.1f ppm\n", updates,
+         worst, client.getDrift() * 1e6);
+  CHECK(updates <= 144);
+  CHECK(worst <= 100);
+  CHECK(fabs(client.getDrift() - 2e-4) < 2e-5);
+}
+
+int main() {
+  WiFi.begin("ssid", "passphrase");
+  delay(1000);
+  server.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    unsigned long long epochMs = sim::epochMs(request.at);
+    if (wrongEvery > 0 && server.received % wrongEvery == 0) {
+      epochMs += wrongBy;
+    }
+    char body[32];
+    snprintf(body, sizeof(body), "%llu.%03llu", epochMs / 1000,
+             epochMs % 1000);
+    response.body = body;
+    return response;
+  });
+
+  testJitter();
+  testOutliers();
+  testSlowServer();
+  testSkew();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,94 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * With idle sleep, loop still serves the time update in progress and
+ * sends the records by the flush deadline, even with a long period.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  int counter = 0;
+
+  void fill(JsonObject &doc) const { doc["c"] = this->counter; }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+sim::HttpServer timeServer("time.test");
+
+sensino::Client<UserRecord, UserConfig, 10> client("http://sensino.test/", 1,
+                                                   "key", 60000);
+int counter = 0;
+std::map<int, unsigned long> measuredAt;
+
+void testTimeUpdate() {
+  // The update runs to the end between two measures: loop sleeps until
+  // the next sample, not the next measure.
+  unsigned long start = millis();
+  unsigned long idle = client.run();
+  unsigned long longest = 0;
+  while (sensino::timeClient.isUpdating()) {
+    longest = std::max(longest, idle);
+    delay(idle);
+    yield();
+    idle = client.run();
+  }
+  CHECK(longest <= 230);
+  CHECK(sensino::timeClient.getCurrentEpoch() > 0);
+  CHECK(millis() - start < 5000);
+  CHECK(idle > 0);
+}
+
+void testFlushDeadline() {
+  client.setFlushPolicy(10, 10000);
+  unsigned long received = server.received;
+  unsigned long start = millis();
+  while (millis() - start < 300000) {
+    client.loop();
+    yield();
+  }
+
+  // Each record is sent by the deadline, not at the next measure.
+  CHECK(server.received - received >= 4);
+  for (unsigned long n = received; n < server.received; n++) {
+    DynamicJsonDocument doc(1024);
+    CHECK(!deserializeJson(doc, server.requests[n].body.c_str()));
+    int value = doc["userRecord"]["c"].as<int>();
+    unsigned long at = server.requests[n].at / 1000;
+    CHECK(at - measuredAt[value] <= 10000 + 100);
+  }
+}
+
+int main() {
+  timeServer.log = false;
+  timeServer.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    unsigned long long epochMs = sim::epochMs(request.at);
+    response.body = std::to_string(epochMs / 1000) + "." +
+                    std::to_string(epochMs % 1000 + 1000).substr(1);
+    return response;
+  });
+  sensino::timeClient.begin("http://time.test/");
+
+  client.onMeasureTick([]() {
+    UserRecord record;
+    record.counter = counter;
+    measuredAt[counter++] = millis();
+    return std::make_pair(record, true);
+  });
+  client.setIdleSleep(true);
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  testTimeUpdate();
+  testFlushDeadline();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,169 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Journal on a RAMFlash: torn entries, rotation of the sectors, recovery
+ * after a reboot and wear; Memory over a journal and over the EEPROM.
+ *
+ */
+#include "memory.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct Counters {
+  uint32_t boots = 0;
+  uint32_t sent = 0;
+};
+
+// Read a slot from a journal recovered from the flash, as after a reboot.
+template <uint32_t N>
+bool reboot(sensino::RAMFlash<N> &flash, uint16_t id, uint32_t &value) {
+  sensino::Journal journal(flash);
+  journal.begin();
+  return journal.read(id, &value, sizeof(value));
+}
+
+void testTorn() {
+  sensino::RAMFlash<2> flash;
+  sensino::Journal journal(flash);
+  uint32_t value = 1;
+  CHECK(journal.write(0, &value, sizeof(value)));
+  value = 2;
+  CHECK(journal.write(0, &value, sizeof(value)));
+
+  // The second entry (after the sector header and the first one of 16
+  // bytes) lost power before its CRC was written: the first copy is used.
+  memset(&flash.content[0][8 + 16 + 12], 0xFF, 4);
+  uint32_t read = 0;
+  CHECK(reboot(flash, 0, read));
+  CHECK_EQ(read, 1);
+
+  // Or with a damaged data byte.
+  memset(&flash.content[0][8 + 16 + 12], 0, 4);
+  flash.content[0][8 + 16 + 8] ^= 1;
+  read = 0;
+  CHECK(reboot(flash, 0, read));
+  CHECK_EQ(read, 1);
+
+  // The next writes go after it.
+  sensino::Journal recovered(flash);
+  value = 3;
+  CHECK(recovered.write(0, &value, sizeof(value)));
+  read = 0;
+  CHECK(reboot(flash, 0, read));
+  CHECK_EQ(read, 3);
+
+  // Nothing valid in a slot that only has a torn entry.
+  sensino::RAMFlash<2> empty;
+  sensino::Journal first(empty);
+  CHECK(first.write(1, &value, sizeof(value)));
+  memset(&empty.content[0][8 + 12], 0xFF, 4);
+  CHECK(!reboot(empty, 1, read));
+}
+
+void testRotation() {
+  sensino::RAMFlash<3> flash;
+  sensino::Journal journal(flash);
+  uint32_t settings = 0xC0FFEE;
+  CHECK(journal.write(1, &settings, sizeof(settings)));
+
+  // 255 entries of 16 bytes fill a sector: the settings, written once,
+  // are copied forward each time their sector is the oldest.
+  for (uint32_t value = 0; value < 2000; value++) {
+    CHECK(journal.write(0, &value, sizeof(value)));
+  }
+  CHECK(journal.getCompactions() >= 2);
+  uint32_t read = 0;
+  CHECK(journal.read(1, &read, sizeof(read)));
+  CHECK_EQ(read, 0xC0FFEE);
+
+  // After a reboot, the newest copy of each slot wins over the older
+  // ones still in the other sectors.
+  read = 0;
+  CHECK(reboot(flash, 0, read));
+  CHECK_EQ(read, 1999);
+  read = 0;
+  CHECK(reboot(flash, 1, read));
+  CHECK_EQ(read, 0xC0FFEE);
+  CHECK(!reboot(flash, 2, read));
+}
+
+void testWear() {
+  sensino::RAMFlash<2> flash;
+  sensino::Journal journal(flash);
+  Counters counters;
+  CHECK(journal.write(0, &counters, sizeof(counters)));
+  unsigned long erases = flash.getErases();
+  unsigned long writes = flash.getWrites();
+  CHECK_EQ(erases, 1);
+
+  // Unchanged content does not touch the flash.
+  for (int n = 0; n < 10; n++) {
+    CHECK(journal.write(0, &counters, sizeof(counters)));
+  }
+  CHECK_EQ(flash.getErases(), erases);
+  CHECK_EQ(flash.getWrites(), writes);
+
+  // A changed one appends an entry of 20 bytes (header, data and CRC,
+  // written in 3 steps), and a sector is erased once filled. With two
+  // sectors, each rotation writes the sector header and copies the slot
+  // out of the previous head.
+  const unsigned long changes = 1000;
+  for (unsigned long n = 0; n < changes; n++) {
+    counters.sent++;
+    CHECK(journal.write(0, &counters, sizeof(counters)));
+  }
+  unsigned long perSector = (SENSINO_SECTOR_SIZE - 8) / 20;
+  unsigned long rotations = flash.getErases() - erases;
+  CHECK_EQ(rotations, (changes + 1) / perSector);
+  CHECK_EQ(flash.getWrites() - writes, 3 * changes + 4 * rotations);
+  CHECK_EQ(journal.getWriteStats().count(), changes + 1);
+
+  // Slots that do not fit are refused.
+  CHECK(!journal.write(JOURNAL_MAX_SLOTS, &counters, sizeof(counters)));
+  uint8_t large[SENSINO_SECTOR_SIZE / 2];
+  CHECK(!journal.write(1, large, sizeof(large)));
+}
+
+void testMemory() {
+  // Over a journal, each instance in its own slot.
+  sensino::RAMFlash<2> flash;
+  sensino::Journal journal(flash);
+  sensino::Memory<Counters> counters(journal, 0);
+  sensino::Memory<uint32_t> settings(journal, 1);
+  CHECK(!counters.read());
+  counters.content.boots = 7;
+  settings.content = 42;
+  CHECK(counters.write());
+  CHECK(settings.write());
+  unsigned long writes = flash.getWrites();
+  CHECK(counters.write());
+  CHECK_EQ(flash.getWrites(), writes);
+  sensino::Journal rebooted(flash);
+  sensino::Memory<Counters> restored(rebooted, 0);
+  CHECK_EQ(restored.content.boots, 7);
+
+  // Over the EEPROM, at a byte offset, as written by previous versions.
+  Counters stored;
+  stored.boots = 3;
+  stored.sent = 5;
+  EEPROM.put(sizeof(Counters), stored);
+  sensino::Memory<Counters> first(0);
+  sensino::Memory<Counters> second(sizeof(Counters));
+  CHECK_EQ(second.content.boots, 3);
+  CHECK_EQ(second.content.sent, 5);
+  first.content.boots = 1;
+  unsigned long commits = EEPROM.getCommits();
+  CHECK(first.write());
+  CHECK_EQ(EEPROM.getCommits(), commits + 1);
+  CHECK(second.read());
+  CHECK_EQ(second.content.boots, 3);
+}
+
+int main() {
+  testTorn();
+  testRotation();
+  testWear();
+  testMemory();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,134 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * NTPClient against simulated NTP servers: one request per call, names
+ * resolved once, and answers found late are not used.
+ *
+ */
+#include "NTPClient.h"
+
+#include <WiFiUdp.h>
+
+#include "check.hpp"
+#include "sim.hpp"
+
+sim::NtpServer a("a.ntp.test");
+sim::NtpServer b("b.ntp.test");
+sim::NtpServer c("c.ntp.test");
+
+// Error (in ms) of the client clock.
+long error(const sensino::NTPClient &client) {
+  return (long)(client.getEpochTimeMs() - sim::epochMs());
+}
+
+// Call update every period ms until the update in progress ends.
+bool finish(sensino::NTPClient &client, unsigned long period) {
+  bool success = client.update();
+  while (client.isUpdating()) {
+    delay(period);
+    success = client.update();
+  }
+  return success;
+}
+
+void testOneRequestPerCall() {
+  WiFiUDP udp;
+  sensino::NTPClient client(udp, "a.ntp.test");
+  client.addServer("b.ntp.test");
+  client.addServer("c.ntp.test");
+  sim::setDnsLatency(50);
+  unsigned long lookups = sim::dnsLookups();
+  unsigned long sent = a.received + b.received + c.received;
+
+  // A lookup blocks, but only one per call.
+  for (unsigned long n = 1; n <= 3; n++) {
+    unsigned long start = millis();
+    client.update();
+    CHECK(millis() - start <= 50);
+    CHECK_EQ(sim::dnsLookups() - lookups, n);
+    CHECK_EQ(a.received + b.received + c.received - sent, n);
+  }
+  CHECK(finish(client, 1));
+
+  // Later updates use the cached addresses.
+  client.setUpdateInterval(1000);
+  for (int n = 0; n < 5; n++) {
+    delay(client.getUpdateInterval());
+    unsigned long start = millis();
+    CHECK(finish(client, 1));
+    CHECK(millis() - start < 100);
+  }
+  CHECK_EQ(sim::dnsLookups() - lookups, 3);
+  CHECK_EQ(a.received + b.received + c.received - sent, 18);
+  sim::setDnsLatency(0);
+}
+
+void testAccuracy() {
+  a.link.latency = 40;
+  b.link.latency = 15;
+  c.link.latency = 80;
+  a.offset = 0;
+  b.offset = 0;
+  c.offset = 0;
+  WiFiUDP udp;
+  sensino::NTPClient client(udp, "a.ntp.test");
+  client.addServer("b.ntp.test");
+  client.addServer("c.ntp.test");
+  CHECK(finish(client, 1));
+  CHECK(strcmp(client.getServer(), "b.ntp.test") == 0);
+  CHECK(labs(error(client)) <= 2);
+
+  // Polled less often, the error stays within half of the delay.
+  client.setUpdateInterval(1000);
+  delay(client.getUpdateInterval());
+  CHECK(finish(client, 25));
+  CHECK(labs(error(client)) <= client.getDelay() / 2 + 1);
+  a.link.latency = b.link.latency = c.link.latency = 10;
+}
+
+void testLateAnswer() {
+  a.link.latency = 300;
+  WiFiUDP udp;
+  sensino::NTPClient client(udp, "a.ntp.test");
+  client.setTimeout(1000);
+  CHECK(client.update());
+  CHECK(client.isUpdating());
+
+  // The answer arrived 600 ms after the request but is found at 1500 ms.
+  delay(1500);
+  CHECK(!client.update());
+  CHECK(!client.isUpdating());
+  CHECK_EQ(client.getFailures(), 1);
+  CHECK_EQ(client.getCurrentEpoch(), 0);
+  a.link.latency = 10;
+}
+
+void testResolveAgain() {
+  WiFiUDP udp;
+  sensino::NTPClient client(udp, "a.ntp.test");
+  client.setUpdateInterval(1000);
+  CHECK(finish(client, 1));
+  unsigned long lookups = sim::dnsLookups();
+
+  a.down = true;
+  for (int n = 0; n < NTP_RESOLVE_AFTER; n++) {
+    delay(10000);
+    CHECK(!finish(client, 1));
+  }
+  CHECK_EQ(sim::dnsLookups(), lookups);
+  a.down = false;
+  delay(10000);
+  CHECK(finish(client, 1));
+  CHECK_EQ(sim::dnsLookups(), lookups + 1);
+}
+
+int main() {
+  WiFi.begin("ssid", "passphrase");
+  delay(1000);
+
+  testOneRequestPerCall();
+  testAccuracy();
+  testLateAnswer();
+  testResolveAgain();
+  return CHECK_RESULT();
+}
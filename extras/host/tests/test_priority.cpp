@@ -0,0 +1,121 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Priority classes: alarms go out ahead of a routine backlog, and when the
+ * buffer is full routine records are dropped, never alarms.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  int counter = 0;
+  bool alarm = false;
+
+  void fill(JsonObject &doc) const {
+    doc["c"] = this->counter;
+    doc["a"] = this->alarm;
+  }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+
+void testBuffer() {
+  sensino::PriorityBuffer<int, 4, 2> buffer;
+  for (int n = 0; n < 4; n++) {
+    CHECK(buffer.push(n, sensino::PRIORITY::ROUTINE));
+  }
+  CHECK(!buffer.push(4, sensino::PRIORITY::ROUTINE));
+  CHECK(buffer.isFull(sensino::PRIORITY::ROUTINE));
+
+  // Alarms are read first, oldest first.
+  CHECK(buffer.push(10, sensino::PRIORITY::ALARM));
+  CHECK(buffer.push(11, sensino::PRIORITY::ALARM));
+  CHECK_EQ(buffer.first(), 10);
+  CHECK_EQ(buffer[1], 11);
+  CHECK_EQ(buffer[2], 0);
+
+  // With their class full, they take the room of the oldest routine
+  // records, if allowed.
+  CHECK(!buffer.push(12, sensino::PRIORITY::ALARM));
+  CHECK(buffer.push(12, sensino::PRIORITY::ALARM, true));
+  CHECK_EQ(buffer.getEvicted(), 1);
+  CHECK_EQ(buffer.size(sensino::PRIORITY::ROUTINE), 4);
+  CHECK_EQ(buffer[2], 1);
+  CHECK_EQ(buffer[5], 12);
+
+  // Routine records never take the room of alarms.
+  buffer.shift(0, 4);
+  CHECK_EQ(buffer.size(), 2);
+  CHECK_EQ(buffer.first(), 10);
+}
+
+void testClient() {
+  sensino::Client<UserRecord, UserConfig, 20> client("http://sensino.test/", 1,
+                                                     "key", 1000);
+  static int measured = 0;
+  client.onMeasureTick([]() {
+    UserRecord record;
+    record.counter = measured;
+    record.alarm = measured % 7 == 3;
+    measured++;
+    return std::make_pair(record, true);
+  });
+  client.onClassify([](const sensino::Record<UserRecord> &record) {
+    return record.userRecord.alarm ? sensino::PRIORITY::ALARM
+                                   : sensino::PRIORITY::ROUTINE;
+  });
+  client.setRetryDelays(1000, 5000);
+
+  // 35 records while the server is down: 5 alarms and a routine backlog
+  // larger than the buffer.
+  server.down = true;
+  while (measured < 35) {
+    client.loop();
+    yield();
+  }
+  CHECK(client.getStats().bufferFull >= 9);
+  server.down = false;
+  unsigned long received = server.received;
+  unsigned long start = millis();
+  while (millis() - start < 60000) {
+    client.loop();
+    yield();
+  }
+
+  // The alarms first, then the oldest routine records.
+  std::vector<int> counters;
+  for (unsigned long n = received; n < server.received; n++) {
+    DynamicJsonDocument doc(1024);
+    CHECK(!deserializeJson(doc, server.requests[n].body.c_str()));
+    counters.push_back(doc["userRecord"]["c"].as<int>());
+  }
+  CHECK(counters.size() >= 25);
+  for (int n = 0; n < 5; n++) {
+    CHECK_EQ(counters[n], 3 + 7 * n);
+  }
+  CHECK_EQ(counters[5], 0);
+  CHECK_EQ(counters[6], 1);
+  CHECK_EQ(counters[7], 2);
+  CHECK_EQ(counters[8], 4);
+  // No record measured during the outage beyond the 20 routine ones and
+  // the alarms.
+  for (size_t n = 0; n < counters.size(); n++) {
+    CHECK(counters[n] < 35 ? n < 25 : n >= 25);
+  }
+}
+
+int main() {
+  WiFi.begin("ssid", "passphrase");
+  delay(1000);
+
+  testBuffer();
+  testClient();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,136 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Connections and radio on time of the flush policies: each record sent
+ * on its own keeps the radio on, bursts let it sleep in between. While the
+ * WiFi is down, bursts give up and back off instead of keeping it on.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  int counter = 0;
+
+  void fill(JsonObject &doc) const { doc["c"] = this->counter; }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+
+// Connections, wakes and radio on time over a phase.
+struct Phase {
+  unsigned long connections;
+  unsigned long wakes;
+  unsigned long long radioOnMs;
+  unsigned long records;
+  unsigned long longestWait; // In ms, from measure to the server.
+};
+
+sensino::Client<UserRecord, UserConfig, 40> client("http://sensino.test/", 1,
+                                                   "key", 1000);
+int counter = 0;
+std::map<int, unsigned long> measuredAt;
+
+Phase run(unsigned long duration) {
+  Phase phase = {server.connections, sim::radioWakes(), sim::radioOnMs(), 0,
+                 0};
+  unsigned long received = server.received;
+  unsigned long start = millis();
+  while (millis() - start < duration) {
+    client.loop();
+    yield();
+  }
+  for (unsigned long n = received; n < server.received; n++) {
+    DynamicJsonDocument doc(1024);
+    if (deserializeJson(doc, server.requests[n].body.c_str()) ||
+        !doc.containsKey("userRecord")) {
+      continue;
+    }
+    int value = doc["userRecord"]["c"].as<int>();
+    unsigned long at = server.requests[n].at / 1000;
+    phase.longestWait = std::max(phase.longestWait, at - measuredAt[value]);
+    phase.records++;
+  }
+  phase.connections = server.connections - phase.connections;
+  phase.wakes = sim::radioWakes() - phase.wakes;
+  phase.radioOnMs = sim::radioOnMs() - phase.radioOnMs;
+  return phase;
+}
+
+int main() {
+  client.onMeasureTick([]() {
+    UserRecord record;
+    record.counter = counter;
+    measuredAt[counter++] = millis();
+    return std::make_pair(record, true);
+  });
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+  run(10000);
+
+  // Each record as soon as possible, over a kept alive connection.
+  Phase eager = run(600000);
+  CHECK(eager.records >= 595);
+  CHECK(eager.connections <= 1);
+  CHECK_EQ(eager.wakes, 0);
+  CHECK(eager.radioOnMs >= 599000);
+  CHECK(eager.longestWait < 1000);
+
+  // Bursts of 30 records, the radio sleeps in between.
+  client.setFlushPolicy(30, 0);
+  client.setRadioSleep(true);
+  Phase watermark = run(600000);
+  CHECK(watermark.records >= 570);
+  CHECK(watermark.wakes >= 19 && watermark.wakes <= 21);
+  CHECK_EQ(watermark.connections, watermark.wakes);
+  CHECK(watermark.radioOnMs < eager.radioOnMs / 10);
+  CHECK(watermark.longestWait < 31000);
+
+  // A deadline bounds the wait when the watermark is far.
+  client.setFlushPolicy(40, 10000);
+  Phase deadline = run(600000);
+  CHECK(deadline.records >= 580);
+  CHECK(deadline.wakes >= 50 && deadline.wakes <= 61);
+  CHECK_EQ(deadline.connections, deadline.wakes);
+  CHECK(deadline.radioOnMs < eager.radioOnMs / 5);
+  CHECK(deadline.longestWait < 10000 + 2000);
+
+  // The access point is gone for 10 minutes.
+  client.setFlushPolicy(10, 0);
+  client.setIdleSleep(true);
+  uint32_t loops = client.getStats().loop.count();
+  uint32_t errors = client.getStats().sendErrors;
+  sim::setWifiDown(true);
+  Phase outage = run(600000);
+  sim::setWifiDown(false);
+  loops = client.getStats().loop.count() - loops;
+  errors = client.getStats().sendErrors - errors;
+  CHECK_EQ(outage.records, 0);
+  CHECK(outage.radioOnMs < 150000);
+  CHECK(loops < 20000);
+  CHECK(errors >= 5 && errors <= 20);
+
+  // Then the backlog goes within the longest retry delay.
+  Phase recovery = run(600000);
+  CHECK(recovery.records >= 400);
+  CHECK(recovery.longestWait < 600000 + 300000);
+  printf("outage: %u loops, %u errors, radio on %llu ms\n", loops, errors,
+         outage.radioOnMs);
+
+  printf("%-10s %8s %6s %12s %8s\n", "policy", "records", "wakes",
+         "radio on ms", "wait ms");
+  for (auto item : {std::make_pair("eager", eager),
+                    std::make_pair("watermark", watermark),
+                    std::make_pair("deadline", deadline)}) {
+    printf("%-10s %8lu %6lu %12llu %8lu\n", item.first, item.second.records,
+           item.second.wakes, item.second.radioOnMs, item.second.longestWait);
+  }
+  return CHECK_RESULT();
+}
@@ -0,0 +1,79 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * The documented Scheduler setup: the time client runs as its own task,
+ * so a time update is not paced by the measure period and the scheduler
+ * still sleeps between its samples.
+ *
+ */
+#include "client.hpp"
+#include "scheduler.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  int counter = 0;
+
+  void fill(JsonObject &doc) const { doc["c"] = this->counter; }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+sim::HttpServer timeServer("time.test");
+
+sensino::Client<UserRecord, UserConfig, 10> client("http://sensino.test/", 1,
+                                                   "key", 60000);
+sensino::Scheduler scheduler;
+int counter = 0;
+
+int main() {
+  timeServer.log = false;
+  timeServer.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    unsigned long long epochMs = sim::epochMs(request.at);
+    response.body = std::to_string(epochMs / 1000) + "." +
+                    std::to_string(epochMs % 1000 + 1000).substr(1);
+    return response;
+  });
+  sensino::timeClient.begin("http://time.test/");
+
+  client.onMeasureTick([]() {
+    UserRecord record;
+    record.counter = counter++;
+    return std::make_pair(record, true);
+  });
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  client.setTimeSyncTask(true);
+  int clientTask = scheduler.add("client", [] { return client.run(); });
+  int timeTask = scheduler.add("time", [] { return client.runTimeSync(); });
+  scheduler.setSleep(true, 60000);
+
+  // The update runs to the end between two measures, sleeping between
+  // the samples rather than spinning: a run of the time task per sample.
+  while (sensino::timeClient.getCurrentEpoch() == 0) {
+    scheduler.loop();
+    yield();
+  }
+  CHECK(sensino::timeClient.getSyncStats().max() < 5000);
+  CHECK(scheduler.getTime(timeTask).count() <= timeServer.received + 2);
+  CHECK(scheduler.getTime(clientTask).count() < 1000);
+
+  // Then the tasks sleep until the next measure or update.
+  unsigned long start = millis();
+  unsigned long slept = scheduler.getSlept();
+  while (millis() - start < 600000) {
+    scheduler.loop();
+    yield();
+  }
+  CHECK(counter >= 10);
+  CHECK(scheduler.getTime(timeTask).count() <= timeServer.received + 2);
+  CHECK(scheduler.getSlept() - slept > 590000);
+  return CHECK_RESULT();
+}
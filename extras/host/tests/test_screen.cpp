@@ -0,0 +1,178 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Screen updates: only the tiles (8x8 pixels) that changed since the last
+ * send are pushed to the display, and animations render their frames on
+ * time, sending only the rows that move.
+ *
+ */
+#include "screen.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+// Bytes pushed to each row of tiles, to count those pushed afterwards.
+struct Bus {
+  unsigned long rows[U8G2_HEIGHT / 8];
+
+  Bus(const U8G2 &u8g2) {
+    for (uint8_t row = 0; row < U8G2_HEIGHT / 8; row++) {
+      this->rows[row] = u8g2.getBusBytes(row);
+    }
+  }
+
+  unsigned long since(const U8G2 &u8g2, uint8_t row) const {
+    return u8g2.getBusBytes(row) - this->rows[row];
+  }
+};
+
+void testDirtyTiles() {
+  sensino::Screen screen;
+  screen.setup();
+
+  // The first frame is sent whole.
+  screen.rows3("Temperature", "20.5 C", "OK");
+  CHECK_EQ(screen.u8g2.getBusBytes(), SCREEN_BUFFER_SIZE);
+  CHECK_EQ(screen.u8g2.getTransfers(), 1);
+
+  // The same content again sends nothing.
+  screen.rows3("Temperature", "20.5 C", "OK");
+  CHECK_EQ(screen.u8g2.getBusBytes(), SCREEN_BUFFER_SIZE);
+  CHECK_EQ(screen.u8g2.getTransfers(), 1);
+
+  // One glyph of the second row (pixels 28 to 39, tile rows 3 and 4) is
+  // the tile of its column in each: 16 bytes in 2 transfers.
+  Bus bus(screen.u8g2);
+  screen.rows3("Temperature", "20.6 C", "OK");
+  CHECK_EQ(screen.u8g2.getBusBytes(), SCREEN_BUFFER_SIZE + 16);
+  CHECK_EQ(screen.u8g2.getTransfers(), 3);
+  for (uint8_t row = 0; row < U8G2_HEIGHT / 8; row++) {
+    unsigned long sent = bus.since(screen.u8g2, row);
+    CHECK_EQ(sent, row == 3 || row == 4 ? 8 : 0);
+  }
+
+  // Two glyphs apart: the span between them, 4 tiles per row.
+  Bus span(screen.u8g2);
+  screen.rows3("Temperature", "30.7 C", "OK");
+  CHECK_EQ(span.since(screen.u8g2, 3), 32);
+  CHECK_EQ(span.since(screen.u8g2, 4), 32);
+  CHECK_EQ(screen.u8g2.getBusBytes(), SCREEN_BUFFER_SIZE + 16 + 64);
+
+  // The count of the Screen is what went on the bus.
+  CHECK_EQ(screen.getBytesSent(), screen.u8g2.getBusBytes());
+
+  // Everything again once invalidated.
+  screen.invalidate();
+  screen.rows3("Temperature", "30.7 C", "OK");
+  CHECK_EQ(screen.u8g2.getBusBytes(), 2 * SCREEN_BUFFER_SIZE + 16 + 64);
+}
+
+// Same frame as rows3, with the second row moved by offset pixels.
+bool isShifted(sensino::Screen &screen, int offset) {
+  U8G2 expected;
+  expected.setFont(u8g2_font_crox3tb_tf);
+  expected.drawStr(0, 20, "Temperature");
+  expected.drawStr(offset, 40, "20.5 C");
+  expected.drawStr(0, 60, "OK");
+  return memcmp(expected.getBufferPtr(), screen.u8g2.getBufferPtr(),
+                SCREEN_BUFFER_SIZE) == 0;
+}
+
+void testScroll() {
+  sensino::Screen screen;
+  screen.setup();
+  screen.rows3("Temperature", "20.5 C", "OK");
+
+  // The second row moves by a pixel every 50 ms, 10 times. The first
+  // frame is the screen as it is, and sends nothing.
+  unsigned long start = millis();
+  screen.scroll("Temperature", "20.5 C", "OK", 50, 10, SCREEN_ROW2);
+  CHECK_EQ(screen.u8g2.getTransfers(), 1);
+  unsigned long wait = screen.run();
+  CHECK_EQ(wait, 50);
+  delay(20);
+  wait = screen.run();
+  CHECK_EQ(wait, 30);
+
+  // Then a frame on time at each period, sending the tiles of that row
+  // only.
+  Bus bus(screen.u8g2);
+  std::vector<unsigned long> frames;
+  while (millis() - start < 1000) {
+    unsigned long transfers = screen.u8g2.getTransfers();
+    screen.loop();
+    if (screen.u8g2.getTransfers() != transfers) {
+      frames.push_back(millis() - start);
+    }
+    delay(1);
+  }
+  CHECK_EQ(frames.size(), 10);
+  for (size_t n = 0; n < frames.size(); n++) {
+    CHECK_EQ(frames[n], 50 * (n + 1));
+  }
+  CHECK(!screen.isAnimating());
+  wait = screen.run();
+  CHECK_EQ(wait, SCREEN_IDLE_PERIOD);
+  CHECK(isShifted(screen, -10));
+  for (uint8_t row = 0; row < U8G2_HEIGHT / 8; row++) {
+    unsigned long sent = bus.since(screen.u8g2, row);
+    CHECK(row == 3 || row == 4 ? sent > 0 : sent == 0);
+  }
+
+  // A late loop skips to the frame due.
+  screen.rows3("Temperature", "20.5 C", "OK");
+  screen.scroll("Temperature", "20.5 C", "OK", 50, 10, SCREEN_ROW2);
+  delay(175);
+  unsigned long transfers = screen.u8g2.getTransfers();
+  screen.loop();
+  CHECK_EQ(screen.u8g2.getTransfers(), transfers + 2);
+  CHECK(isShifted(screen, -3));
+  screen.loop();
+  CHECK_EQ(screen.u8g2.getTransfers(), transfers + 2);
+
+  // Drawing another screen stops it.
+  screen.rows3("Temperature", "20.5 C", "OK");
+  CHECK(!screen.isAnimating());
+  transfers = screen.u8g2.getTransfers();
+  delay(100);
+  screen.loop();
+  CHECK_EQ(screen.u8g2.getTransfers(), transfers);
+}
+
+void testBlink() {
+  sensino::Screen screen;
+  screen.setup();
+  screen.rows3("Temperature", "20.5 C", "OK");
+
+  // The third row (tile rows 6 and 7) is hidden and shown every 500 ms,
+  // twice: each frame after the first sends its 2 glyphs in both rows.
+  Bus bus(screen.u8g2);
+  unsigned long start = millis();
+  screen.blink("Temperature", "20.5 C", "OK", 500, 2, SCREEN_ROW3);
+  std::vector<unsigned long> frames;
+  while (screen.isAnimating()) {
+    unsigned long transfers = screen.u8g2.getTransfers();
+    screen.loop();
+    if (screen.u8g2.getTransfers() != transfers) {
+      frames.push_back(millis() - start);
+    }
+    delay(1);
+  }
+  CHECK_EQ(frames.size(), 4);
+  for (size_t n = 0; n < frames.size(); n++) {
+    CHECK_EQ(frames[n], 500 * (n + 1));
+  }
+  for (uint8_t row = 0; row < U8G2_HEIGHT / 8; row++) {
+    unsigned long sent = bus.since(screen.u8g2, row);
+    CHECK_EQ(sent, row >= 6 ? 4 * 16 : 0);
+  }
+  // Shown at the end.
+  CHECK(isShifted(screen, 0));
+}
+
+int main() {
+  testDirtyTiles();
+  testScroll();
+  testBlink();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,153 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Records are spooled to flash during an outage longer than the buffer
+ * lasts, and all of them reach the server, in order, once it is back.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+#include <set>
+
+struct UserRecord {
+  int counter = 0;
+
+  void fill(JsonObject &doc) const { doc["n"] = this->counter; }
+};
+
+struct OtherRecord {
+  int counter = 0;
+  float value = 0;
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+#define BS 10
+#define ACQ_PERIOD 1000
+
+typedef sensino::Record<UserRecord> StoredRecord;
+
+// A spool of another record type on the same flash finds nothing to read,
+// and reuses the sectors.
+void testFormat() {
+  sensino::RAMFlash<4> flash;
+  sensino::Spool<StoredRecord> spool(flash);
+  spool.begin();
+  StoredRecord record = {};
+  for (int n = 0; n < 10; n++) {
+    record.userRecord.counter = n;
+    CHECK(spool.push(record));
+  }
+
+  sensino::Spool<StoredRecord> same(flash);
+  same.begin();
+  CHECK_EQ(same.size(), 10);
+
+  sensino::Spool<sensino::Record<OtherRecord>> other(flash);
+  other.begin();
+  CHECK_EQ(other.size(), 0);
+  sensino::Record<OtherRecord> otherRecord = {};
+  otherRecord.userRecord.counter = 42;
+  CHECK(other.push(otherRecord));
+
+  other.begin();
+  CHECK_EQ(other.size(), 1);
+  CHECK(other.shift(otherRecord));
+  CHECK_EQ(otherRecord.userRecord.counter, 42);
+
+  // The old type is gone as well, its sector was reused.
+  same.begin();
+  CHECK_EQ(same.size(), 0);
+}
+
+void testOutage() {
+  sim::HttpServer server("sensino.test");
+  sim::HttpServer timeServer("time.test");
+  timeServer.log = false;
+  timeServer.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    response.body = std::to_string(sim::epochMs(request.at) / 1000);
+    return response;
+  });
+  sensino::timeClient.begin("http://time.test/");
+
+  sensino::RAMFlash<4> flash;
+  sensino::Spool<StoredRecord> spool(flash);
+  spool.begin();
+
+  sensino::Client<UserRecord, UserConfig, BS> client("http://sensino.test/", 1,
+                                                     "key", ACQ_PERIOD);
+  int counter = 0;
+  client.onMeasureTick([&counter]() {
+    UserRecord record;
+    record.counter = counter++;
+    return std::make_pair(record, true);
+  });
+  client.setSpool(&spool);
+  client.setRetryDelays(1000, 10000);
+
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  // The outage lasts 6 times what the buffer holds.
+  server.down = true;
+  unsigned long start = millis();
+  unsigned long spooled = 0;
+  while (millis() - start < 6 * BS * ACQ_PERIOD) {
+    client.loop();
+    yield();
+    if (spool.size() > spooled) {
+      spooled = spool.size();
+    }
+  }
+  CHECK(client.isBufferFull());
+  CHECK(spooled >= 4 * BS);
+
+  // Inspect the flash: the spooled records follow the buffered ones.
+  sensino::Spool<StoredRecord> inspect(flash);
+  inspect.begin();
+  CHECK_EQ(inspect.size(), spool.size());
+  StoredRecord first;
+  CHECK(inspect.first(first));
+  CHECK_EQ(first.userRecord.counter, BS);
+  CHECK(flash.getErases() >= 1);
+
+  server.down = false;
+  start = millis();
+  while (millis() - start < 60000 && (!spool.isEmpty() || server.received <
+                                                             (size_t)counter)) {
+    client.loop();
+    yield();
+  }
+
+  // No record lost, none repeated, in order.
+  CHECK(spool.isEmpty());
+  CHECK_EQ(client.getStats().bufferFull, 0);
+  std::set<int> received;
+  int last = -1;
+  bool ordered = true;
+  for (const sim::HttpRequest &request : server.requests) {
+    DynamicJsonDocument doc(512);
+    deserializeJson(doc, request.body.c_str());
+    int n = doc["userRecord"]["n"].as<int>();
+    ordered = ordered && n > last;
+    last = n;
+    received.insert(n);
+  }
+  CHECK(ordered);
+  CHECK_EQ(received.size(), server.requests.size());
+  CHECK_EQ(received.size(), (size_t)counter);
+  CHECK_EQ(*received.rbegin(), counter - 1);
+}
+
+int main() {
+  testFormat();
+  testOutage();
+  return CHECK_RESULT();
+}
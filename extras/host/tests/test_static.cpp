@@ -0,0 +1,147 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * With SENSINO_STATIC, the storage does not grow with the buffer size
+ * beyond the records themselves, the loop does not allocate, and a record
+ * too large for the batch document is dropped rather than blocking the
+ * queue.
+ *
+ */
+#define SENSINO_STATIC
+
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  float temperature = 0;
+  int humidity = 0;
+
+  void fill(JsonObject &doc) const {
+    doc["t"] = this->temperature;
+    doc["h"] = this->humidity;
+  }
+};
+
+struct UserConfig {
+  int mode = 1;
+
+  void fill(JsonDocument &doc) const { doc["mode"] = this->mode; }
+};
+
+// A record with as many fields as asked, to outgrow the batch document.
+struct WideRecord {
+  int fields = 1;
+
+  void fill(JsonObject &doc) const {
+    for (int n = 0; n < this->fields; n++) {
+      doc[String("field") + String(n)] = n;
+    }
+  }
+};
+
+typedef sensino::Client<UserRecord, UserConfig, 10> SmallClient;
+typedef sensino::Client<UserRecord, UserConfig, 40> LargeClient;
+
+sim::HttpServer server("sensino.test");
+
+int count = 0;
+
+std::pair<UserRecord, bool> measure() {
+  UserRecord record;
+  record.temperature = 20.5;
+  record.humidity = count++;
+  return std::make_pair(record, true);
+}
+
+void testSize() {
+  // 30 more routine records and 7 more alarms.
+  size_t records = (40 - 10 + 10 - 3) * sizeof(sensino::Record<UserRecord>);
+  CHECK(sizeof(LargeClient) - sizeof(SmallClient) <= records + 64);
+}
+
+void testNoAllocation() {
+  static LargeClient client("http://sensino.test/", 7, "key", 1000);
+  client.onMeasureTick(measure);
+  client.setBatchBytes(2 * SENSINO_BATCH_BYTES);
+  CHECK(client.getBatchBytes() < SENSINO_BATCH_BYTES);
+  client.setFlushPolicy(30, 0);
+
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  // Warm up: connect, sync the clock and send a couple of batches.
+  unsigned long received = server.received;
+  while (server.received < received + 2) {
+    client.loop();
+    yield();
+  }
+
+  // The device info fits in the body buffer.
+  CHECK(client._serializeDeviceInfo());
+
+  unsigned long allocations = sim::allocations();
+  received = server.received;
+  unsigned long start = millis();
+  while (millis() - start < 120000) {
+    client.loop();
+    yield();
+  }
+  CHECK(server.received >= received + 3);
+  CHECK_EQ(sim::allocations(), allocations);
+
+  // Batches fit in the body buffer.
+  for (unsigned long n = received; n < server.received; n++) {
+    CHECK(server.requests[n].body.size() < SENSINO_BATCH_BYTES);
+  }
+}
+
+void testOversized() {
+  static sensino::Client<WideRecord, UserConfig, 10> client(
+      "http://sensino.test/", 7, "key", 1000);
+  static int measured = 0;
+  client.onMeasureTick([]() {
+    WideRecord record;
+    record.fields = measured++ == 0 ? 200 : 2;
+    return std::make_pair(record, true);
+  });
+  client.setFlushPolicy(1, 0);
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  client.setup(ssid, passphrase);
+
+  unsigned long received = server.received;
+  unsigned long start = millis();
+  while (millis() - start < 30000) {
+    client.loop();
+    yield();
+  }
+
+  // The first record is dropped, the next ones follow.
+  CHECK_EQ(client.getStats().oversized, 1);
+  CHECK(server.received - received >= 25);
+  CHECK(client.getStats().sendErrors <= 1);
+  for (unsigned long n = received; n < server.received; n++) {
+    CHECK(server.requests[n].body.find("field199") == std::string::npos);
+  }
+}
+
+int main() {
+  sim::HttpServer timeServer("time.test");
+  timeServer.log = false;
+  timeServer.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    unsigned long long epochMs = sim::epochMs(request.at);
+    response.body = std::to_string(epochMs / 1000) + "." +
+                    std::to_string(epochMs % 1000 + 1000).substr(1);
+    return response;
+  });
+  sensino::timeClient.begin("http://time.test/");
+
+  testSize();
+  testNoAllocation();
+  testOversized();
+  return CHECK_RESULT();
+}
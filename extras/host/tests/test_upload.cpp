@@ -0,0 +1,123 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Upload keeps the resolved address across failures, does not block on
+ * the network, and reports answers longer than UPLOAD_PAYLOAD_SIZE.
+ *
+ */
+#include "client.hpp"
+
+#include "check.hpp"
+#include "sim.hpp"
+
+struct UserRecord {
+  int value = 0;
+
+  void fill(JsonObject &doc) const { doc["v"] = this->value; }
+};
+
+struct UserConfig {
+  void fill(JsonDocument &doc) const {}
+};
+
+sim::HttpServer server("sensino.test");
+
+// Run a request to the end.
+sensino::UPLOAD_STATE run(sensino::Upload &upload, const char *body) {
+  upload.start("", 0, body, strlen(body));
+  while (!upload.isFinished()) {
+    upload.step(2000);
+    yield();
+  }
+  sensino::UPLOAD_STATE state = upload.getState();
+  upload.reset();
+  return state;
+}
+
+void testResolve() {
+  sim::setDnsLatency(500);
+  sensino::Upload upload;
+  upload.begin("http://sensino.test/");
+  CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::DONE);
+  unsigned long lookups = sim::dnsLookups();
+
+  // Retries against a dead server do not resolve the name each time.
+  server.down = true;
+  for (int n = 0; n < UPLOAD_RESOLVE_AFTER - 1; n++) {
+    CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::ERROR);
+  }
+  CHECK_EQ(sim::dnsLookups(), lookups);
+
+  // But do after many of them, in case the address changed.
+  CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::ERROR);
+  CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::ERROR);
+  CHECK_EQ(sim::dnsLookups(), lookups + 1);
+
+  server.down = false;
+  CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::DONE);
+  CHECK_EQ(sim::dnsLookups(), lookups + 1);
+  sim::setDnsLatency(0);
+}
+
+void testNonBlocking() {
+  server.link.latency = 200;
+  sensino::Upload upload;
+  upload.begin("http://sensino.test/");
+  CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::DONE);
+
+  // Over the open connection, steps return without waiting.
+  upload.start("", 0, "{}", 2);
+  unsigned long longest = 0;
+  unsigned long steps = 0;
+  while (!upload.isFinished()) {
+    unsigned long start = micros();
+    upload.step(2000);
+    longest = std::max(longest, micros() - start);
+    steps++;
+    delay(1);
+  }
+  CHECK(upload.getState() == sensino::UPLOAD_STATE::DONE);
+  CHECK(longest < 2000);
+  CHECK(steps >= 400);
+  upload.reset();
+  server.link.latency = 10;
+}
+
+void testTruncated() {
+  server.onRequest([](const sim::HttpRequest &request) {
+    sim::HttpResponse response;
+    response.body = "{\"acqPeriod\": 5000, \"padding\": \"" +
+                    std::string(UPLOAD_PAYLOAD_SIZE, 'x') + "\"}";
+    return response;
+  });
+  sensino::Upload upload;
+  upload.begin("http://sensino.test/");
+  CHECK(run(upload, "{}") == sensino::UPLOAD_STATE::DONE);
+  CHECK(upload.isTruncated());
+  CHECK_EQ(upload.getPayloadLength(), UPLOAD_PAYLOAD_SIZE - 1);
+
+  // The Client ignores it rather than acting on part of it.
+  sensino::Client<UserRecord, UserConfig, 4> client("http://sensino.test/", 1,
+                                                    "key", 1000);
+  sensino::Record<UserRecord> record = {};
+  CHECK(client.sendRecord(record));
+  CHECK_EQ(client.getStats().truncated, 1);
+
+  server.onRequest(nullptr);
+  CHECK(client.sendDeviceInfo());
+  DynamicJsonDocument doc(2048);
+  CHECK(!deserializeJson(doc, server.requests.back().body.c_str()));
+  CHECK_EQ(doc["stats"]["truncated"].as<int>(), 1);
+}
+
+int main() {
+  char ssid[] = "ssid";
+  char passphrase[] = "passphrase";
+  WiFi.begin(ssid, passphrase);
+  delay(1000);
+
+  testResolve();
+  testNonBlocking();
+  testTruncated();
+  return CHECK_RESULT();
+}
@@ -0,0 +1,151 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Sector based access to raw flash.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#define SENSINO_SECTOR_SIZE 4096
+
+namespace sensino {
+
+/**
+ * A region of flash made of consecutive sectors.
+ *
+ * Sectors are addressed relative to the start of the region.
+ * Offsets and sizes must be multiples of 4 bytes.
+ *
+ * Flash bits can only go from 1 to 0 when writing,
+ * and erasing a sector sets all its bytes to 0xFF.
+ *
+ * Erase and write operations are counted to monitor wear.
+ */
+class Flash {
+
+protected:
+  unsigned long _erases = 0;
+  unsigned long _writes = 0;
+
+public:
+  virtual ~Flash() {}
+
+  // Number of sectors in the region.
+  virtual uint32_t sectors() const = 0;
+
+  virtual bool read(uint32_t sector, uint32_t offset, uint32_t *data,
+                    size_t size) = 0;
+
+  virtual bool write(uint32_t sector, uint32_t offset, const uint32_t *data,
+                     size_t size) = 0;
+
+  virtual bool erase(uint32_t sector) = 0;
+
+  unsigned long getErases() const { return this->_erases; }
+
+  unsigned long getWrites() const { return this->_writes; }
+};
+
+/**
+ * Flash region kept in RAM.
+ *
+ * Behaves like real flash (writes can only clear bits)
+ * and can be used to run and inspect the flash based classes
+ * in a host build.
+ *
+ * It is generic over:
+ * - N: number of sectors.
+ */
+template <uint32_t N> class RAMFlash : public Flash {
+
+public:
+  uint8_t content[N][SENSINO_SECTOR_SIZE];
+
+  RAMFlash() { memset(this->content, 0xFF, sizeof(this->content)); }
+
+  uint32_t sectors() const { return N; }
+
+  bool read(uint32_t sector, uint32_t offset, uint32_t *data, size_t size) {
+    if (sector >= N || offset + size > SENSINO_SECTOR_SIZE) {
+      return false;
+    }
+    memcpy(data, &this->content[sector][offset], size);
+    return true;
+  }
+
+  bool write(uint32_t sector, uint32_t offset, const uint32_t *data,
+             size_t size) {
+    if (sector >= N || offset + size > SENSINO_SECTOR_SIZE) {
+      return false;
+    }
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (size_t n = 0; n < size; n++) {
+      this->content[sector][offset + n] &= bytes[n];
+    }
+    this->_writes++;
+    return true;
+  }
+
+  bool erase(uint32_t sector) {
+    if (sector >= N) {
+      return false;
+    }
+    memset(this->content[sector], 0xFF, SENSINO_SECTOR_SIZE);
+    this->_erases++;
+    return true;
+  }
+};
+
+#if defined(ESP8266)
+/**
+ * Flash region in the ESP8266 SPI flash.
+ *
+ * The region must not overlap with the sketch, the EEPROM emulation
+ * or a file system in use (e.g. use the area reserved to the FS).
+ */
+class ESPFlash : public Flash {
+
+private:
+  // First sector of the region (absolute).
+  uint32_t _first;
+
+  // Number of sectors in the region.
+  uint32_t _count;
+
+public:
+  ESPFlash(uint32_t first, uint32_t count) : _first(first), _count(count) {}
+
+  uint32_t sectors() const { return this->_count; }
+
+  bool read(uint32_t sector, uint32_t offset, uint32_t *data, size_t size) {
+    if (sector >= this->_count) {
+      return false;
+    }
+    return ESP.flashRead((this->_first + sector) * SENSINO_SECTOR_SIZE + offset,
+                         data, size);
+  }
+
+  bool write(uint32_t sector, uint32_t offset, const uint32_t *data,
+             size_t size) {
+    if (sector >= this->_count) {
+      return false;
+    }
+    this->_writes++;
+    return ESP.flashWrite(
+        (this->_first + sector) * SENSINO_SECTOR_SIZE + offset,
+        const_cast<uint32_t *>(data), size);
+  }
+
+  bool erase(uint32_t sector) {
+    if (sector >= this->_count) {
+      return false;
+    }
+    this->_erases++;
+    return ESP.flashEraseSector(this->_first + sector);
+  }
+};
+#endif
+
+} // namespace sensino
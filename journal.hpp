@@ -0,0 +1,387 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Log structured store of small records in flash.
+ *
+ */
+#pragma once
+
+#include "flash.hpp"
+#include "stats.hpp"
+
+#define JOURNAL_MAGIC 0x4C4E524AUL // "JRNL"
+#define JOURNAL_EMPTY 0xFFFFFFFFUL
+
+// Number of slots (record ids) of a journal.
+#ifndef JOURNAL_MAX_SLOTS
+#define JOURNAL_MAX_SLOTS 8
+#endif
+
+namespace sensino {
+
+/**
+ * Persistent store of a few records (slots), each one identified by an id.
+ *
+ * Writing a slot appends a new copy of it at the end of the current (head)
+ * sector, so a sector is erased only once every time the whole region has
+ * been filled, and erases are spread evenly over the region. Writing
+ * the same content again does nothing.
+ *
+ * Sectors are used in a ring. When the head is full, the next sector is
+ * erased and becomes the head, and the slots still living in the sector
+ * after it (the oldest one) are copied to the new head. That one is then
+ * free, to be erased by the next rotation.
+ *
+ * Sector layout:
+ * - magic (4 bytes)
+ * - sequence number (4 bytes), increases with each new sector.
+ * - entries:
+ *   - id (2 bytes, high half) and length in bytes (2 bytes, low half).
+ *   - sequence number (4 bytes), increases with each entry.
+ *   - data, padded to 4 bytes.
+ *   - CRC32 of all the above.
+ *
+ * The CRC is written last, so an interrupted write is discarded
+ * when read back. At boot the valid copy with the highest sequence number
+ * of each slot is used, and an interrupted rotation is completed.
+ *
+ * A region needs at least two sectors, and all the slots together
+ * (with 12 bytes of overhead each) must fit in half a sector.
+ *
+ * Call begin() before using it, otherwise it is called on first use.
+ */
+class Journal {
+
+private:
+  static const uint32_t _headerSize = 8;
+  static const size_t _chunkWords = 16;
+
+  // Location and checksum of the newest copy of a slot.
+  struct Slot {
+    bool valid;
+    uint32_t sector;
+    uint32_t offset;
+    uint16_t length;
+    uint32_t seq;
+    uint32_t hash; // CRC32 of the data
+  };
+
+  Flash *_flash;
+  bool _begun = false;
+
+  // Sector and offset where the next entry will be written.
+  uint32_t _head = 0;
+  uint32_t _headSeq = 0;
+  uint32_t _offset = SENSINO_SECTOR_SIZE;
+
+  // Sequence number of the last entry.
+  uint32_t _seq = 0;
+
+  Slot _slots[JOURNAL_MAX_SLOTS];
+
+  uint32_t _chunk[_chunkWords];
+
+  // Sectors whose slots were copied to make room, and time (in us)
+  // taken by each write.
+  unsigned long _compactions = 0;
+  Histogram _writeStats;
+
+  static uint32_t _crc(uint32_t crc, const void *data, size_t size) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (size_t n = 0; n < size; n++) {
+      crc ^= bytes[n];
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+      }
+    }
+    return crc;
+  }
+
+  // Size in bytes of an entry with length bytes of data.
+  static uint32_t _size(uint16_t length) {
+    return 12 + ((uint32_t)length + 3) / 4 * 4;
+  }
+
+  // Check the CRC of an entry, and compute the CRC of its data.
+  bool _check(uint32_t sector, uint32_t offset, const uint32_t *head,
+              uint32_t &hash) {
+    uint16_t length = head[0] & 0xFFFF;
+    uint32_t crc = _crc(0xFFFFFFFFUL, head, 8);
+    hash = 0xFFFFFFFFUL;
+    for (uint32_t done = 0; done < length; done += sizeof(this->_chunk)) {
+      uint32_t size = length - done;
+      if (size > sizeof(this->_chunk)) {
+        size = sizeof(this->_chunk);
+      }
+      this->_flash->read(sector, offset + 8 + done, this->_chunk,
+                         (size + 3) / 4 * 4);
+      crc = _crc(crc, this->_chunk, size);
+      hash = _crc(hash, this->_chunk, size);
+    }
+    hash ^= 0xFFFFFFFFUL;
+    uint32_t stored = 0;
+    this->_flash->read(sector, offset + _size(length) - 4, &stored, 4);
+    return stored == (crc ^ 0xFFFFFFFFUL);
+  }
+
+  // Index the valid entries of a sector.
+  // return the offset after the last entry.
+  uint32_t _scan(uint32_t sector) {
+    uint32_t offset = _headerSize;
+    while (offset + 12 <= SENSINO_SECTOR_SIZE) {
+      uint32_t head[2];
+      this->_flash->read(sector, offset, head, sizeof(head));
+      if (head[0] == JOURNAL_EMPTY) {
+        break;
+      }
+      uint16_t id = head[0] >> 16;
+      uint16_t length = head[0] & 0xFFFF;
+      uint32_t size = _size(length);
+      if (offset + size > SENSINO_SECTOR_SIZE) {
+        // Broken header, nothing more can be written here.
+        return SENSINO_SECTOR_SIZE;
+      }
+      uint32_t hash;
+      if (id < JOURNAL_MAX_SLOTS && this->_check(sector, offset, head, hash)) {
+        Slot &slot = this->_slots[id];
+        if (!slot.valid || head[1] > slot.seq) {
+          slot = {true, sector, offset, length, head[1], hash};
+        }
+        if (head[1] > this->_seq) {
+          this->_seq = head[1];
+        }
+      }
+      offset += size;
+    }
+    return offset;
+  }
+
+  // Write the header of an entry at the head, and move the head past it.
+  // return the offset of the entry.
+  uint32_t _append(uint16_t id, uint16_t length, uint32_t &crc) {
+    uint32_t offset = this->_offset;
+    this->_offset += _size(length);
+    uint32_t head[2] = {((uint32_t)id << 16) | length, ++this->_seq};
+    this->_flash->write(this->_head, offset, head, sizeof(head));
+    crc = _crc(0xFFFFFFFFUL, head, sizeof(head));
+    return offset;
+  }
+
+  // Write the CRC of an entry and point its slot to it.
+  bool _commit(uint16_t id, uint32_t offset, uint16_t length, uint32_t crc,
+               uint32_t hash) {
+    crc ^= 0xFFFFFFFFUL;
+    if (!this->_flash->write(this->_head, offset + _size(length) - 4, &crc,
+                             4)) {
+      return false;
+    }
+    this->_slots[id] = {true, this->_head, offset, length, this->_seq, hash};
+    return true;
+  }
+
+  // Copy a slot to the head.
+  bool _copy(uint16_t id) {
+    Slot &slot = this->_slots[id];
+    if (this->_offset + _size(slot.length) > SENSINO_SECTOR_SIZE) {
+      return false;
+    }
+    uint32_t crc;
+    uint32_t offset = this->_append(id, slot.length, crc);
+    for (uint32_t done = 0; done < slot.length; done += sizeof(this->_chunk)) {
+      uint32_t size = slot.length - done;
+      if (size > sizeof(this->_chunk)) {
+        size = sizeof(this->_chunk);
+      }
+      uint32_t words = (size + 3) / 4 * 4;
+      this->_flash->read(slot.sector, slot.offset + 8 + done, this->_chunk,
+                         words);
+      crc = _crc(crc, this->_chunk, size);
+      if (!this->_flash->write(this->_head, offset + 8 + done, this->_chunk,
+                               words)) {
+        return false;
+      }
+    }
+    return this->_commit(id, offset, slot.length, crc, slot.hash);
+  }
+
+  // Copy the slots living in a sector to the head.
+  bool _relocate(uint32_t sector) {
+    bool moved = false;
+    for (uint16_t id = 0; id < JOURNAL_MAX_SLOTS; id++) {
+      if (this->_slots[id].valid && this->_slots[id].sector == sector &&
+          sector != this->_head) {
+        if (!this->_copy(id)) {
+          return false;
+        }
+        moved = true;
+      }
+    }
+    if (moved) {
+      this->_compactions++;
+    }
+    return true;
+  }
+
+  // Start writing on the next sector, and free the oldest one.
+  bool _advance() {
+    uint32_t sectors = this->_flash->sectors();
+    uint32_t next = (this->_head + 1) % sectors;
+    if (this->_headSeq == 0) {
+      next = this->_head;
+    }
+    for (uint16_t id = 0; id < JOURNAL_MAX_SLOTS; id++) {
+      if (this->_slots[id].valid && this->_slots[id].sector == next) {
+        // An interrupted rotation could not be completed.
+        return false;
+      }
+    }
+    if (!this->_flash->erase(next)) {
+      return false;
+    }
+    uint32_t header[2] = {JOURNAL_MAGIC, this->_headSeq + 1};
+    if (!this->_flash->write(next, 0, header, sizeof(header))) {
+      return false;
+    }
+    this->_headSeq++;
+    this->_head = next;
+    this->_offset = _headerSize;
+    return this->_relocate((next + 1) % sectors);
+  }
+
+public:
+  Journal(Flash &flash) : _flash(&flash) {}
+
+  // Recover the slots from the flash.
+  void begin() {
+    this->_begun = true;
+    uint32_t sectors = this->_flash->sectors();
+
+    // The head is the valid sector with the highest sequence number.
+    this->_headSeq = 0;
+    this->_head = 0;
+    for (uint32_t sector = 0; sector < sectors; sector++) {
+      uint32_t header[2];
+      this->_flash->read(sector, 0, header, sizeof(header));
+      if (header[0] == JOURNAL_MAGIC && header[1] != JOURNAL_EMPTY &&
+          header[1] > this->_headSeq) {
+        this->_headSeq = header[1];
+        this->_head = sector;
+      }
+    }
+
+    this->_seq = 0;
+    for (uint16_t id = 0; id < JOURNAL_MAX_SLOTS; id++) {
+      this->_slots[id].valid = false;
+    }
+    this->_offset = SENSINO_SECTOR_SIZE;
+    if (this->_headSeq == 0) {
+      return;
+    }
+    for (uint32_t sector = 0; sector < sectors; sector++) {
+      uint32_t header[2];
+      this->_flash->read(sector, 0, header, sizeof(header));
+      if (header[0] != JOURNAL_MAGIC) {
+        continue;
+      }
+      uint32_t end = this->_scan(sector);
+      if (sector == this->_head) {
+        this->_offset = end;
+      }
+    }
+
+    // Complete a rotation interrupted before the oldest sector was freed.
+    if (sectors > 1) {
+      this->_relocate((this->_head + 1) % sectors);
+    }
+  }
+
+  // Write a slot, if its content changed.
+  // return success state.
+  bool write(uint16_t id, const void *data, uint16_t length) {
+    if (!this->_begun) {
+      this->begin();
+    }
+    if (id >= JOURNAL_MAX_SLOTS || this->_flash->sectors() < 2) {
+      return false;
+    }
+    Slot &slot = this->_slots[id];
+    uint32_t hash = _crc(0xFFFFFFFFUL, data, length) ^ 0xFFFFFFFFUL;
+    if (slot.valid && slot.length == length && slot.hash == hash) {
+      return true;
+    }
+
+    // All the slots must fit in half a sector, so that a rotation
+    // always leaves room in the new head.
+    uint32_t live = _size(length);
+    for (uint16_t n = 0; n < JOURNAL_MAX_SLOTS; n++) {
+      if (n != id && this->_slots[n].valid) {
+        live += _size(this->_slots[n].length);
+      }
+    }
+    if (live > (SENSINO_SECTOR_SIZE - _headerSize) / 2) {
+      return false;
+    }
+
+    ScopedTimer<micros> timer(this->_writeStats);
+    if (this->_offset + _size(length) > SENSINO_SECTOR_SIZE &&
+        !this->_advance()) {
+      return false;
+    }
+    uint32_t crc;
+    uint32_t offset = this->_append(id, length, crc);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (uint32_t done = 0; done < length; done += sizeof(this->_chunk)) {
+      uint32_t size = length - done;
+      if (size > sizeof(this->_chunk)) {
+        size = sizeof(this->_chunk);
+      }
+      memset(this->_chunk, 0xFF, sizeof(this->_chunk));
+      memcpy(this->_chunk, bytes + done, size);
+      crc = _crc(crc, this->_chunk, size);
+      if (!this->_flash->write(this->_head, offset + 8 + done, this->_chunk,
+                               (size + 3) / 4 * 4)) {
+        return false;
+      }
+    }
+    return this->_commit(id, offset, length, crc, hash);
+  }
+
+  // Read the newest copy of a slot.
+  // return false if it was never written or its length differs.
+  bool read(uint16_t id, void *data, uint16_t length) {
+    if (!this->_begun) {
+      this->begin();
+    }
+    if (id >= JOURNAL_MAX_SLOTS || !this->_slots[id].valid ||
+        this->_slots[id].length != length) {
+      return false;
+    }
+    const Slot &slot = this->_slots[id];
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(data);
+    for (uint32_t done = 0; done < length; done += sizeof(this->_chunk)) {
+      uint32_t size = length - done;
+      if (size > sizeof(this->_chunk)) {
+        size = sizeof(this->_chunk);
+      }
+      if (!this->_flash->read(slot.sector, slot.offset + 8 + done,
+                              this->_chunk, (size + 3) / 4 * 4)) {
+        return false;
+      }
+      memcpy(bytes + done, this->_chunk, size);
+    }
+    return true;
+  }
+
+  // true if the slot has been written.
+  bool contains(uint16_t id) const {
+    return id < JOURNAL_MAX_SLOTS && this->_slots[id].valid;
+  }
+
+  // Number of sectors whose slots were copied to make room.
+  unsigned long getCompactions() const { return this->_compactions; }
+
+  // Time (in us) taken by each write that reached the flash.
+  const Histogram &getWriteStats() const { return this->_writeStats; }
+};
+
+} // namespace sensino
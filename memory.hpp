@@ -6,36 +6,73 @@
 
 #include <ESP_EEPROM.h>
 
+#include "journal.hpp"
+
 namespace sensino {
 
 /**
- * Persistent storage for ESP using the flash as EEPROM.
+ * Persistent storage in a slot of a Journal, or in the EEPROM.
  *
  * The content attribute can be use to access the cached values
  * Use read to update the cache from the persistent storage,
- * and write to do the opposite.
+ * and write to do the opposite. Writing unchanged content to a journal
+ * does not touch the flash.
+ *
+ * Several instances can share a journal, each one with its own id:
+ *
+ *   ESPFlash flash(first, 4);
+ *   Journal journal(flash);
+ *   Memory<Counters> counters(journal, 0);
+ *   Memory<Settings> settings(journal, 1);
+ *
+ * Memory(int address) keeps the EEPROM version: content is stored at
+ * that byte offset of the emulated EEPROM, and each write commits the
+ * whole EEPROM sector. Values stored by previous versions are read back.
+ * To move to a journal, give each instance its own slot id instead of an
+ * offset (e.g. 0 and 1 rather than 0 and sizeof(Counters)): the journal
+ * starts empty, so copy the content read from the EEPROM to it once.
  *
  * It is generic over:
- * - S content: a struct indicates which persistent information is used.
+ * - S content: a struct indicates which persistent information is used,
+ *              must be trivially copyable.
  */
 template <typename S> class Memory {
 
 private:
+  // nullptr when stored in the EEPROM.
+  Journal *_journal = nullptr;
+
+  // Slot id in the journal, or byte offset in the EEPROM.
   int _address;
 
 public:
   S content;
 
+  Memory(Journal &journal, uint16_t id) : _journal(&journal), _address(id) {
+    this->read();
+  };
+
   Memory(int address) : _address(address) {
     EEPROM.begin(sizeof(S));
     this->read();
   };
 
-  void read() { EEPROM.get(_address, content); }
+  // return false if nothing was stored yet in the journal, content is left
+  // as is.
+  bool read() {
+    if (this->_journal == nullptr) {
+      EEPROM.get(this->_address, content);
+      return true;
+    }
+    return this->_journal->read(this->_address, &content, sizeof(S));
+  }
 
   bool write() {
-    EEPROM.put(_address, content);
-    return EEPROM.commit();
+    if (this->_journal == nullptr) {
+      EEPROM.put(this->_address, content);
+      return EEPROM.commit();
+    }
+    return this->_journal->write(this->_address, &content, sizeof(S));
   }
 };
 } // namespace sensino
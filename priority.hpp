@@ -0,0 +1,117 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Record buffer with priority classes.
+ *
+ */
+#pragma once
+
+#include <CircularBuffer.h>
+
+#include "common.h"
+
+namespace sensino {
+
+/**
+ * Buffer of records in two priority classes, each one with its own capacity.
+ *
+ * Records are read (by index, first and shift) alarms first, then routine
+ * records, each class oldest first. So the uploader drains the alarms
+ * before any backlog of routine records.
+ *
+ * When the alarm class is full, alarms are stored with the routine records,
+ * and if those are full as well, the oldest routine record can be evicted
+ * to make room. Routine records never take the room of alarms.
+ *
+ * It is generic over:
+ * - T: element stored.
+ * - S: capacity of the routine class.
+ * - AS: capacity of the alarm class.
+ */
+template <typename T, size_t S, size_t AS> class PriorityBuffer {
+
+private:
+  CircularBuffer<T, AS> _alarms;
+  CircularBuffer<T, S> _routine;
+
+  // Routine records evicted to make room for alarms.
+  unsigned long _evicted = 0;
+
+public:
+  // Add an element at the end of its class.
+  // evict allows to drop the oldest routine record to store an alarm.
+  // return false if there was no room.
+  bool push(const T &item, PRIORITY priority, bool evict = false) {
+    if (priority == PRIORITY::ALARM) {
+      if (!this->_alarms.isFull()) {
+        return this->_alarms.push(item);
+      }
+      if (this->_routine.isFull()) {
+        if (!evict) {
+          return false;
+        }
+        this->_routine.shift();
+        this->_evicted++;
+      }
+    } else if (this->_routine.isFull()) {
+      return false;
+    }
+    return this->_routine.push(item);
+  }
+
+  // First element, the oldest alarm if there is any.
+  T first() const {
+    return this->_alarms.isEmpty() ? this->_routine.first()
+                                   : this->_alarms.first();
+  }
+
+  // Remove the first element.
+  T shift() {
+    return this->_alarms.isEmpty() ? this->_routine.shift()
+                                   : this->_alarms.shift();
+  }
+
+  // Remove the first elements of each class, e.g. those read for a request
+  // while new alarms could arrive.
+  void shift(size_t alarms, size_t routine) {
+    for (; alarms > 0 && !this->_alarms.isEmpty(); alarms--) {
+      this->_alarms.shift();
+    }
+    for (; routine > 0 && !this->_routine.isEmpty(); routine--) {
+      this->_routine.shift();
+    }
+  }
+
+  T operator[](size_t index) const {
+    size_t alarms = this->_alarms.size();
+    return index < alarms ? this->_alarms[index]
+                          : this->_routine[index - alarms];
+  }
+
+  size_t size() const { return this->_alarms.size() + this->_routine.size(); }
+
+  size_t size(PRIORITY priority) const {
+    return priority == PRIORITY::ALARM ? this->_alarms.size()
+                                       : this->_routine.size();
+  }
+
+  bool isEmpty() const {
+    return this->_alarms.isEmpty() && this->_routine.isEmpty();
+  }
+
+  bool isEmpty(PRIORITY priority) const {
+    return priority == PRIORITY::ALARM ? this->_alarms.isEmpty()
+                                       : this->_routine.isEmpty();
+  }
+
+  // true if no more elements of that priority can be stored.
+  bool isFull(PRIORITY priority) const {
+    return priority == PRIORITY::ALARM
+               ? this->_alarms.isFull() && this->_routine.isFull()
+               : this->_routine.isFull();
+  }
+
+  unsigned long getEvicted() const { return this->_evicted; }
+};
+
+} // namespace sensino
@@ -0,0 +1,182 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Cooperative scheduler of the library components.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include "stats.hpp"
+
+// Maximum number of tasks of a scheduler.
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 8
+#endif
+
+namespace sensino {
+
+/**
+ * Runs tasks when they are due, earliest deadline first.
+ *
+ * A task does its work and returns the time (in ms) until it must run
+ * again, 0 to run on the next loop. The components provide a run method
+ * for it, which does the work of their loop and returns their idle time:
+ *
+ *   client.setTimeSyncTask(true);
+ *   scheduler.add("client", [] { return client.run(); }, 5000);
+ *   scheduler.add("time", [] { return client.runTimeSync(); });
+ *   scheduler.add("button", [] { return button.run(); }, 500);
+ *   scheduler.add("screen", [] { return screen.run(); }, 20000);
+ *
+ * The time task takes the samples of a time update when they are due,
+ * whatever the measure period, each one blocking for up to a round trip.
+ * With radio sleep, leave the time client to the client task instead (see
+ * Client::setTimeSyncTask).
+ *
+ * Each task has a budget (in us): runs over it are counted as overruns.
+ * Between due tasks, loop yields, or with sleep enabled, waits with delay
+ * until the earliest deadline, so that the CPU (and the modem in its sleep
+ * modes) can idle.
+ */
+class Scheduler {
+
+#if defined(SENSINO_STATIC)
+  typedef unsigned long (*THandlerFunction_Task)();
+#else
+  typedef std::function<unsigned long()> THandlerFunction_Task;
+#endif
+
+private:
+  struct Task {
+    THandlerFunction_Task run = nullptr;
+    const char *name = nullptr;
+    unsigned long next = 0;     // In ms
+    unsigned long budget = 0;   // In us, 0 for none
+    unsigned long overruns = 0; // Runs over the budget
+    Histogram time;             // In us
+  };
+
+  Task _tasks[SCHEDULER_MAX_TASKS];
+  uint8_t _taskCount = 0;
+
+  // true to wait with delay until the next deadline, up to _maxSleep (ms).
+  bool _sleep = false;
+  unsigned long _maxSleep = 1000;
+
+  // Time (in ms) waited with delay.
+  unsigned long _slept = 0;
+
+  // Index of the due task with the earliest deadline not yet run,
+  // or -1 if there is none.
+  int _earliest(unsigned long now, uint32_t ran) const {
+    int earliest = -1;
+    for (uint8_t n = 0; n < this->_taskCount; n++) {
+      if ((ran & (1UL << n)) || (long)(now - this->_tasks[n].next) < 0) {
+        continue;
+      }
+      if (earliest < 0 ||
+          (long)(this->_tasks[n].next - this->_tasks[earliest].next) < 0) {
+        earliest = n;
+      }
+    }
+    return earliest;
+  }
+
+public:
+  // Add a task, run first on the next loop.
+  // return its id, or -1 if there is no room (see SCHEDULER_MAX_TASKS).
+  int add(const char *name, THandlerFunction_Task run,
+          unsigned long budget = 0) {
+    if (this->_taskCount >= SCHEDULER_MAX_TASKS || run == nullptr) {
+      return -1;
+    }
+    Task &task = this->_tasks[this->_taskCount];
+    task.run = run;
+    task.name = name;
+    task.next = millis();
+    task.budget = budget;
+    return this->_taskCount++;
+  }
+
+  // Run a task on the next loop, e.g. after an event it is not aware of.
+  void wake(int id) {
+    if (id >= 0 && id < this->_taskCount) {
+      this->_tasks[id].next = millis();
+    }
+  }
+
+  // Time (in ms) until the earliest deadline.
+  unsigned long getIdleTime() const {
+    if (this->_taskCount == 0) {
+      return 0;
+    }
+    long idle = this->_tasks[0].next - millis();
+    for (uint8_t n = 1; n < this->_taskCount; n++) {
+      long left = this->_tasks[n].next - millis();
+      idle = left < idle ? left : idle;
+    }
+    return idle > 0 ? idle : 0;
+  }
+
+  // Call this method in your loop.
+  void loop() {
+    static_assert(SCHEDULER_MAX_TASKS <= 32, "Tasks must fit in a mask.");
+
+    unsigned long now = millis();
+    uint32_t ran = 0;
+    for (int n = this->_earliest(now, ran); n >= 0;
+         n = this->_earliest(now, ran)) {
+      ran |= 1UL << n;
+      Task &task = this->_tasks[n];
+      unsigned long start = micros();
+      unsigned long wait = task.run();
+      unsigned long elapsed = micros() - start;
+      task.time.add(elapsed);
+      if (task.budget > 0 && elapsed > task.budget) {
+        task.overruns++;
+      }
+      task.next = millis() + wait;
+    }
+
+    unsigned long idle = this->getIdleTime();
+    if (idle == 0) {
+      return;
+    }
+    if (this->_sleep) {
+      idle = idle < this->_maxSleep ? idle : this->_maxSleep;
+      delay(idle);
+      this->_slept += idle;
+    } else {
+      yield();
+    }
+  }
+
+  // Wait with delay until the next deadline, up to max ms.
+  void setSleep(bool value, unsigned long max = 1000) {
+    this->_sleep = value;
+    this->_maxSleep = max;
+  }
+
+  uint8_t getTaskCount() const { return this->_taskCount; }
+
+  const char *getName(int id) const {
+    return id >= 0 && id < this->_taskCount ? this->_tasks[id].name : nullptr;
+  }
+
+  // Number of runs of a task over its budget.
+  unsigned long getOverruns(int id) const {
+    return id >= 0 && id < this->_taskCount ? this->_tasks[id].overruns : 0;
+  }
+
+  // Time (in us) taken by each run of a task.
+  const Histogram &getTime(int id) const {
+    return this->_tasks[id >= 0 && id < this->_taskCount ? id : 0].time;
+  }
+
+  // Time (in ms) waited with delay.
+  unsigned long getSlept() const { return this->_slept; }
+};
+
+} // namespace sensino
@@ -4,17 +4,138 @@
  */
 #pragma once
 
+#include <Arduino.h>
+
+#include <string.h>
+
 #include <U8g2lib.h>
 #include <U8x8lib.h>
 
+#include "stats.hpp"
+
+// Size (in bytes) of the frame buffer of the screen.
+#define SCREEN_BUFFER_SIZE (128 * 64 / 8)
+
+// Rows of rows3, as a mask for the animations.
+#define SCREEN_ROW1 0b001
+#define SCREEN_ROW2 0b010
+#define SCREEN_ROW3 0b100
+#define SCREEN_ROWS 0b111
+
+// Time (in ms) between runs without animation, to notice a new one.
+#define SCREEN_IDLE_PERIOD 100
+
 namespace sensino {
 
+enum class ANIMATION {
+  NONE,    // Nothing is animated.
+  SCROLL,  // Rows move to the left, once.
+  MARQUEE, // Rows cross the screen from right to left, repeatedly.
+  BLINK,   // Rows are shown and hidden in turns.
+};
+
 /**
  * Abstract class over a U8G2 compatible screen.
  *
+ * The frame last sent is kept, and send only pushes the tiles (8x8 pixels)
+ * that changed since then: for each row of tiles, the span from the first
+ * to the last changed tile. Redrawing the same content sends nothing.
+ *
+ * Animations (see scroll, marquee and blink) are advanced by loop, which
+ * renders at most one frame per call. Frames follow the elapsed time, so
+ * when loop is late the missed frames are skipped. Drawing a new screen
+ * (with clear) stops the animation.
+ *
  */
 class Screen {
 
+private:
+  // Frame buffer as last sent to the display.
+  uint8_t _sent[SCREEN_BUFFER_SIZE];
+  bool _sentValid = false;
+
+  // Bytes pushed to the display, and time (in us) taken by each send.
+  unsigned long _bytesSent = 0;
+  Histogram _sendStats;
+
+  // Animation in progress over the rows3 layout.
+  ANIMATION _animation = ANIMATION::NONE;
+  const char *_rows[3] = {nullptr, nullptr, nullptr};
+  uint8_t _animated = SCREEN_ROWS; // Rows that move, see SCREEN_ROW1...
+  unsigned int _period = 50;       // In ms, per frame
+  unsigned long _frames = 0;       // 0 to repeat forever
+  unsigned long _start = 0;        // In ms
+  long _frame = -1;                // Last rendered
+
+  void _animate(ANIMATION animation, const char *row1, const char *row2,
+                const char *row3, unsigned int period, unsigned long frames,
+                uint8_t rows) {
+    this->_animation = animation;
+    this->_rows[0] = row1;
+    this->_rows[1] = row2;
+    this->_rows[2] = row3;
+    this->_period = period > 0 ? period : 1;
+    this->_frames = frames;
+    this->_animated = rows;
+    this->_start = millis();
+    this->_frame = -1;
+    this->loop();
+  }
+
+  // Horizontal offset of the animated rows, or false if they are hidden.
+  bool _position(unsigned long frame, int &offset) {
+    offset = 0;
+    switch (this->_animation) {
+    case ANIMATION::SCROLL:
+      offset = -(int)frame;
+      return true;
+    case ANIMATION::MARQUEE: {
+      int width = 0;
+      for (uint8_t row = 0; row < 3; row++) {
+        if ((this->_animated & (1 << row)) && this->_rows[row] != nullptr) {
+          int w = this->u8g2.getStrWidth(this->_rows[row]);
+          width = w > width ? w : width;
+        }
+      }
+      offset = 128 - (int)(frame % (unsigned long)(128 + width));
+      return true;
+    }
+    case ANIMATION::BLINK:
+      return frame % 2 == 0;
+    default:
+      return true;
+    }
+  }
+
+  // Draw a frame. The rows that do not move are drawn on the first one only.
+  void _render(unsigned long frame) {
+    int offset;
+    bool visible = this->_position(frame, offset);
+    bool full = this->_frame < 0 || this->_animated == SCREEN_ROWS;
+    if (full) {
+      this->u8g2.clearBuffer();
+    }
+    this->u8g2.setFont(u8g2_font_crox3tb_tf);
+    for (uint8_t row = 0; row < 3; row++) {
+      bool animated = this->_animated & (1 << row);
+      if (!full && !animated) {
+        continue;
+      }
+      int y = 20 * (row + 1);
+      if (!full) {
+        // Clear the band of the row, descenders included.
+        this->u8g2.setDrawColor(0);
+        this->u8g2.drawBox(0, y - 16, 128, 20);
+        this->u8g2.setDrawColor(1);
+      }
+      if (this->_rows[row] != nullptr && (!animated || visible)) {
+        this->u8g2.drawStr(animated ? offset : 0, y, this->_rows[row]);
+      }
+    }
+    this->_frame = frame;
+    this->send();
+  }
+
 public:
   U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2 =
       U8G2_SH1106_128X64_NONAME_F_HW_I2C(U8G2_R0, /* reset=*/U8X8_PIN_NONE);
@@ -24,14 +145,67 @@ public:
   void setup() {
     this->u8g2.begin();
     this->u8g2.clearBuffer();
+    this->_sentValid = false;
   }
 
   // clear the screen
   void clear() {
+    this->stop();
     this->u8g2.clearBuffer();
-    this->u8g2.sendBuffer();
+    this->send();
   }
 
+  // Send the changes of the buffer to the display.
+  void send() {
+    ScopedTimer<micros> timer(this->_sendStats);
+    uint8_t *buffer = this->u8g2.getBufferPtr();
+    uint8_t columns = this->u8g2.getBufferTileWidth();
+    uint8_t rows = this->u8g2.getBufferTileHeight();
+    size_t size = (size_t)columns * rows * 8;
+    if (!this->_sentValid || size > SCREEN_BUFFER_SIZE) {
+      this->u8g2.sendBuffer();
+      this->_bytesSent += size;
+      if (size <= SCREEN_BUFFER_SIZE) {
+        memcpy(this->_sent, buffer, size);
+        this->_sentValid = true;
+      }
+      return;
+    }
+
+    for (uint8_t row = 0; row < rows; row++) {
+      size_t start = (size_t)row * columns * 8;
+      int first = -1;
+      int last = -1;
+      for (uint8_t column = 0; column < columns; column++) {
+        size_t tile = start + column * 8;
+        if (memcmp(&buffer[tile], &this->_sent[tile], 8) != 0) {
+          if (first < 0) {
+            first = column;
+          }
+          last = column;
+        }
+      }
+      if (first < 0) {
+        continue;
+      }
+      uint8_t width = last - first + 1;
+      this->u8g2.updateDisplayArea(first, row, width, 1);
+      this->_bytesSent += width * 8;
+      memcpy(&this->_sent[start + first * 8], &buffer[start + first * 8],
+             width * 8);
+    }
+  }
+
+  // Send the whole buffer on the next send, e.g. after the display was
+  // written without this class.
+  void invalidate() { this->_sentValid = false; }
+
+  // Bytes of frame buffer pushed to the display.
+  unsigned long getBytesSent() const { return this->_bytesSent; }
+
+  // Time (in us) taken by each send.
+  const Histogram &getSendStats() const { return this->_sendStats; }
+
   // Put a large text and a number below. Useful for countdowns.
   void title_number(const char *title, int number, const char *suffix,
                     bool clear = true, bool send = true) {
@@ -44,6 +218,7 @@ public:
   void rows2(const char *row1, const char *row2, bool clear = true,
              bool send = true, int offset = 0) {
     if (clear) {
+      this->stop();
       this->u8g2.clearBuffer();
       this->u8g2.setFont(u8g2_font_crox4tb_tf);
     }
@@ -56,7 +231,7 @@ public:
     }
 
     if (send) {
-      this->u8g2.sendBuffer();
+      this->send();
     }
   }
 
@@ -64,6 +239,7 @@ public:
   void rows3(const char *row1, const char *row2, const char *row3,
              bool clear = true, bool send = true, int offset = 0) {
     if (clear) {
+      this->stop();
       this->u8g2.clearBuffer();
       this->u8g2.setFont(u8g2_font_crox3tb_tf);
     }
@@ -79,18 +255,70 @@ public:
     }
 
     if (send) {
-      this->u8g2.sendBuffer();
+      this->send();
     }
   }
 
-  // Text in three rows with scrolling.
+  // Text in three rows with scrolling (see scroll).
   void rows3_scroll(const char *row1, const char *row2, const char *row3,
                     unsigned int period = 50) {
+    this->scroll(row1, row2, row3, period);
+  }
 
-    for (unsigned int offset = 0; offset <= 100; offset++) {
-      this->rows3(row1, row2, row3, true, true, -offset);
-      delay(period);
+  // Move the rows to the left, one pixel per frame (of period ms),
+  // by up to distance pixels. rows selects the rows that move
+  // (see SCREEN_ROW1...), the others stay still and are not redrawn.
+  // The texts must live until the animation ends.
+  void scroll(const char *row1, const char *row2, const char *row3,
+              unsigned int period = 50, unsigned int distance = 100,
+              uint8_t rows = SCREEN_ROWS) {
+    this->_animate(ANIMATION::SCROLL, row1, row2, row3, period, distance + 1,
+                   rows);
+  }
+
+  // Move the rows across the screen from right to left, one pixel per
+  // frame (of period ms), over and over until stopped.
+  void marquee(const char *row1, const char *row2, const char *row3,
+               unsigned int period = 30, uint8_t rows = SCREEN_ROWS) {
+    this->_animate(ANIMATION::MARQUEE, row1, row2, row3, period, 0, rows);
+  }
+
+  // Show and hide the rows every period ms, times times (0 for ever).
+  void blink(const char *row1, const char *row2, const char *row3,
+             unsigned int period = 500, unsigned int times = 0,
+             uint8_t rows = SCREEN_ROWS) {
+    this->_animate(ANIMATION::BLINK, row1, row2, row3, period,
+                   times > 0 ? times * 2 + 1 : 0, rows);
+  }
+
+  void stop() { this->_animation = ANIMATION::NONE; }
+
+  bool isAnimating() const { return this->_animation != ANIMATION::NONE; }
+
+  // Call this method in your loop to advance the animation.
+  // At most a frame is rendered, the latest one due.
+  void loop() { this->run(); }
+
+  // Advance the animation (e.g. as a Scheduler task).
+  // return the time (in ms) until the next frame, or SCREEN_IDLE_PERIOD
+  // without animation.
+  unsigned long run() {
+    if (this->_animation == ANIMATION::NONE) {
+      return SCREEN_IDLE_PERIOD;
+    }
+    unsigned long frame = (millis() - this->_start) / this->_period;
+    bool last = this->_frames > 0 && frame >= this->_frames - 1;
+    if (last) {
+      frame = this->_frames - 1;
+    }
+    if ((long)frame != this->_frame) {
+      this->_render(frame);
+    }
+    if (last) {
+      this->_animation = ANIMATION::NONE;
+      return SCREEN_IDLE_PERIOD;
     }
+    return this->_period - (millis() - this->_start) % this->_period;
   }
 };
 
@@ -0,0 +1,301 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Append only ring log of records in flash.
+ *
+ */
+#pragma once
+
+#include "flash.hpp"
+
+#define SPOOL_MAGIC 0x4C4F5053UL // "SPOL"
+#define SPOOL_EMPTY 0xFFFFFFFFUL
+#define SPOOL_VALID 0x55AA55AAUL
+#define SPOOL_CONSUMED 0x00000000UL
+
+// Version of the sector layout, stored with the size of the records.
+#define SPOOL_VERSION 1
+
+namespace sensino {
+
+/**
+ * Overflow storage for records, in flash.
+ *
+ * Records are appended to the current (head) sector and read back
+ * oldest first from the tail. Sectors are used in a ring, so erases
+ * are spread evenly over the whole region. When the region is full,
+ * the oldest sector is discarded to make room for new records.
+ *
+ * Sector layout:
+ * - magic (4 bytes)
+ * - sequence number (4 bytes), increases with each new sector.
+ * - format (4 bytes): SPOOL_VERSION and the size of the record.
+ * - slots: state (4 bytes) followed by the record.
+ *
+ * The state of a slot goes from EMPTY to VALID when the record is written
+ * and from VALID to CONSUMED when it is read back. Both transitions only
+ * clear bits, so no erase is needed. The state is written after the record,
+ * therefore an interrupted write is never read back.
+ *
+ * Call begin() before using it to recover the state after a reboot.
+ * Sectors written with another layout or record type (e.g. by a previous
+ * firmware) are discarded.
+ *
+ * It is generic over:
+ * - T: record type, must be trivially copyable.
+ */
+template <typename T> class Spool {
+
+private:
+  static const size_t _headerWords = 3;
+  static const uint32_t _format = (uint32_t)SPOOL_VERSION << 16 | sizeof(T);
+  static const size_t _entryWords = 1 + (sizeof(T) + 3) / 4;
+  static const size_t _slots =
+      (SENSINO_SECTOR_SIZE / 4 - _headerWords) / _entryWords;
+
+  Flash *_flash;
+
+  // Sector and slot where the next record will be written.
+  uint32_t _head = 0;
+  uint32_t _headSlot = _slots;
+  uint32_t _headSeq = 0;
+
+  // Sector and slot of the oldest unread record.
+  uint32_t _tail = 0;
+  uint32_t _tailSlot = _slots;
+
+  // Number of unread records.
+  unsigned long _count = 0;
+
+  // Number of records lost because the spool was full.
+  unsigned long _dropped = 0;
+
+  uint32_t _entry[_entryWords];
+
+  uint32_t _offset(uint32_t slot) const {
+    return (_headerWords + slot * _entryWords) * 4;
+  }
+
+  uint32_t _state(uint32_t sector, uint32_t slot) {
+    uint32_t state = SPOOL_CONSUMED;
+    this->_flash->read(sector, this->_offset(slot), &state, 4);
+    return state;
+  }
+
+  // Sequence number of a sector, 0 if it does not belong to the spool.
+  uint32_t _sequence(uint32_t sector) {
+    uint32_t header[_headerWords];
+    if (!this->_flash->read(sector, 0, header, sizeof(header)) ||
+        header[0] != SPOOL_MAGIC || header[1] == SPOOL_EMPTY ||
+        header[2] != _format) {
+      return 0;
+    }
+    return header[1];
+  }
+
+  // Count the records not yet read in a sector, from a given slot.
+  unsigned long _pending(uint32_t sector, uint32_t from) {
+    unsigned long count = 0;
+    for (uint32_t slot = from; slot < _slots; slot++) {
+      if (this->_state(sector, slot) == SPOOL_VALID) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // Move the tail to the next record not yet read.
+  void _seekTail() {
+    while (this->_count > 0) {
+      if (this->_tail == this->_head && this->_tailSlot >= this->_headSlot) {
+        // Nothing left to read, the flash does not match the count.
+        this->_count = 0;
+        return;
+      }
+      if (this->_tailSlot >= _slots) {
+        this->_tail = (this->_tail + 1) % this->_flash->sectors();
+        this->_tailSlot = 0;
+      }
+      if (this->_state(this->_tail, this->_tailSlot) == SPOOL_VALID) {
+        return;
+      }
+      this->_tailSlot++;
+    }
+  }
+
+  // Start writing on a new sector, discarding the oldest if needed.
+  bool _advanceHead() {
+    uint32_t next = (this->_head + 1) % this->_flash->sectors();
+    if (this->_headSeq == 0) {
+      next = this->_head;
+    } else if (next == this->_tail && this->_count > 0) {
+      unsigned long lost = this->_pending(this->_tail, this->_tailSlot);
+      this->_dropped += lost;
+      this->_count -= lost;
+      this->_tailSlot = _slots;
+      this->_seekTail();
+      if (this->_count == 0) {
+        this->_tail = next;
+        this->_tailSlot = 0;
+      }
+    }
+
+    if (!this->_flash->erase(next)) {
+      return false;
+    }
+    uint32_t header[_headerWords] = {SPOOL_MAGIC, this->_headSeq + 1,
+                                     _format};
+    if (!this->_flash->write(next, 0, header, sizeof(header))) {
+      return false;
+    }
+    this->_headSeq++;
+    this->_head = next;
+    this->_headSlot = 0;
+    if (this->_count == 0) {
+      this->_tail = next;
+      this->_tailSlot = 0;
+    }
+    return true;
+  }
+
+public:
+  Spool(Flash &flash) : _flash(&flash) {}
+
+  // Recover the state of the spool from the flash.
+  void begin() {
+    uint32_t sectors = this->_flash->sectors();
+
+    // The head is the valid sector with the highest sequence number.
+    this->_headSeq = 0;
+    for (uint32_t sector = 0; sector < sectors; sector++) {
+      uint32_t seq = this->_sequence(sector);
+      if (seq > this->_headSeq) {
+        this->_headSeq = seq;
+        this->_head = sector;
+      }
+    }
+
+    this->_count = 0;
+    if (this->_headSeq == 0) {
+      this->_headSlot = _slots;
+      this->_tailSlot = _slots;
+      return;
+    }
+
+    // Find the first free slot in the head sector,
+    // discarding interrupted writes.
+    this->_headSlot = _slots;
+    for (uint32_t slot = 0; slot < _slots; slot++) {
+      if (this->_state(this->_head, slot) != SPOOL_EMPTY) {
+        continue;
+      }
+      this->_flash->read(this->_head, this->_offset(slot), this->_entry,
+                         sizeof(this->_entry));
+      bool erased = true;
+      for (size_t n = 0; n < _entryWords; n++) {
+        erased = erased && this->_entry[n] == SPOOL_EMPTY;
+      }
+      if (erased) {
+        this->_headSlot = slot;
+        break;
+      }
+      uint32_t state = SPOOL_CONSUMED;
+      this->_flash->write(this->_head, this->_offset(slot), &state, 4);
+    }
+
+    // Walk back the chain of consecutive sectors to find the oldest one.
+    uint32_t oldest = this->_head;
+    uint32_t seq = this->_headSeq;
+    for (uint32_t n = 1; n < sectors; n++) {
+      uint32_t sector = (this->_head + sectors - n) % sectors;
+      if (this->_sequence(sector) != seq - 1) {
+        break;
+      }
+      oldest = sector;
+      seq--;
+    }
+
+    // Count the pending records and place the tail on the first of them.
+    this->_tail = this->_head;
+    this->_tailSlot = this->_headSlot;
+    for (uint32_t sector = oldest;; sector = (sector + 1) % sectors) {
+      unsigned long pending = this->_pending(sector, 0);
+      if (pending > 0 && this->_count == 0) {
+        this->_tail = sector;
+        this->_tailSlot = 0;
+      }
+      this->_count += pending;
+      if (sector == this->_head) {
+        break;
+      }
+    }
+    this->_seekTail();
+  }
+
+  // Append a record.
+  // return success state.
+  bool push(const T &record) {
+    if (this->_headSlot >= _slots && !this->_advanceHead()) {
+      return false;
+    }
+    if (this->_count == 0) {
+      this->_tail = this->_head;
+      this->_tailSlot = this->_headSlot;
+    }
+    memset(this->_entry, 0xFF, sizeof(this->_entry));
+    memcpy(&this->_entry[1], &record, sizeof(T));
+
+    uint32_t offset = this->_offset(this->_headSlot);
+    this->_headSlot++;
+    if (!this->_flash->write(this->_head, offset + 4, &this->_entry[1],
+                             sizeof(this->_entry) - 4)) {
+      return false;
+    }
+    uint32_t state = SPOOL_VALID;
+    if (!this->_flash->write(this->_head, offset, &state, 4)) {
+      return false;
+    }
+    this->_count++;
+    return true;
+  }
+
+  // Read the oldest record without removing it.
+  // return false if empty.
+  bool first(T &record) {
+    if (this->_count == 0) {
+      return false;
+    }
+    this->_flash->read(this->_tail, this->_offset(this->_tailSlot),
+                       this->_entry, sizeof(this->_entry));
+    memcpy((void *)&record, &this->_entry[1], sizeof(T));
+    return true;
+  }
+
+  // Read and remove the oldest record.
+  // return false if empty.
+  bool shift(T &record) {
+    if (!this->first(record)) {
+      return false;
+    }
+    uint32_t state = SPOOL_CONSUMED;
+    this->_flash->write(this->_tail, this->_offset(this->_tailSlot), &state,
+                        4);
+    this->_count--;
+    this->_tailSlot++;
+    this->_seekTail();
+    return true;
+  }
+
+  bool isEmpty() const { return this->_count == 0; }
+
+  // Number of records not yet read.
+  unsigned long size() const { return this->_count; }
+
+  // Number of records that fit in the spool.
+  unsigned long capacity() const { return _slots * this->_flash->sectors(); }
+
+  // Number of records lost because the spool was full.
+  unsigned long getDropped() const { return this->_dropped; }
+};
+
+} // namespace sensino
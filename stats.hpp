@@ -0,0 +1,136 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Lightweight statistics to monitor the library at runtime.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define STATS_DOC_SIZE 512
+
+#define HISTOGRAM_BUCKETS 24
+
+namespace sensino {
+
+/**
+ * Histogram of durations (or any unsigned value) in log2 buckets.
+ *
+ * Bucket 0 holds 0, bucket b holds values in [2^(b-1), 2^b), and the last
+ * one everything above. With durations in us, it covers up to ~8 s.
+ *
+ * Adding a value is a few instructions and it takes a fixed amount of
+ * memory, so it can be kept always on. Percentiles are approximated by the
+ * upper bound of the bucket that contains them.
+ */
+class Histogram {
+
+private:
+  uint32_t _buckets[HISTOGRAM_BUCKETS] = {0};
+  uint32_t _count = 0;
+  uint32_t _min = 0;
+  uint32_t _max = 0;
+  uint64_t _sum = 0;
+
+  static uint8_t _bucket(uint32_t value) {
+    uint8_t bucket = 0;
+    while (value > 0 && bucket < HISTOGRAM_BUCKETS - 1) {
+      value >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+
+public:
+  void add(uint32_t value) {
+    this->_buckets[_bucket(value)]++;
+    if (this->_count == 0 || value < this->_min) {
+      this->_min = value;
+    }
+    if (value > this->_max) {
+      this->_max = value;
+    }
+    this->_count++;
+    this->_sum += value;
+  }
+
+  // Value below which a fraction p (0 to 1) of the values are.
+  uint32_t percentile(float p) const {
+    if (this->_count == 0) {
+      return 0;
+    }
+    uint32_t rank = (uint32_t)(p * this->_count + 0.5f);
+    if (rank < 1) {
+      rank = 1;
+    }
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+      seen += this->_buckets[bucket];
+      if (seen >= rank) {
+        uint32_t upper = bucket == 0 ? 0 : (1UL << bucket) - 1;
+        return upper < this->_max ? upper : this->_max;
+      }
+    }
+    return this->_max;
+  }
+
+  uint32_t count() const { return this->_count; }
+
+  uint32_t min() const { return this->_min; }
+
+  uint32_t max() const { return this->_max; }
+
+  uint32_t mean() const {
+    return this->_count == 0 ? 0 : (uint32_t)(this->_sum / this->_count);
+  }
+
+  // Number of values in a bucket.
+  uint32_t bucket(uint8_t n) const {
+    return n < HISTOGRAM_BUCKETS ? this->_buckets[n] : 0;
+  }
+
+  void reset() { *this = Histogram(); }
+};
+
+/**
+ * Adds the time (in us) from its creation to its destruction to a histogram.
+ *
+ * It is generic over:
+ * - CLOCK: function returning the time in us (e.g. micros).
+ */
+template <unsigned long (*CLOCK)()> class ScopedTimer {
+
+private:
+  Histogram &_histogram;
+  unsigned long _start;
+
+public:
+  ScopedTimer(Histogram &histogram) : _histogram(histogram), _start(CLOCK()) {}
+
+  ~ScopedTimer() { this->_histogram.add(CLOCK() - this->_start); }
+};
+
+/**
+ * Runtime statistics of the Client.
+ *
+ * Durations are in us, except upload which is in ms.
+ */
+struct ClientStats {
+  Histogram loop;      // Whole loop.
+  Histogram measure;   // Measure callbacks.
+  Histogram serialize; // Building the body of a request.
+  Histogram upload;    // From the start of a request to its answer (ms).
+  Histogram timeSync;  // Time spent by the time client in each loop.
+
+  uint32_t measureErrors = 0; // MEASURE_STATE::ERROR
+  uint32_t bufferFull = 0;    // MEASURE_STATE::BUFFER_FULL
+  uint32_t sendErrors = 0;    // SEND_STATE::ERROR
+  uint32_t highWater = 0;     // Maximum number of records in the buffer.
+  uint32_t bursts = 0;        // Times the buffer was drained.
+  uint32_t radioOn = 0;       // Time (in ms) awake, with radio sleep.
+  uint32_t truncated = 0;     // Answers cut to UPLOAD_PAYLOAD_SIZE, ignored.
+  uint32_t oversized = 0;     // Records too large to send, dropped.
+};
+
+} // namespace sensino
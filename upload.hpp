@@ -0,0 +1,520 @@
+/**
+ * This file is part of the sensino library.
+ *
+ * Non blocking HTTP/1.1 POST over a kept alive connection.
+ *
+ */
+#pragma once
+
+#include <Arduino.h>
+
+// change next line to use with another board/shield
+#include <ESP8266WiFi.h>
+
+#ifndef UPLOAD_HOST_SIZE
+#define UPLOAD_HOST_SIZE 64
+#endif
+
+#ifndef UPLOAD_PREAMBLE_SIZE
+#define UPLOAD_PREAMBLE_SIZE 192
+#endif
+
+#ifndef UPLOAD_LINE_SIZE
+#define UPLOAD_LINE_SIZE 96
+#endif
+
+// Room (in bytes) for the body of a response, including the terminating
+// null. Longer bodies are cut (see Upload::isTruncated).
+#ifndef UPLOAD_PAYLOAD_SIZE
+#define UPLOAD_PAYLOAD_SIZE 512
+#endif
+
+// Consecutive failed connections to the resolved address after which the
+// host name is resolved again.
+#ifndef UPLOAD_RESOLVE_AFTER
+#define UPLOAD_RESOLVE_AFTER 8
+#endif
+
+namespace sensino {
+
+enum class UPLOAD_STATE {
+  IDLE,    // No request in progress.
+  CONNECT, // Opening (or reusing) the connection.
+  HEADERS, // Writing the request line and headers.
+  BODY,    // Writing the body.
+  AWAIT,   // Waiting for and reading the response.
+  DONE,    // Response received (see getStatus).
+  ERROR    // The request failed.
+};
+
+/**
+ * HTTP POST split in small steps.
+ *
+ * Call start to queue a request and step (e.g. once per loop) until
+ * the state is DONE or ERROR. Each step does as much work as possible
+ * without waiting for the network, within a time budget. Then call reset
+ * to make it available for the next request.
+ *
+ * The connection is kept alive between requests. If a reused connection
+ * turns out to be stale, the request is retried once on a new one.
+ *
+ * Only plain http is supported. Opening a new connection blocks
+ * (up to the connect timeout) as the underlying WiFiClient does.
+ * The host name is resolved once, and again only after the address
+ * refused UPLOAD_RESOLVE_AFTER connections in a row, so retries against
+ * a dead server do not wait for DNS each time.
+ *
+ * The body of the response is kept up to UPLOAD_PAYLOAD_SIZE - 1 bytes,
+ * the rest is read and discarded (see isTruncated).
+ */
+class Upload {
+
+private:
+  WiFiClient _client;
+
+  // Parsed from the URL.
+  char _host[UPLOAD_HOST_SIZE];
+  IPAddress _ip;
+  uint16_t _port = 80;
+  const char *_path = "/";
+
+  UPLOAD_STATE _state = UPLOAD_STATE::IDLE;
+
+  // Request: preamble, user headers, empty line and body.
+  char _preamble[UPLOAD_PREAMBLE_SIZE];
+  const char *_segments[4];
+  size_t _lengths[4];
+  size_t _segment = 0;
+  size_t _offset = 0;
+
+  unsigned long _startedAt = 0;
+  unsigned long _timeout = 5000;        // In ms, for the whole request.
+  unsigned long _connectTimeout = 2000; // In ms.
+
+  bool _reused = false;
+  bool _retried = false;
+
+  // Response parsing.
+  enum class PARSE { STATUS, HEADER, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_END };
+  PARSE _parse = PARSE::STATUS;
+  char _line[UPLOAD_LINE_SIZE];
+  size_t _lineLength = 0;
+  size_t _received = 0;
+  int _status = 0;
+  unsigned long _retryAfter = 0; // In s
+  long _contentLength = -1;
+  long _remaining = 0;
+  bool _chunked = false;
+  bool _keepAlive = true;
+
+  char _payload[UPLOAD_PAYLOAD_SIZE];
+  size_t _payloadLength = 0;
+  bool _truncated = false;
+
+  // Consecutive failed connections to _ip.
+  unsigned int _connectFailures = 0;
+
+  unsigned long _reuses = 0;
+  unsigned long _reconnects = 0;
+
+  // Bytes on the wire (excluding TCP/IP overhead).
+  unsigned long _bytesSent = 0;
+  unsigned long _bytesReceived = 0;
+
+  bool _connect() {
+    this->_reused = this->_client.connected();
+    if (this->_reused) {
+      this->_reuses++;
+      // Discard leftovers of the previous response.
+      while (this->_client.available() > 0) {
+        this->_client.read();
+      }
+      return true;
+    }
+    this->_reconnects++;
+    this->_client.stop();
+    this->_client.setTimeout(this->_connectTimeout);
+    this->_client.setNoDelay(true);
+    // The address is resolved once, to skip DNS on reconnections.
+    if (this->_connectFailures >= UPLOAD_RESOLVE_AFTER) {
+      this->_ip = IPAddress();
+    }
+    if (!this->_ip.isSet()) {
+      if (!WiFi.hostByName(this->_host, this->_ip)) {
+        this->_ip = IPAddress();
+        return false;
+      }
+      this->_connectFailures = 0;
+    }
+    if (!this->_client.connect(this->_ip, this->_port)) {
+      this->_connectFailures++;
+      return false;
+    }
+    this->_connectFailures = 0;
+    return true;
+  }
+
+  // Write as much of the request as the connection accepts.
+  // return true if something was written.
+  bool _write() {
+    while (this->_segment < 4 &&
+           this->_offset >= this->_lengths[this->_segment]) {
+      this->_segment++;
+      this->_offset = 0;
+    }
+    if (this->_segment >= 4) {
+      return false;
+    }
+    size_t size = this->_lengths[this->_segment] - this->_offset;
+    size_t room = this->_client.availableForWrite();
+    if (room == 0) {
+      return false;
+    }
+    if (size > room) {
+      size = room;
+    }
+    size_t written = this->_client.write(
+        (const uint8_t *)this->_segments[this->_segment] + this->_offset,
+        size);
+    this->_offset += written;
+    this->_bytesSent += written;
+    return written > 0;
+  }
+
+  bool _isWritten() const {
+    return this->_segment >= 4 ||
+           (this->_segment == 3 && this->_offset >= this->_lengths[3]);
+  }
+
+  void _payloadByte(char c) {
+    if (this->_payloadLength < UPLOAD_PAYLOAD_SIZE - 1) {
+      this->_payload[this->_payloadLength++] = c;
+      this->_payload[this->_payloadLength] = 0;
+    } else {
+      this->_truncated = true;
+    }
+  }
+
+  // Process a header or status line.
+  void _processLine() {
+    this->_line[this->_lineLength] = 0;
+    if (this->_parse == PARSE::STATUS) {
+      // HTTP/1.1 200 OK
+      const char *space = strchr(this->_line, ' ');
+      this->_status = space == nullptr ? 0 : atoi(space + 1);
+      this->_keepAlive = strncmp(this->_line, "HTTP/1.0", 8) != 0;
+      this->_parse = PARSE::HEADER;
+      return;
+    }
+    if (this->_lineLength == 0) {
+      // End of headers.
+      if (this->_chunked) {
+        this->_parse = PARSE::CHUNK_SIZE;
+      } else {
+        this->_parse = PARSE::BODY;
+        this->_remaining = this->_contentLength;
+      }
+      return;
+    }
+    if (strncasecmp(this->_line, "Content-Length:", 15) == 0) {
+      this->_contentLength = atol(this->_line + 15);
+    } else if (strncasecmp(this->_line, "Transfer-Encoding:", 18) == 0) {
+      this->_chunked = strstr(this->_line + 18, "chunked") != nullptr;
+    } else if (strncasecmp(this->_line, "Connection:", 11) == 0) {
+      this->_keepAlive = strstr(this->_line + 11, "close") == nullptr;
+    } else if (strncasecmp(this->_line, "Retry-After:", 12) == 0) {
+      // Only delay-seconds, an HTTP-date is ignored.
+      this->_retryAfter = strtoul(this->_line + 12, nullptr, 10);
+    }
+  }
+
+  // Feed a byte of the response to the parser.
+  // return true when the response is complete.
+  bool _feed(char c) {
+    switch (this->_parse) {
+    case PARSE::STATUS:
+    case PARSE::HEADER:
+    case PARSE::CHUNK_SIZE:
+    case PARSE::CHUNK_END:
+      if (c == '\r') {
+        return false;
+      }
+      if (c != '\n') {
+        if (this->_lineLength < UPLOAD_LINE_SIZE - 1) {
+          this->_line[this->_lineLength++] = c;
+        }
+        return false;
+      }
+      if (this->_parse == PARSE::STATUS && this->_lineLength == 0) {
+        // Ignore empty lines before the status line.
+        return false;
+      }
+      if (this->_parse == PARSE::CHUNK_END) {
+        this->_parse = PARSE::CHUNK_SIZE;
+      } else if (this->_parse == PARSE::CHUNK_SIZE) {
+        this->_line[this->_lineLength] = 0;
+        this->_remaining = strtol(this->_line, nullptr, 16);
+        this->_parse = PARSE::CHUNK_DATA;
+      } else {
+        this->_processLine();
+      }
+      this->_lineLength = 0;
+      break;
+    case PARSE::BODY:
+      this->_payloadByte(c);
+      this->_remaining--;
+      break;
+    case PARSE::CHUNK_DATA:
+      this->_payloadByte(c);
+      if (--this->_remaining == 0) {
+        this->_parse = PARSE::CHUNK_END;
+      }
+      break;
+    }
+    return this->_isComplete();
+  }
+
+  bool _isComplete() const {
+    if (this->_parse == PARSE::BODY) {
+      // Without length, the body ends when the connection is closed.
+      return this->_remaining == 0 || this->_status == 204 ||
+             this->_status == 304;
+    }
+    return this->_parse == PARSE::CHUNK_DATA && this->_remaining == 0;
+  }
+
+  // Read the available part of the response.
+  // return true if something was read.
+  bool _read() {
+    int available = this->_client.available();
+    if (available <= 0) {
+      return false;
+    }
+    uint8_t buffer[64];
+    int size = this->_client.read(
+        buffer, available < (int)sizeof(buffer) ? available : sizeof(buffer));
+    if (size > 0) {
+      this->_bytesReceived += size;
+    }
+    for (int n = 0; n < size; n++) {
+      this->_received++;
+      if (this->_feed(buffer[n])) {
+        this->_state = UPLOAD_STATE::DONE;
+        if (!this->_keepAlive) {
+          this->_client.stop();
+        }
+        return true;
+      }
+    }
+    return size > 0;
+  }
+
+  // The connection failed, retry once if it was a stale one.
+  void _fail() {
+    this->_client.stop();
+    if (this->_reused && !this->_retried && this->_received == 0) {
+      this->_retried = true;
+      this->_segment = 0;
+      this->_offset = 0;
+      this->_state = UPLOAD_STATE::CONNECT;
+      return;
+    }
+    this->_state = UPLOAD_STATE::ERROR;
+  }
+
+public:
+  Upload() { this->_host[0] = 0; }
+
+  // Parse the endpoint URL (http://host[:port]/path).
+  // The URL must outlive this object.
+  bool begin(const char *url) {
+    if (strncmp(url, "http://", 7) != 0) {
+      return false;
+    }
+    const char *host = url + 7;
+    const char *path = strchr(host, '/');
+    if (path == nullptr) {
+      path = host + strlen(host);
+    }
+    const char *colon = strchr(host, ':');
+    const char *end = path;
+    if (colon != nullptr && colon < path) {
+      this->_port = atoi(colon + 1);
+      end = colon;
+    }
+    size_t size = end - host;
+    if (size >= UPLOAD_HOST_SIZE) {
+      return false;
+    }
+    memcpy(this->_host, host, size);
+    this->_host[size] = 0;
+    this->_path = *path == 0 ? "/" : path;
+    this->_ip = IPAddress();
+    return true;
+  }
+
+  // Queue a request.
+  // headers must be complete lines ("Name: value\r\n").
+  // headers and body must remain valid until the request ends.
+  bool start(const char *headers, size_t headersLength, const char *body,
+             size_t bodyLength) {
+    if (this->_state != UPLOAD_STATE::IDLE) {
+      return false;
+    }
+    int length = snprintf(this->_preamble, sizeof(this->_preamble),
+                          "POST %s HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "Connection: keep-alive\r\n"
+                          "Content-Length: %u\r\n",
+                          this->_path, this->_host, (unsigned int)bodyLength);
+    if (length < 0 || length >= (int)sizeof(this->_preamble)) {
+      return false;
+    }
+    this->_segments[0] = this->_preamble;
+    this->_lengths[0] = length;
+    this->_segments[1] = headers;
+    this->_lengths[1] = headersLength;
+    this->_segments[2] = "\r\n";
+    this->_lengths[2] = 2;
+    this->_segments[3] = body;
+    this->_lengths[3] = bodyLength;
+    this->_segment = 0;
+    this->_offset = 0;
+
+    this->_parse = PARSE::STATUS;
+    this->_lineLength = 0;
+    this->_received = 0;
+    this->_status = 0;
+    this->_retryAfter = 0;
+    this->_contentLength = -1;
+    this->_remaining = 0;
+    this->_chunked = false;
+    this->_keepAlive = true;
+    this->_payloadLength = 0;
+    this->_payload[0] = 0;
+    this->_truncated = false;
+
+    this->_retried = false;
+    this->_startedAt = millis();
+    this->_state = UPLOAD_STATE::CONNECT;
+    return true;
+  }
+
+  // Advance the request, for at most budget microseconds
+  // (or until it needs to wait for the network).
+  UPLOAD_STATE step(unsigned long budget) {
+    unsigned long start = micros();
+    bool progress = true;
+    while (progress && (micros() - start) < budget) {
+      progress = false;
+
+      if (this->_state == UPLOAD_STATE::IDLE ||
+          this->_state == UPLOAD_STATE::DONE ||
+          this->_state == UPLOAD_STATE::ERROR) {
+        break;
+      }
+
+      if (millis() - this->_startedAt > this->_timeout) {
+        this->_client.stop();
+        this->_state = UPLOAD_STATE::ERROR;
+        break;
+      }
+
+      switch (this->_state) {
+      case UPLOAD_STATE::CONNECT:
+        if (this->_connect()) {
+          this->_state = UPLOAD_STATE::HEADERS;
+          progress = true;
+        } else {
+          this->_fail();
+          progress = this->_state == UPLOAD_STATE::CONNECT;
+        }
+        break;
+      case UPLOAD_STATE::HEADERS:
+      case UPLOAD_STATE::BODY:
+        if (!this->_client.connected()) {
+          this->_fail();
+          progress = this->_state == UPLOAD_STATE::CONNECT;
+          break;
+        }
+        progress = this->_write();
+        this->_state = this->_segment < 3 ? UPLOAD_STATE::HEADERS
+                                          : UPLOAD_STATE::BODY;
+        if (this->_isWritten()) {
+          this->_state = UPLOAD_STATE::AWAIT;
+          progress = true;
+        }
+        break;
+      case UPLOAD_STATE::AWAIT:
+        progress = this->_read();
+        if (!progress && !this->_client.connected()) {
+          if (this->_parse == PARSE::BODY && this->_contentLength < 0) {
+            // The body was delimited by closing the connection.
+            this->_state = UPLOAD_STATE::DONE;
+          } else {
+            this->_fail();
+            progress = this->_state == UPLOAD_STATE::CONNECT;
+          }
+        }
+        break;
+      default:
+        break;
+      }
+    }
+    return this->_state;
+  }
+
+  // Make it available for the next request.
+  void reset() { this->_state = UPLOAD_STATE::IDLE; }
+
+  // Close the connection.
+  void stop() {
+    this->_client.stop();
+    this->_state = UPLOAD_STATE::IDLE;
+  }
+
+  UPLOAD_STATE getState() const { return this->_state; }
+
+  bool isIdle() const { return this->_state == UPLOAD_STATE::IDLE; }
+
+  bool isFinished() const {
+    return this->_state == UPLOAD_STATE::DONE ||
+           this->_state == UPLOAD_STATE::ERROR;
+  }
+
+  // HTTP status code of the response, 0 if none.
+  int getStatus() const { return this->_status; }
+
+  // Retry-After (in s) of the response, 0 if none.
+  unsigned long getRetryAfter() const { return this->_retryAfter; }
+
+  // Body of the response (truncated to UPLOAD_PAYLOAD_SIZE - 1).
+  const char *getPayload() const { return this->_payload; }
+
+  size_t getPayloadLength() const { return this->_payloadLength; }
+
+  // true if the body of the response did not fit in UPLOAD_PAYLOAD_SIZE.
+  bool isTruncated() const { return this->_truncated; }
+
+  // Timeout for a whole request, in ms.
+  void setTimeout(unsigned long value) { this->_timeout = value; }
+
+  // Timeout to open a connection, in ms.
+  void setConnectTimeout(unsigned long value) {
+    this->_connectTimeout = value;
+  }
+
+  // Number of requests that reused an already open connection.
+  unsigned long getReuses() const { return this->_reuses; }
+
+  // Number of requests that required opening a new connection.
+  unsigned long getReconnects() const { return this->_reconnects; }
+
+  // Bytes written to the connections (requests).
+  unsigned long getBytesSent() const { return this->_bytesSent; }
+
+  // Bytes read from the connections (responses).
+  unsigned long getBytesReceived() const { return this->_bytesReceived; }
+};
+
+} // namespace sensino